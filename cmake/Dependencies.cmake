@@ -36,6 +36,14 @@ if(USE_LMDB)
   add_definitions(-DUSE_LMDB)
 endif()
 
+# ---[ NUMA
+if(USE_NUMA)
+  find_package(NUMA REQUIRED)
+  include_directories(SYSTEM ${NUMA_INCLUDE_DIR})
+  list(APPEND Caffe_LINKER_LIBS ${NUMA_LIBRARIES})
+  add_definitions(-DUSE_NUMA)
+endif()
+
 # ---[ LevelDB
 if(USE_LEVELDB)
   find_package(LevelDB REQUIRED)
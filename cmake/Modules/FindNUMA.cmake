@@ -0,0 +1,15 @@
+# Try to find the libnuma libraries and headers
+#  NUMA_FOUND - system has libnuma
+#  NUMA_INCLUDE_DIR - the libnuma include directory
+#  NUMA_LIBRARIES - Libraries needed to use libnuma
+
+find_path(NUMA_INCLUDE_DIR NAMES numa.h PATHS "$ENV{NUMA_DIR}/include")
+find_library(NUMA_LIBRARIES NAMES numa PATHS "$ENV{NUMA_DIR}/lib")
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(NUMA DEFAULT_MSG NUMA_INCLUDE_DIR NUMA_LIBRARIES)
+
+if(NUMA_FOUND)
+  message(STATUS "Found libnuma (include: ${NUMA_INCLUDE_DIR}, library: ${NUMA_LIBRARIES})")
+  mark_as_advanced(NUMA_INCLUDE_DIR NUMA_LIBRARIES)
+endif()
@@ -1,6 +1,8 @@
 #ifndef CAFFE_BLOB_HPP_
 #define CAFFE_BLOB_HPP_
 
+#include <stdint.h>
+
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -73,7 +75,8 @@ class Blob {
     return shape_[CanonicalAxisIndex(index)];
   }
   inline int num_axes() const { return shape_.size(); }
-  inline int count() const { return count_; }
+  /// @brief The number of elements; 64-bit, as it may exceed INT_MAX.
+  inline int64_t count() const { return count_; }
 
   /**
    * @brief Compute the volume of a slice; i.e., the product of dimensions
@@ -83,13 +86,13 @@ class Blob {
    *
    * @param end_axis The first axis to exclude from the slice.
    */
-  inline int count(int start_axis, int end_axis) const {
+  inline int64_t count(int start_axis, int end_axis) const {
     CHECK_LE(start_axis, end_axis);
     CHECK_GE(start_axis, 0);
     CHECK_GE(end_axis, 0);
     CHECK_LE(start_axis, num_axes());
     CHECK_LE(end_axis, num_axes());
-    int count = 1;
+    int64_t count = 1;
     for (int i = start_axis; i < end_axis; ++i) {
       count *= shape(i);
     }
@@ -101,7 +104,7 @@ class Blob {
    *
    * @param start_axis The first axis to include in the slice.
    */
-  inline int count(int start_axis) const {
+  inline int64_t count(int start_axis) const {
     return count(start_axis, num_axes());
   }
 
@@ -151,7 +154,7 @@ class Blob {
     return shape(index);
   }
 
-  inline int offset(const int n, const int c = 0, const int h = 0,
+  inline int64_t offset(const int n, const int c = 0, const int h = 0,
       const int w = 0) const {
     CHECK_GE(n, 0);
     CHECK_LE(n, num());
@@ -161,12 +164,13 @@ class Blob {
     CHECK_LE(h, height());
     CHECK_GE(width(), 0);
     CHECK_LE(w, width());
-    return ((n * channels() + c) * height() + h) * width() + w;
+    return ((static_cast<int64_t>(n) * channels() + c) * height() + h) *
+        width() + w;
   }
 
-  inline int offset(const vector<int>& indices) const {
+  inline int64_t offset(const vector<int>& indices) const {
     CHECK_LE(indices.size(), num_axes());
-    int offset = 0;
+    int64_t offset = 0;
     for (int i = 0; i < num_axes(); ++i) {
       offset *= shape(i);
       if (indices.size() > i) {
@@ -271,8 +275,8 @@ class Blob {
   shared_ptr<SyncedMemory> diff_;
   shared_ptr<SyncedMemory> shape_data_;
   vector<int> shape_;
-  int count_;
-  int capacity_;
+  int64_t count_;
+  int64_t capacity_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
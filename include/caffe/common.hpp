@@ -105,6 +105,10 @@ class Caffe {
   static Caffe& Get();
 
   enum Brew { CPU, GPU };
+  // Implementation behind caffe_cpu_gemm: the linked BLAS library, or the
+  // built-in blocked kernel (see caffe/util/packed_gemm.hpp) which also lets
+  // layers keep their weights pre-packed across calls.
+  enum CpuGemm { BLAS, PACKED };
 
   // This random number generator facade hides boost and CUDA rng
   // implementation from one another (for cross-platform compatibility).
@@ -127,6 +131,11 @@ class Caffe {
     }
     return *(Get().random_generator_);
   }
+  // Swaps the random number generator of the calling thread with the given
+  // one, e.g. to let a layer draw from its own stream on whichever thread.
+  inline static void swap_rng_stream(shared_ptr<RNG>* rng) {
+    Get().random_generator_.swap(*rng);
+  }
 #ifndef CPU_ONLY
   inline static cublasHandle_t cublas_handle() { return Get().cublas_handle_; }
   inline static curandGenerator_t curand_generator() {
@@ -142,6 +151,29 @@ class Caffe {
   // freed in a non-pinned way, which may cause problems - I haven't verified
   // it personally but better to note it here in the header file.
   inline static void set_mode(Brew mode) { Get().mode_ = mode; }
+  // Returns and sets the CPU GEMM backend of the calling thread.
+  inline static CpuGemm cpu_gemm() { return Get().cpu_gemm_; }
+  inline static void set_cpu_gemm(CpuGemm cpu_gemm) {
+    Get().cpu_gemm_ = cpu_gemm;
+  }
+  // Whether the nets created by the calling thread run their neuron layers
+  // in place unless NetParameter.in_place_neurons says otherwise.
+  inline static bool in_place_neurons() { return Get().in_place_neurons_; }
+  inline static void set_in_place_neurons(bool in_place) {
+    Get().in_place_neurons_ = in_place;
+  }
+  // How many threads the nets created by the calling thread run independent
+  // layers on, unless NetParameter.layer_threads says otherwise.
+  inline static int layer_threads() { return Get().layer_threads_; }
+  inline static void set_layer_threads(int threads) {
+    Get().layer_threads_ = threads;
+  }
+  // The NUMA node that the threads started by the calling thread (layer and
+  // pipeline workers, data prefetching) are bound to, or -1 for none. Set it
+  // along with BindThreadToNumaNode, so that the workers run next to the
+  // memory that NUMA_LOCAL placement puts on that node.
+  inline static int numa_node() { return Get().numa_node_; }
+  inline static void set_numa_node(int node) { Get().numa_node_ = node; }
   // Sets the random seed of both boost and curand
   static void set_random_seed(const unsigned int seed);
   // Sets the device. Since we have cublas and curand stuff, set device also
@@ -163,6 +195,10 @@ class Caffe {
   shared_ptr<RNG> random_generator_;
 
   Brew mode_;
+  CpuGemm cpu_gemm_;
+  bool in_place_neurons_;
+  int layer_threads_;
+  int numa_node_;
   int solver_count_;
   bool root_solver_;
 
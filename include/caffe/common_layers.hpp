@@ -12,6 +12,8 @@
 #include "caffe/loss_layers.hpp"
 #include "caffe/neuron_layers.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/sparse_gemm.hpp"
 
 namespace caffe {
 
@@ -214,9 +216,9 @@ class ConcatLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
-  int count_;
-  int num_concats_;
-  int concat_input_size_;
+  int64_t count_;
+  int64_t num_concats_;
+  int64_t concat_input_size_;
   int concat_axis_;
 };
 
@@ -314,6 +316,8 @@ class FilterLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Filter"; }
   virtual inline int MinBottomBlobs() const { return 2; }
   virtual inline int MinTopBlobs() const { return 1; }
+  // The tops hold as many items as the selector selects.
+  virtual inline bool ShapeDependsOnData() const { return true; }
 
  protected:
   /**
@@ -439,7 +443,14 @@ class InnerProductLayer : public Layer<Dtype> {
   int K_;
   int N_;
   bool bias_term_;
+  // Whether the CPU forward pass applies a ReLU (from relu_param).
+  bool fused_relu_;
+  Dtype relu_negative_slope_;
   Blob<Dtype> bias_multiplier_;
+  // W^T packed for the built-in GEMM (Caffe::PACKED only).
+  PackedMatrix<Dtype> packed_weight_;
+  // The weights in CSR form when pruned (TEST phase only).
+  SparseMatrix<Dtype> sparse_weight_;
 };
 
 /**
@@ -681,7 +692,7 @@ class SplitLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
-  int count_;
+  int64_t count_;
 };
 
 /**
@@ -714,9 +725,9 @@ class SliceLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
-  int count_;
-  int num_slices_;
-  int slice_size_;
+  int64_t count_;
+  int64_t num_slices_;
+  int64_t slice_size_;
   int slice_axis_;
   vector<int> slice_point_;
 };
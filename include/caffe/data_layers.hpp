@@ -84,6 +84,8 @@ class BasePrefetchingDataLayer :
   Batch<Dtype> prefetch_[PREFETCH_COUNT];
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  // The batch whose memory the tops share since the last Forward, if any.
+  Batch<Dtype>* prefetch_current_;
 
   Blob<Dtype> transformed_data_;
 };
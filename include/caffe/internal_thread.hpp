@@ -42,8 +42,8 @@ class InternalThread {
   bool must_stop();
 
  private:
-  void entry(int device, Caffe::Brew mode, int rand_seed, int solver_count,
-      bool root_solver);
+  void entry(int device, Caffe::Brew mode, Caffe::CpuGemm cpu_gemm,
+      int numa_node, int rand_seed, int solver_count, bool root_solver);
 
   shared_ptr<boost::thread> thread_;
 };
@@ -47,6 +47,8 @@ class Layer {
           blobs_[i].reset(new Blob<Dtype>());
           blobs_[i]->FromProto(layer_param_.blobs(i));
         }
+        // blobs_ holds the weights from now on, and ToProto writes them.
+        layer_param_.clear_blobs();
       }
     }
   virtual ~Layer() {}
@@ -139,6 +141,9 @@ class Layer {
    * @param top
    *     the preshaped output blobs, whose data fields will store this layers'
    *     outputs
+   * @param reshape
+   *     whether to Reshape first; false if the layer is known to be shaped
+   *     for the bottoms already
    * \return The total loss from the layer.
    *
    * The Forward wrapper calls the relevant device wrapper function
@@ -149,7 +154,7 @@ class Layer {
    * Your layer should implement Forward_cpu and (optionally) Forward_gpu.
    */
   inline Dtype Forward(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top);
+      const vector<Blob<Dtype>*>& top, const bool reshape = true);
 
   /**
    * @brief Given the top blob error gradients, compute the bottom blob error
@@ -294,6 +299,15 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Returns true if Reshape reads the data of the bottoms, not just
+   *        their shapes, so that it has to run before every Forward.
+   *
+   * Net skips Reshape in Forward while the bottoms keep their shapes and
+   * memory otherwise.
+   */
+  virtual inline bool ShapeDependsOnData() const { return false; }
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -449,11 +463,13 @@ class Layer {
 // functions.
 template <typename Dtype>
 inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
-    const vector<Blob<Dtype>*>& top) {
+    const vector<Blob<Dtype>*>& top, const bool reshape) {
   // Lock during forward to ensure sequential forward
   Lock();
   Dtype loss = 0;
-  Reshape(bottom, top);
+  if (reshape) {
+    Reshape(bottom, top);
+  }
   switch (Caffe::mode()) {
   case Caffe::CPU:
     Forward_cpu(bottom, top);
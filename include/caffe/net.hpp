@@ -11,9 +11,12 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
+class ThreadPool;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -26,6 +29,11 @@ class Net {
   explicit Net(const NetParameter& param, const Net* root_net = NULL);
   explicit Net(const string& param_file, Phase phase,
       const Net* root_net = NULL);
+  /// Builds the net of param_file with the weights of trained_filename
+  /// (a binary NetParameter or an .h5 file). With fold_affine_layers set,
+  /// the weights go into the definition before Init, so that they fold.
+  Net(const string& param_file, Phase phase, const string& trained_filename,
+      const Net* root_net = NULL);
   virtual ~Net() {}
 
   /// @brief Initialize a network with a NetParameter.
@@ -34,9 +42,45 @@ class Net {
   /**
    * @brief Run Forward with the input Blob%s already fed separately.
    *
-   * You can get the input blobs using input_blobs().
+   * You can get the input blobs using input_blobs(). With cache_blob set,
+   * batches seen before resume from the cached values of that blob.
    */
   const vector<Blob<Dtype>*>& ForwardPrefilled(Dtype* loss = NULL);
+  /**
+   * @brief Forgets the values of cache_blob that ForwardPrefilled keeps.
+   *
+   * The cache forgets them by itself when the weights of the layers before
+   * the blob change, so this only frees the memory.
+   */
+  void ClearForwardCache();
+  /**
+   * @brief Runs Forward with the batch split into micro-batches that stream
+   *        through num_stages groups of layers, each on its own thread.
+   *
+   * The inputs and the layers without bottoms at the start of the net
+   * produce the whole batch first. The other layers run on replicas sized
+   * for one micro-batch, so that the activations passed on between layers
+   * stay in cache. Afterwards only the outputs and the preserved blobs (see
+   * PreserveBlob) hold results; those without a batch axis, such as losses,
+   * are averaged over the micro-batches. The layers must treat the samples
+   * independently: BatchReindex, Filter, and layers that concatenate,
+   * slice, reduce or normalize along the batch axis are rejected. CPU and
+   * TEST phase only.
+   */
+  const vector<Blob<Dtype>*>& ForwardPipelined(const int micro_batch_size,
+      const int num_stages, Dtype* loss = NULL);
+  /**
+   * @brief Runs only the layers that the given blobs depend on, e.g. to
+   *        extract features without running the loss and accuracy layers,
+   *        and returns their loss.
+   *
+   * The layers to run are found once for each set of blobs. Layers without
+   * bottoms, such as data layers, always run, so that they stay in step;
+   * layers without tops never run. Under a memory plan the blobs are preserved (see
+   * PreserveBlob); with micro_batch_size set, the pipeline (see
+   * ForwardPipelined) runs only these layers.
+   */
+  Dtype ForwardPruned(const vector<string>& blob_names);
 
   /**
    * The From and To variants of Forward and Backward operate on the
@@ -78,10 +122,51 @@ class Net {
    * @brief Reshape all layers from bottom to top.
    *
    * This is useful to propagate changes to layer sizes without running
-   * a forward pass, e.g. to compute output feature size.
+   * a forward pass, e.g. to compute output feature size. With
+   * max_batch_size set, the memory planned for the largest batch is kept.
    */
   void Reshape();
 
+  /**
+   * @brief Lets the blobs whose lifetimes in Forward do not overlap share one
+   *        arena of host memory (NetParameter.plan_memory, TEST phase only),
+   *        or, under gradient checkpointing, the blobs that are recomputed
+   *        within different segments.
+   *
+   * Called by Init and Reshape; call it again if single layers are reshaped.
+   */
+  void PlanMemory();
+  /**
+   * @brief Places the host memory of the parameters and activations as
+   *        NetParameter.param_placement and activation_placement ask,
+   *        moving memory that is already allocated.
+   *
+   * Called by Init and Reshape; call it again if single layers grow blobs.
+   */
+  void PlaceMemory();
+  /**
+   * @brief Logs the memory that each layer (see MemoryTracker) and the
+   *        memory arena hold now and at their peak, and the totals.
+   */
+  void LogMemoryUsage() const;
+  /**
+   * @brief Keeps the values of a blob after Forward under a memory plan or
+   *        gradient checkpointing, as NetParameter.preserve_blob does.
+   *
+   * Call it before Forward for every blob that will be read afterwards
+   * other than the net outputs; blob_by_name does not change the plan.
+   */
+  void PreserveBlob(const string& blob_name);
+  /// @brief The bytes of host memory shared by the planned blobs.
+  inline size_t planned_memory() const {
+    return memory_arena_ ? memory_arena_->size() : 0;
+  }
+  /// @brief The number of recomputed segments under gradient checkpointing,
+  ///        or 0.
+  inline int num_checkpoint_segments() const {
+    return segment_starts_.size();
+  }
+
   Dtype ForwardBackward(const vector<Blob<Dtype>* > & bottom) {
     Dtype loss;
     Forward(bottom, &loss);
@@ -104,6 +189,19 @@ class Net {
    *        additional memory) the pre-trained layers from another Net.
    */
   void ShareTrainedLayersWith(const Net* other);
+  /**
+   * @brief Creates another instance of this net that shares its weights,
+   *        e.g. to serve the same model from several threads.
+   *
+   * The layers of the replica take the weights of this net before their
+   * setup, so they neither allocate nor fill their own, and, in the TEST
+   * phase, keeps its activations in one planned arena (see
+   * PlanMemory), so that each replica costs little more than its
+   * activations. The weights must not be changed while replicas run.
+   * Create the replica in the thread that runs it, as the Caffe mode is
+   * per thread.
+   */
+  shared_ptr<Net> Replicate() const;
   // For an already initialized net, CopyTrainedLayersFrom() copies the already
   // trained layers from another net parameter instance.
   /**
@@ -116,6 +214,16 @@ class Net {
   void CopyTrainedLayersFromHDF5(const string trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
+  /**
+   * @brief Writes the net as Init built it, i.e. the filtered and rewritten
+   *        layers with their splits, tuned settings and weights, and the
+   *        current input shapes.
+   *
+   * Init builds such a compiled net as it is, in the phase it was compiled
+   * in, without filtering, rewriting, splitting or tuning it again; see
+   * tools/compile_net.cpp and ReadProtoFromMappedFile.
+   */
+  void ToCompiledProto(NetParameter* param) const;
   /// @brief Writes the net to an HDF5 file.
   void ToHDF5(const string& filename, bool write_diff = false) const;
 
@@ -168,6 +276,13 @@ class Net {
   /// @brief returns the learnable parameter learning rate multipliers
   inline const vector<float>& params_lr() const { return params_lr_; }
   inline const vector<bool>& has_params_lr() const { return has_params_lr_; }
+  /**
+   * @brief returns whether Backward computes a gradient for each learnable
+   *        parameter; the diffs of the others are never allocated.
+   */
+  inline const vector<bool>& params_need_backward() const {
+    return params_need_backward_;
+  }
   /// @brief returns the learnable parameter decay multipliers
   inline const vector<float>& params_weight_decay() const {
     return params_weight_decay_;
@@ -225,6 +340,76 @@ class Net {
   /// @brief Append a new parameter blob to the net.
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
+  /// @brief Splits the net into segments for gradient checkpointing.
+  void InitCheckpointSegments(const NetParameter& param);
+  /**
+   * @brief Groups the blobs that share data into buffers, each used from
+   *        first_use to last_use; the inputs and data layer tops are not
+   *        plannable.
+   */
+  void FindBuffers(map<SyncedMemory*, int>* buffer_ids,
+      vector<shared_ptr<SyncedMemory> >* buffers, vector<int>* first_use,
+      vector<int>* last_use, vector<bool>* plannable) const;
+  /// @brief Reruns the forward pass of a segment before its Backward.
+  void RecomputeSegment(const int segment_id);
+  /// @brief Fails if a blob or parameter without gradient has a diff.
+  void CheckUnusedDiffs() const;
+  /**
+   * @brief Finds the layers each layer has to wait for in Forward, and starts
+   *        the threads to run independent layers on if there are any.
+   */
+  void ScheduleLayers(const int num_threads);
+  struct ParallelPass;
+  /// @brief Runs Forward (from start to end) or Backward (from start down to
+  ///        end) on the scheduled threads; returns the loss of Forward.
+  Dtype RunLayersInParallel(const int start, const int end,
+      const bool forward);
+  void RunScheduledLayer(ParallelPass* pass, const int layer_id);
+
+  /**
+   * @brief Runs Forward of a layer, with Reshape only if its bottoms changed
+   *        shape or memory since it last reshaped, or its shapes depend on
+   *        data.
+   */
+  Dtype ForwardLayer(const int layer_id);
+  /// @brief Fails if the batch of an input exceeds max_batch_size.
+  void CheckBatchSize() const;
+  /// @brief Remembers the bottoms a layer has just been reshaped for.
+  void RememberBottoms(const int layer_id);
+  /**
+   * @brief Finds the blobs that several layers read (without a Split in
+   *        between) and gives all but the first reader in Backward a proxy
+   *        of the blob to read, whose gradient BackwardLayer adds to the diff
+   *        of the blob.
+   */
+  void InitFanOuts();
+  /// @brief Shares the data and shape of the blobs with the proxies that a
+  ///        layer reads them through.
+  void ShareFanOutData(const int layer_id);
+  /// @brief Runs Backward of a layer, and sums the gradients of the blobs it
+  ///        shares with other layers into their diff.
+  void BackwardLayer(const int layer_id);
+  /// @brief Builds a net from param that shares the weights of this one.
+  shared_ptr<Net> ReplicateFrom(const NetParameter& param) const;
+  /// @brief Builds a net whose layers share the weights of weight_source
+  ///        from their setup on, so that they never allocate or fill any.
+  Net(const NetParameter& param, const Net* root_net,
+      const Net* weight_source);
+  struct Pipeline;
+  /// @brief Builds the replicas and stages that ForwardPipelined runs.
+  void BuildPipeline(const int micro_batch_size, const int num_stages,
+      const int num_data_layers, const vector<Blob<Dtype>*>& inputs,
+      const set<int>& result_ids);
+  /// @brief Runs Forward pipelined for the given blobs; returns the loss.
+  Dtype RunPipeline(const int micro_batch_size, const int num_stages,
+      const set<int>& result_ids);
+  /// @brief Runs one stage of the pipeline on every micro-batch in turn.
+  void RunPipelineStage(const int stage);
+  struct ForwardCache;
+  /// @brief Finds the layers that the cached blob cuts the net into.
+  void InitForwardCache(const NetParameter& param);
+  /// @brief Runs ForwardPrefilled through the cache; returns the loss.
+  Dtype ForwardCached();
 
   /// @brief Helper for displaying debug info in Forward about input Blobs.
   void InputDebugInfo(const int layer_id);
@@ -288,12 +473,84 @@ class Net {
   /// the weight decay multipliers for learnable_params_
   vector<float> params_weight_decay_;
   vector<bool> has_params_decay_;
+  /// whether any layer computes the gradient of each learnable_params_
+  vector<bool> params_need_backward_;
+  /// whether Backward reads or writes the diff of each blob
+  vector<bool> blob_diff_used_;
+  /// whether to check that unused diffs stay unallocated
+  bool check_unused_diffs_;
   /// The bytes of memory used by this net
   size_t memory_used_;
+  /// Whether blobs share memory by lifetime.
+  bool plan_memory_;
+  /// The blobs whose values are kept for the whole forward pass.
+  set<int> preserved_blob_ids_;
+  /// The host memory shared by the planned blobs.
+  shared_ptr<SyncedMemory> memory_arena_;
+  /// The MemoryTracker owners of the net (e.g. its arena) and of each layer.
+  int memory_owner_;
+  vector<int> layer_memory_owners_;
+  /// How the host memory of parameters and activations is placed.
+  MemoryPlacement param_placement_;
+  MemoryPlacement activation_placement_;
+  /// Whether activations inside segments are recomputed during Backward.
+  bool checkpointing_;
+  /// The first layer of each segment, and the segment of each layer.
+  vector<int> segment_starts_;
+  vector<int> layer_segment_;
+  /// The random state at the start of each segment in the last Forward.
+  vector<rng_t> segment_rngs_;
+  /// The segment whose activations are current, or -1.
+  int materialized_segment_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// The earlier layers each layer waits for in Forward because it reads or
+  /// writes their tops, overwrites their bottoms or shares their
+  /// parameters, and the later layers that wait for it.
+  vector<vector<int> > layer_deps_;
+  vector<vector<int> > layer_dependents_;
+  /// The same for Backward: the edges reversed, plus the readers of each
+  /// fan-out one after another from the last, as they add to the same diff.
+  vector<vector<int> > backward_deps_;
+  vector<vector<int> > backward_dependents_;
+  /// The threads that run independent layers, if any, and the random stream
+  /// of each layer when they do.
+  shared_ptr<ThreadPool> layer_pool_;
+  vector<shared_ptr<Caffe::RNG> > layer_rngs_;
+  /// The shapes, and the data and diff memory, of the bottoms that each
+  /// layer was last reshaped for.
+  vector<vector<vector<int> > > reshaped_shapes_;
+  vector<vector<const SyncedMemory*> > reshaped_memory_;
+  /// The largest batch of the inputs that the net is set up for, or 0.
+  int max_batch_size_;
+  /// The micro-batch size and stages of ForwardPrefilled, if pipelined, and
+  /// the replicas and threads that ForwardPipelined last ran on.
+  int micro_batch_size_;
+  int pipeline_stages_;
+  shared_ptr<Pipeline> pipeline_;
+  /// The fan-out that each bottom of each layer belongs to, or -1. A fan-out
+  /// is a blob (as written by one layer) that several layers read: the last
+  /// of them that needs its gradient writes the diff of the blob, and the
+  /// others read it through a proxy that writes to the scratch diff of the
+  /// fan-out, which is then added to the diff of the blob.
+  vector<vector<int> > bottom_fan_outs_;
+  vector<vector<int> > fan_out_layers_;
+  vector<shared_ptr<Blob<Dtype> > > fan_out_proxies_;
+  vector<shared_ptr<Blob<Dtype> > > fan_out_diffs_;
+  /// Whether the diff of each fan-out's blob is written in this Backward (as
+  /// ints, which the threads of Backward can set independently).
+  vector<int> fan_out_written_;
+  /// The cached values of cache_blob, if set.
+  shared_ptr<ForwardCache> forward_cache_;
+  /// The layers that ForwardPruned runs for each (sorted) set of blob ids.
+  map<vector<int>, vector<int> > pruned_layers_;
+  /// The definition of the net without weights, for Replicate.
+  NetParameter replica_param_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
+  /// The net whose weights Init gives the layers of the same name before
+  /// their setup, if any (see ReplicateFrom).
+  const Net* const weight_source_;
   DISABLE_COPY_AND_ASSIGN(Net);
 };
 
@@ -38,6 +38,8 @@ class PythonLayer : public Layer<Dtype> {
   }
 
   virtual inline const char* type() const { return "Python"; }
+  // Python code may shape its tops by anything.
+  virtual inline bool ShapeDependsOnData() const { return true; }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -107,6 +107,8 @@ class Solver {
   virtual void RestoreSolverStateFromHDF5(const string& state_file) = 0;
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file) = 0;
   void DisplayOutputBlobs(const int net_id);
+  // The MemoryTracker owner of the update history.
+  int history_memory_owner() const;
 
   SolverParameter param_;
   int iter_;
@@ -4,7 +4,9 @@
 #include <cstdlib>
 
 #include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/memory_tracker.hpp"
 
 namespace caffe {
 
@@ -12,8 +14,10 @@ namespace caffe {
 // using cudaMallocHost. It avoids dynamic pinning for transfers (DMA).
 // The improvement in performance seems negligible in the single GPU case,
 // but might be more significant for parallel training. Most importantly,
-// it improved stability for large models on many GPUs.
-inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
+// it improved stability for large models on many GPUs. Otherwise it comes
+// from the HostAllocator, placed as asked.
+inline void CaffeMallocHost(void** ptr, size_t size,
+    const HostPlacement& placement, bool* use_cuda) {
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
     CUDA_CHECK(cudaMallocHost(ptr, size));
@@ -21,19 +25,20 @@ inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
     return;
   }
 #endif
-  *ptr = malloc(size);
+  *ptr = HostAllocator::Allocate(size, placement);
   *use_cuda = false;
   CHECK(*ptr) << "host allocation of size " << size << " failed";
 }
 
-inline void CaffeFreeHost(void* ptr, bool use_cuda) {
+inline void CaffeFreeHost(void* ptr, size_t size,
+    const HostPlacement& placement, bool use_cuda) {
 #ifndef CPU_ONLY
   if (use_cuda) {
     CUDA_CHECK(cudaFreeHost(ptr));
     return;
   }
 #endif
-  free(ptr);
+  HostAllocator::Free(ptr, size, placement);
 }
 
 
@@ -48,11 +53,11 @@ class SyncedMemory {
   SyncedMemory()
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        gpu_device_(-1), version_(0), owner_(-1) {}
   explicit SyncedMemory(size_t size)
       : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
         own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
-        gpu_device_(-1) {}
+        gpu_device_(-1), version_(0), owner_(-1) {}
   ~SyncedMemory();
   const void* cpu_data();
   void set_cpu_data(void* data);
@@ -63,6 +68,26 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  /**
+   * @brief Sets how the host memory is placed. Memory that is already
+   *        allocated (and owned) is moved into a block placed this way;
+   *        borrowed memory (set_cpu_data) and pinned memory are left alone.
+   */
+  void set_placement(const HostPlacement& placement);
+  const HostPlacement& placement() const { return placement_; }
+  /**
+   * @brief Returns a counter that is bumped every time the contents may have
+   *        been changed, i.e. on each mutable access or pointer swap.
+   *
+   * Caches derived from the contents (e.g. pre-packed GEMM operands) compare
+   * versions to find out when they have gone stale.
+   */
+  unsigned int version() const { return version_; }
+  /**
+   * @brief Returns the MemoryTracker owner that the memory is counted
+   *        against: the one in scope when it was first allocated, or -1.
+   */
+  int owner() const { return owner_; }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -71,6 +96,7 @@ class SyncedMemory {
  private:
   void to_cpu();
   void to_gpu();
+  void Track(MemoryTracker::Device device);
   void* cpu_ptr_;
   void* gpu_ptr_;
   size_t size_;
@@ -79,6 +105,9 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int gpu_device_;
+  unsigned int version_;
+  HostPlacement placement_;
+  int owner_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
@@ -0,0 +1,54 @@
+#ifndef CAFFE_UTIL_CONV_TUNER_HPP_
+#define CAFFE_UTIL_CONV_TUNER_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Picks the fastest CPU forward algorithm of Convolution layers by
+ *        timing the candidates on the actual input shape, the CPU analogue
+ *        of cuDNN's algorithm search.
+ *
+ * The candidates are im2col + GEMM, GEMM with pre-packed filters, direct
+ * convolution and the FFT engine (the last two for 2D only). Choices are
+ * kept per geometry for the lifetime of the tuner and, if a cache file is
+ * given, on disk keyed by the geometry and the CPU model.
+ */
+template <typename Dtype>
+class ConvolutionTuner {
+ public:
+  /// @param cache_file the tuning cache; empty to keep choices in memory only.
+  explicit ConvolutionTuner(const string& cache_file);
+
+  /**
+   * @brief Sets the engine and cpu_algorithm of a Convolution layer to the
+   *        fastest for an input of bottom_shape.
+   */
+  void Tune(const vector<int>& bottom_shape, LayerParameter* param);
+
+  /// @brief The cache key: CPU model, precision, input shape and geometry.
+  static string Key(const vector<int>& bottom_shape,
+      const ConvolutionParameter& conv_param);
+  /// @brief The CPU model name from /proc/cpuinfo, or "unknown".
+  static string CpuModel();
+
+ private:
+  // The best of a few timed forward passes, in milliseconds.
+  float TimeForward(const LayerParameter& param, Blob<Dtype>* bottom);
+  void Load();
+  void Save();
+
+  string cache_file_;
+  map<string, string> choices_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CONV_TUNER_HPP_
@@ -0,0 +1,47 @@
+#ifndef CAFFE_UTIL_FFT_H_
+#define CAFFE_UTIL_FFT_H_
+
+#include <complex>
+#include <vector>
+
+namespace caffe {
+
+/**
+ * @brief A bundled radix-2 complex FFT of a fixed power-of-two size, so that
+ *        FFT convolution does not depend on an external library.
+ *
+ * Transforms are in place and unnormalized: Inverse(Forward(x)) == n * x
+ * (n * n * x for the 2-D transforms).
+ */
+template <typename Dtype>
+class FFTPlan {
+ public:
+  explicit FFTPlan(const int n);
+
+  inline int size() const { return n_; }
+  void Forward(std::complex<Dtype>* data) const { Transform(data, false); }
+  void Inverse(std::complex<Dtype>* data) const { Transform(data, true); }
+  /// @brief Transforms an n x n row-major array in place.
+  void Forward2D(std::complex<Dtype>* data) const {
+    Transform2D(data, false);
+  }
+  void Inverse2D(std::complex<Dtype>* data) const {
+    Transform2D(data, true);
+  }
+
+ private:
+  void Transform(std::complex<Dtype>* data, const bool inverse) const;
+  void Transform2D(std::complex<Dtype>* data, const bool inverse) const;
+
+  int n_;
+  std::vector<int> bit_reverse_;
+  std::vector<std::complex<Dtype> > twiddle_;
+  mutable std::vector<std::complex<Dtype> > column_;
+};
+
+// Returns the smallest power of two >= n.
+int fft_size(const int n);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FFT_H_
@@ -0,0 +1,34 @@
+#ifndef CAFFE_UTIL_FUSE_ACTIVATIONS_HPP_
+#define CAFFE_UTIL_FUSE_ACTIVATIONS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with each ReLU layer that directly follows a Convolution
+// or InnerProduct layer folded into that layer's relu_param, so the layer
+// applies the ReLU in the pass that adds its bias. The ReLU layer is removed;
+// if it ran out of place, the producer writes the ReLU's top blob instead,
+// and its own top, which only the ReLU read, is gone from the fused net.
+// The result computes the same outputs but cannot run Backward, so the pass
+// is only meant for nets in the TEST phase. Blobs named in preserve_blob and
+// blobs read by more than one layer are kept. Returns the number of folded
+// layers.
+int FuseActivations(const NetParameter& param, NetParameter* param_fused);
+
+// Copy NetParameters, which must hold the trained weights (for instance a
+// deploy net whose layers carry the blobs of Net::ToProto), with each Power
+// layer with power 1 that directly follows a Convolution or InnerProduct
+// layer folded into that layer's weights and bias. Since such a layer only
+// computes shift + scale * x, the folded net has the same outputs and one
+// pass less for every folded layer; a bias is added where the shift needs
+// one. Blobs are renamed and kept as for FuseActivations, and layers whose
+// weights are shared by name are left alone, and layers without weights
+// are skipped with a warning. Net::Init applies it when
+// NetParameter.fold_affine_layers is set. Returns the number of folded
+// layers.
+int FoldAffineLayers(const NetParameter& param, NetParameter* param_folded);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FUSE_ACTIVATIONS_HPP_
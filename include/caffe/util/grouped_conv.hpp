@@ -0,0 +1,40 @@
+#ifndef _CAFFE_UTIL_GROUPED_CONV_HPP_
+#define _CAFFE_UTIL_GROUPED_CONV_HPP_
+
+namespace caffe {
+
+// Direct 2D convolution for layers with few input channels per group (e.g.
+// depthwise convolution, where group == channels). Instead of unrolling the
+// input with im2col and running one tiny GEMM per group, each kernel tap is
+// applied to whole output rows. The output size follows im2col_cpu and the
+// weights are laid out as num_output x (channels / group) x kernel_h x
+// kernel_w, like the weights of ConvolutionLayer.
+
+// Computes data_out (num_output x height_out x width_out), overwriting it.
+template <typename Dtype>
+void grouped_conv_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, Dtype* data_out);
+
+// Computes the gradient with respect to the input from the gradient
+// with respect to the output, overwriting data_im.
+template <typename Dtype>
+void grouped_conv_backward_data_cpu(const Dtype* data_out, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, Dtype* data_im);
+
+// Accumulates the gradient with respect to the weights into weights_diff.
+template <typename Dtype>
+void grouped_conv_backward_weight_cpu(const Dtype* data_im,
+    const int channels, const int height, const int width,
+    const Dtype* data_out, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, Dtype* weights_diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_GROUPED_CONV_HPP_
@@ -0,0 +1,88 @@
+#ifndef CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <cstddef>
+
+namespace caffe {
+
+/**
+ * @brief Where the pages of a host allocation go.
+ *
+ * Placed allocations bypass the cache: their pages are mapped fresh so that
+ * the policy takes effect before anything touches them.
+ */
+struct HostPlacement {
+  enum Numa {
+    NUMA_DEFAULT,     // the node of the thread that first touches a page
+    NUMA_LOCAL,       // the node of the allocating thread
+    NUMA_INTERLEAVE   // round robin over all nodes
+  };
+  HostPlacement() : huge_pages(false), numa(NUMA_DEFAULT) {}
+  HostPlacement(bool huge_pages, Numa numa)
+      : huge_pages(huge_pages), numa(numa) {}
+  bool is_default() const { return !huge_pages && numa == NUMA_DEFAULT; }
+  bool operator==(const HostPlacement& other) const {
+    return huge_pages == other.huge_pages && numa == other.numa;
+  }
+
+  /// Back the block with transparent huge pages (2 MB aligned, madvised).
+  bool huge_pages;
+  Numa numa;
+};
+
+/**
+ * @brief A caching allocator for the host memory of SyncedMemory.
+ *
+ * Sizes are rounded up to size classes, four per power of two, and freed
+ * blocks are kept in free lists of the freeing thread for the next request
+ * of the same class, up to a per-thread and a process-wide cache limit. A
+ * thread's blocks go back to the system when it exits. Reshapes, batch
+ * prefetching and transient blobs then reuse blocks instead of churning the
+ * system allocator. Blocks are aligned to a cache line (64 bytes), or to a
+ * huge page (2 MB) from that size up.
+ */
+class HostAllocator {
+ public:
+  struct Stats {
+    /// Bytes handed out and not yet freed, counted in class sizes.
+    size_t bytes_in_use;
+    size_t peak_bytes_in_use;
+    /// Bytes freed and kept for reuse, over all threads.
+    size_t bytes_cached;
+    /// Allocations served from a free list, and from the system.
+    size_t hits;
+    size_t misses;
+  };
+
+  /// @brief Returns a block of at least size bytes, or NULL on failure.
+  static void* Allocate(size_t size);
+  /// @brief Frees a block; size must be the one it was allocated with.
+  static void Free(void* ptr, size_t size);
+  /// @brief The size class, i.e. the bytes actually reserved, of a request.
+  static size_t RoundSize(size_t size);
+  /// @brief Allocates with the given placement; the default one is cached.
+  static void* Allocate(size_t size, const HostPlacement& placement);
+  /// @brief Frees a block allocated with the given size and placement.
+  static void Free(void* ptr, size_t size, const HostPlacement& placement);
+
+  static Stats GetStats();
+  /// @brief Bounds the bytes that each thread keeps cached (default 1 GB).
+  static void set_cache_limit(size_t bytes);
+  static size_t cache_limit();
+  /// @brief Bounds the bytes cached over all threads (default 2 GB).
+  static void set_total_cache_limit(size_t bytes);
+  static size_t total_cache_limit();
+  /// @brief Returns the blocks cached by the calling thread to the system.
+  static void ReleaseCache();
+};
+
+/**
+ * @brief Runs the calling thread on the CPUs of a NUMA node and prefers that
+ *        node for its memory. Threads it creates afterwards (BLAS workers,
+ *        data prefetching) inherit both. Needs a build with USE_NUMA.
+ */
+void BindThreadToNumaNode(int node);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_ALLOCATOR_HPP_
@@ -0,0 +1,21 @@
+#ifndef CAFFE_UTIL_IN_PLACE_HPP_
+#define CAFFE_UTIL_IN_PLACE_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with the elementwise neuron layers (ReLU, Sigmoid, ...)
+// that can safely overwrite their bottom blob rewritten to run in place. The
+// bottom blob of such a layer, and every mention of it back to the layer that
+// produced it, is renamed after the top blob, so the bottom name is gone from
+// the rewritten net. Layers whose backward pass would read the overwritten
+// values are only rewritten when the net cannot run Backward (the TEST phase
+// without force_backward). Net inputs, the tops of data layers, blobs read by
+// more than one layer and the blobs named in preserve_blob are kept.
+// Returns the number of rewritten layers.
+int RunNeuronsInPlace(const NetParameter& param, NetParameter* param_in_place);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_IN_PLACE_HPP_
@@ -11,6 +11,13 @@ namespace caffe {
 // blobs with unique bottom blobs provided by the SplitLayer.
 void InsertSplits(const NetParameter& param, NetParameter* param_split);
 
+// Copy NetParameters (with splits inserted) without the Split layers that
+// the Net can do without: the layers reading the split tops read the split
+// bottom instead. Splits with a loss weight are kept, and so are those where
+// a layer reads two of the tops, or would then run in place on the bottom.
+// Returns the number of left out Split layers.
+int ElideSplits(const NetParameter& param_split, NetParameter* param_elided);
+
 void ConfigureSplitLayer(const string& layer_name, const string& blob_name,
     const int blob_idx, const int split_count, const float loss_weight,
     LayerParameter* split_layer_param);
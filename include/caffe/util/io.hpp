@@ -74,6 +74,21 @@ inline void ReadProtoFromBinaryFileOrDie(const string& filename,
   ReadProtoFromBinaryFileOrDie(filename.c_str(), proto);
 }
 
+/**
+ * @brief Parses a binary proto from the file mapped into memory rather than
+ *        read through a stream, e.g. to load a compiled net quickly.
+ *
+ * This only saves the stream; the message still holds its own parsed copy
+ * of everything in the file, which the caller may free once it is used.
+ */
+bool ReadProtoFromMappedFile(const char* filename, Message* proto);
+
+inline void ReadProtoFromMappedFileOrDie(const string& filename,
+                                         Message* proto) {
+  CHECK(ReadProtoFromMappedFile(filename.c_str(), proto))
+      << "Failed to parse " << filename;
+}
+
 
 void WriteProtoToBinaryFile(const Message& proto, const char* filename);
 inline void WriteProtoToBinaryFile(
@@ -13,7 +13,12 @@
 namespace caffe {
 
 // Caffe gemm provides a simpler interface to the gemm functions, with the
-// limitation that the data has to be contiguous in memory.
+// limitation that the data has to be contiguous in memory. On the CPU the
+// implementation is chosen at runtime by Caffe::set_cpu_gemm().
+//
+// The other CPU functions take 64-bit counts and split longer vectors into
+// pieces for the BLAS and VML routines, which count in int. Each matrix
+// dimension of a gemm or gemv still has to fit in an int.
 template <typename Dtype>
 void caffe_cpu_gemm(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
@@ -26,46 +31,46 @@ void caffe_cpu_gemv(const CBLAS_TRANSPOSE TransA, const int M, const int N,
     Dtype* y);
 
 template <typename Dtype>
-void caffe_axpy(const int N, const Dtype alpha, const Dtype* X,
+void caffe_axpy(const int64_t N, const Dtype alpha, const Dtype* X,
     Dtype* Y);
 
 template <typename Dtype>
-void caffe_cpu_axpby(const int N, const Dtype alpha, const Dtype* X,
+void caffe_cpu_axpby(const int64_t N, const Dtype alpha, const Dtype* X,
     const Dtype beta, Dtype* Y);
 
 template <typename Dtype>
-void caffe_copy(const int N, const Dtype *X, Dtype *Y);
+void caffe_copy(const int64_t N, const Dtype *X, Dtype *Y);
 
 template <typename Dtype>
-void caffe_set(const int N, const Dtype alpha, Dtype *X);
+void caffe_set(const int64_t N, const Dtype alpha, Dtype *X);
 
 inline void caffe_memset(const size_t N, const int alpha, void* X) {
   memset(X, alpha, N);  // NOLINT(caffe/alt_fn)
 }
 
 template <typename Dtype>
-void caffe_add_scalar(const int N, const Dtype alpha, Dtype *X);
+void caffe_add_scalar(const int64_t N, const Dtype alpha, Dtype *X);
 
 template <typename Dtype>
-void caffe_scal(const int N, const Dtype alpha, Dtype *X);
+void caffe_scal(const int64_t N, const Dtype alpha, Dtype *X);
 
 template <typename Dtype>
-void caffe_sqr(const int N, const Dtype* a, Dtype* y);
+void caffe_sqr(const int64_t N, const Dtype* a, Dtype* y);
 
 template <typename Dtype>
-void caffe_add(const int N, const Dtype* a, const Dtype* b, Dtype* y);
+void caffe_add(const int64_t N, const Dtype* a, const Dtype* b, Dtype* y);
 
 template <typename Dtype>
-void caffe_sub(const int N, const Dtype* a, const Dtype* b, Dtype* y);
+void caffe_sub(const int64_t N, const Dtype* a, const Dtype* b, Dtype* y);
 
 template <typename Dtype>
-void caffe_mul(const int N, const Dtype* a, const Dtype* b, Dtype* y);
+void caffe_mul(const int64_t N, const Dtype* a, const Dtype* b, Dtype* y);
 
 template <typename Dtype>
-void caffe_div(const int N, const Dtype* a, const Dtype* b, Dtype* y);
+void caffe_div(const int64_t N, const Dtype* a, const Dtype* b, Dtype* y);
 
 template <typename Dtype>
-void caffe_powx(const int n, const Dtype* a, const Dtype b, Dtype* y);
+void caffe_powx(const int64_t n, const Dtype* a, const Dtype b, Dtype* y);
 
 unsigned int caffe_rng_rand();
 
@@ -73,40 +78,40 @@ template <typename Dtype>
 Dtype caffe_nextafter(const Dtype b);
 
 template <typename Dtype>
-void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r);
+void caffe_rng_uniform(const int64_t n, const Dtype a, const Dtype b, Dtype* r);
 
 template <typename Dtype>
-void caffe_rng_gaussian(const int n, const Dtype mu, const Dtype sigma,
+void caffe_rng_gaussian(const int64_t n, const Dtype mu, const Dtype sigma,
                         Dtype* r);
 
 template <typename Dtype>
-void caffe_rng_bernoulli(const int n, const Dtype p, int* r);
+void caffe_rng_bernoulli(const int64_t n, const Dtype p, int* r);
 
 template <typename Dtype>
-void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r);
+void caffe_rng_bernoulli(const int64_t n, const Dtype p, unsigned int* r);
 
 template <typename Dtype>
-void caffe_exp(const int n, const Dtype* a, Dtype* y);
+void caffe_exp(const int64_t n, const Dtype* a, Dtype* y);
 
 template <typename Dtype>
-void caffe_log(const int n, const Dtype* a, Dtype* y);
+void caffe_log(const int64_t n, const Dtype* a, Dtype* y);
 
 template <typename Dtype>
-void caffe_abs(const int n, const Dtype* a, Dtype* y);
+void caffe_abs(const int64_t n, const Dtype* a, Dtype* y);
 
 template <typename Dtype>
-Dtype caffe_cpu_dot(const int n, const Dtype* x, const Dtype* y);
+Dtype caffe_cpu_dot(const int64_t n, const Dtype* x, const Dtype* y);
 
 template <typename Dtype>
-Dtype caffe_cpu_strided_dot(const int n, const Dtype* x, const int incx,
+Dtype caffe_cpu_strided_dot(const int64_t n, const Dtype* x, const int incx,
     const Dtype* y, const int incy);
 
 template <typename Dtype>
-int caffe_cpu_hamming_distance(const int n, const Dtype* x, const Dtype* y);
+int caffe_cpu_hamming_distance(const int64_t n, const Dtype* x, const Dtype* y);
 
 // Returns the sum of the absolute values of the elements of vector x
 template <typename Dtype>
-Dtype caffe_cpu_asum(const int n, const Dtype* x);
+Dtype caffe_cpu_asum(const int64_t n, const Dtype* x);
 
 // the branchless, type-safe version from
 // http://stackoverflow.com/questions/1903954/is-there-a-standard-sign-function-signum-sgn-in-c-c
@@ -123,9 +128,9 @@ inline int8_t caffe_sign(Dtype val) {
 // So they have to be pasted here temporarily.
 #define DEFINE_CAFFE_CPU_UNARY_FUNC(name, operation) \
   template<typename Dtype> \
-  void caffe_cpu_##name(const int n, const Dtype* x, Dtype* y) { \
+  void caffe_cpu_##name(const int64_t n, const Dtype* x, Dtype* y) { \
     CHECK_GT(n, 0); CHECK(x); CHECK(y); \
-    for (int i = 0; i < n; ++i) { \
+    for (int64_t i = 0; i < n; ++i) { \
       operation; \
     } \
   }
@@ -143,7 +148,24 @@ DEFINE_CAFFE_CPU_UNARY_FUNC(sgnbit, \
 DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]));
 
 template <typename Dtype>
-void caffe_cpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
+void caffe_cpu_scale(const int64_t n, const Dtype alpha, const Dtype *x,
+    Dtype* y);
+
+// In one pass over the rows x cols matrix y, add bias[i] (bias_per_row) or
+// bias[j] to y[i * cols + j] unless bias is NULL, then, if relu, replace it
+// with max(y, 0) + negative_slope * min(y, 0).
+template <typename Dtype>
+void caffe_cpu_bias_relu(const int rows, const int cols, const Dtype* bias,
+    const bool bias_per_row, const bool relu, const Dtype negative_slope,
+    Dtype* y);
+
+// Turn the gradient dy with respect to the output y of caffe_cpu_bias_relu
+// into the gradient with respect to its input: multiply dy[i] by negative_slope
+// where y[i] <= 0. As y > 0 exactly where the input is, negative_slope must
+// not be negative.
+template <typename Dtype>
+void caffe_cpu_relu_backward(const int64_t n, const Dtype* y,
+    const Dtype negative_slope, Dtype* dy);
 
 #ifndef CPU_ONLY  // GPU
 
@@ -0,0 +1,57 @@
+#ifndef CAFFE_UTIL_MEMORY_TRACKER_HPP_
+#define CAFFE_UTIL_MEMORY_TRACKER_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace caffe {
+
+/**
+ * @brief Accounts the memory of SyncedMemory by owner, e.g. a layer of a
+ *        net, the prefetching of a data layer or the history of a solver.
+ *
+ * Memory is counted against the owner in scope (see Scope) on the thread
+ * that allocates it, until it is freed by whichever thread. Owner 0 stands
+ * for memory allocated out of any scope. The current and peak bytes are
+ * kept per owner and in total, separately for the host and the GPU.
+ */
+class MemoryTracker {
+ public:
+  enum Device { HOST, GPU };
+  struct Usage {
+    Usage() : bytes(0), peak_bytes(0) {}
+    size_t bytes;
+    size_t peak_bytes;
+  };
+
+  /// @brief Returns the id of the owner with this name, creating it once.
+  static int Owner(const std::string& name);
+  static std::string owner_name(int owner);
+  /// @brief The owner in scope on the calling thread.
+  static int current_owner();
+
+  static void Allocated(int owner, Device device, size_t bytes);
+  static void Freed(int owner, Device device, size_t bytes);
+
+  static Usage GetUsage(int owner, Device device);
+  static Usage GetTotal(Device device);
+  /// @brief Restarts the peaks, of all owners and in total, from now on.
+  static void ResetPeaks();
+
+  /// @brief Makes an owner current on the calling thread while in scope.
+  class Scope {
+   public:
+    explicit Scope(int owner);
+    ~Scope();
+
+   private:
+    int previous_;
+
+    Scope(const Scope&);
+    Scope& operator=(const Scope&);
+  };
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MEMORY_TRACKER_HPP_
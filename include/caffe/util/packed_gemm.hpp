@@ -0,0 +1,112 @@
+#ifndef CAFFE_UTIL_PACKED_GEMM_H_
+#define CAFFE_UTIL_PACKED_GEMM_H_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+
+namespace caffe {
+
+// Built-in blocked SGEMM/DGEMM in the style of GotoBLAS: operands are copied
+// into cache-sized panels ("packed") and multiplied by an MR x NR register
+// micro-kernel. On x86 CPUs with AVX2 and FMA the float micro-kernel is
+// vectorized (selected at runtime); everywhere else a portable kernel is used.
+//
+// The register tile and cache blocking sizes.
+const int kPackedGemmMR = 6;
+const int kPackedGemmNR = 16;
+const int kPackedGemmKC = 256;
+const int kPackedGemmMC = 96;
+const int kPackedGemmNC = 2048;
+
+/**
+ * @brief An operand of a GEMM stored in the packed panel layout consumed by
+ *        the built-in micro-kernel, so that a matrix used many times (e.g. the
+ *        weights of a Convolution or InnerProduct layer) is packed only once.
+ *
+ * When packed from a SyncedMemory the matrix remembers the memory and its
+ * version(), and packing again is a no-op until the memory has been written
+ * to (e.g. by a solver update or by loading trained weights).
+ */
+template <typename Dtype>
+class PackedMatrix {
+ public:
+  PackedMatrix()
+      : left_(true), rows_(0), cols_(0), trans_(CblasNoTrans), offset_(0),
+        source_(), source_version_(0) {}
+
+  /// @brief Packs op(A) of shape M x K as the left operand of a product.
+  void PackLeft(const CBLAS_TRANSPOSE trans, const int M, const int K,
+      const Dtype* A);
+  /// @brief Packs op(B) of shape K x N as the right operand of a product.
+  void PackRight(const CBLAS_TRANSPOSE trans, const int K, const int N,
+      const Dtype* B);
+  /**
+   * @brief Packs op(A), read from mem starting at element offset, as the left
+   *        operand unless it is already packed from the current contents.
+   */
+  void PackLeft(const CBLAS_TRANSPOSE trans, const int M, const int K,
+      const shared_ptr<SyncedMemory>& mem, const int offset);
+  /**
+   * @brief Packs op(B), read from mem starting at element offset, as the
+   *        right operand unless it is already packed from the current contents.
+   */
+  void PackRight(const CBLAS_TRANSPOSE trans, const int K, const int N,
+      const shared_ptr<SyncedMemory>& mem, const int offset);
+  /// @brief Drops the packed data and the reference to its source.
+  void Clear();
+
+  inline bool empty() const { return data_.empty(); }
+  inline bool is_left() const { return left_; }
+  /// @brief Rows of the logical (unpacked) matrix.
+  inline int rows() const { return rows_; }
+  /// @brief Columns of the logical (unpacked) matrix.
+  inline int cols() const { return cols_; }
+  inline const Dtype* data() const { return &data_[0]; }
+  /// @brief Size of the register-tiled dimension after zero padding.
+  int padded() const;
+
+ private:
+  bool IsPackedFrom(const bool left, const CBLAS_TRANSPOSE trans,
+      const int rows, const int cols, const shared_ptr<SyncedMemory>& mem,
+      const int offset) const;
+
+  bool left_;
+  int rows_;
+  int cols_;
+  CBLAS_TRANSPOSE trans_;
+  int offset_;
+  shared_ptr<SyncedMemory> source_;
+  unsigned int source_version_;
+  std::vector<Dtype> data_;
+};
+
+// C = alpha * op(A) * op(B) + beta * C with the built-in kernel. Same
+// interface and row-major layout as caffe_cpu_gemm; when beta is zero C is
+// write-only (it is never read, so it may hold NaNs).
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
+    Dtype* C);
+
+// C = alpha * A * op(B) + beta * C, where A is a pre-packed M x K matrix.
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const PackedMatrix<Dtype>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const Dtype alpha,
+    const Dtype* B, const Dtype beta, Dtype* C);
+
+// C = alpha * op(A) * B + beta * C, where B is a pre-packed K x N matrix.
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const CBLAS_TRANSPOSE TransA, const int M,
+    const Dtype alpha, const Dtype* A, const PackedMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C);
+
+// Whether the vectorized AVX2/FMA float micro-kernel is used on this CPU.
+bool caffe_packed_gemm_has_avx2();
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PACKED_GEMM_H_
@@ -0,0 +1,84 @@
+#ifndef CAFFE_UTIL_SPARSE_GEMM_H_
+#define CAFFE_UTIL_SPARSE_GEMM_H_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A row-major matrix in compressed sparse row (CSR) form, built from
+ *        a dense matrix such as the weights of a pruned Convolution or
+ *        InnerProduct layer.
+ *
+ * Like PackedMatrix, a matrix converted from a SyncedMemory remembers the
+ * memory and its version(), so converting again is a no-op until the weights
+ * are written to. Conversion is skipped (is_sparse() is false) when the
+ * matrix has fewer zeros than the requested sparsity, in which case the
+ * caller should stay on the dense GEMM.
+ */
+template <typename Dtype>
+class SparseMatrix {
+ public:
+  SparseMatrix()
+      : rows_(0), cols_(0), nnz_(0), is_sparse_(false), min_sparsity_(0),
+        offset_(0), source_(), source_version_(0) {}
+
+  /**
+   * @brief Converts the rows x cols matrix read from mem starting at element
+   *        offset if at least min_sparsity of its entries are zero.
+   */
+  void FromDense(const int rows, const int cols,
+      const shared_ptr<SyncedMemory>& mem, const int offset,
+      const float min_sparsity);
+  /// @brief Converts A unconditionally.
+  void FromDense(const int rows, const int cols, const Dtype* A);
+
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+  /// @brief Number of non-zero entries of the dense matrix.
+  inline int nnz() const { return nnz_; }
+  /// @brief Fraction of zero entries of the dense matrix.
+  inline float sparsity() const {
+    return rows_ * cols_ == 0 ? 0.f :
+        1.f - static_cast<float>(nnz_) / (static_cast<float>(rows_) * cols_);
+  }
+  /// @brief Whether the CSR arrays hold the matrix.
+  inline bool is_sparse() const { return is_sparse_; }
+  inline const int* row_ptr() const { return &row_ptr_[0]; }
+  inline const int* col_ind() const { return col_ind_.empty() ? NULL :
+      &col_ind_[0]; }
+  inline const Dtype* values() const { return values_.empty() ? NULL :
+      &values_[0]; }
+
+ private:
+  int rows_;
+  int cols_;
+  int nnz_;
+  bool is_sparse_;
+  float min_sparsity_;
+  int offset_;
+  shared_ptr<SyncedMemory> source_;
+  unsigned int source_version_;
+  std::vector<int> row_ptr_;
+  std::vector<int> col_ind_;
+  std::vector<Dtype> values_;
+};
+
+// C = alpha * A * B + beta * C, where A is a sparse M x K matrix and B a dense
+// row-major K x N matrix.
+template <typename Dtype>
+void caffe_cpu_csrmm(const SparseMatrix<Dtype>& A, const int N,
+    const Dtype alpha, const Dtype* B, const Dtype beta, Dtype* C);
+
+// C = alpha * A * B^T + beta * C, where A is a dense row-major M x K matrix
+// and B a sparse N x K matrix (the InnerProduct layout).
+template <typename Dtype>
+void caffe_cpu_gemm_csrt(const int M, const Dtype alpha, const Dtype* A,
+    const SparseMatrix<Dtype>& B, const Dtype beta, Dtype* C);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SPARSE_GEMM_H_
@@ -0,0 +1,64 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include <deque>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+/**
+ Forward declare boost::thread instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of worker threads that run submitted tasks.
+ *
+ * Each worker has its own deque of tasks. A task submitted from a worker
+ * goes to the back of that worker's deque, which the worker pops first, so
+ * that follow-up work stays on the thread whose caches hold its inputs; idle
+ * workers steal from the front of the other deques. Tasks submitted from
+ * other threads are spread over the deques in turn. The destructor runs the
+ * tasks still queued before it joins the workers. The workers are bound to
+ * the Caffe::numa_node of the thread that creates the pool, if any.
+ */
+class ThreadPool {
+ public:
+  typedef boost::function<void()> Task;
+
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  void Submit(const Task& task);
+
+  inline int num_threads() const { return threads_.size(); }
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
+   Linux CUDA 7.0.18.
+   */
+  class sync;
+
+  void WorkerEntry(int worker, int numa_node);
+  // Takes the next task for the worker, its own or stolen; needs the lock.
+  bool NextTask(int worker, Task* task);
+
+  vector<std::deque<Task> > queues_;
+  vector<shared_ptr<boost::thread> > threads_;
+  shared_ptr<sync> sync_;
+  int next_queue_;
+  bool stopping_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
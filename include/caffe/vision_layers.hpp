@@ -13,6 +13,9 @@
 #include "caffe/loss_layers.hpp"
 #include "caffe/neuron_layers.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fft.hpp"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/sparse_gemm.hpp"
 
 namespace caffe {
 
@@ -34,12 +37,16 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
 
+  /// @brief Whether the CPU path uses the direct grouped convolution.
+  inline bool grouped_conv() const { return grouped_conv_; }
+
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
   // The last argument in forward_cpu_gemm is so that we can skip the im2col if
   // we just called weight_cpu_gemm with the same input.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
+  // Adds the bias (if not NULL) and applies the folded ReLU, if any.
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
@@ -83,8 +90,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   const vector<int>* bottom_shape_;
 
   int num_spatial_axes_;
-  int bottom_dim_;
-  int top_dim_;
+  // Per-image counts, 64-bit so that n * bottom_dim_ cannot overflow.
+  int64_t bottom_dim_;
+  int64_t top_dim_;
 
   int channel_axis_;
   int num_;
@@ -96,6 +104,13 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  float sparse_threshold_;
+  ConvolutionParameter_CpuAlgorithm cpu_algorithm_;
+  /// @brief Whether the CPU path uses the direct grouped convolution.
+  bool grouped_conv_;
+  /// @brief Whether forward_cpu_bias applies a ReLU (from relu_param).
+  bool fused_relu_;
+  Dtype relu_negative_slope_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -125,6 +140,34 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           pad_.cpu_data(), stride_.cpu_data(), data);
     }
   }
+  // wrap the direct grouped convolution in the same way
+  inline void conv_grouped_cpu(const Dtype* data, const Dtype* weights,
+      Dtype* output) {
+    grouped_conv_cpu(data, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        weights, conv_out_channels_, group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1], output);
+  }
+  inline void conv_grouped_backward_data_cpu(const Dtype* output,
+      const Dtype* weights, Dtype* data) {
+    grouped_conv_backward_data_cpu(output, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        weights, conv_out_channels_, group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1], data);
+  }
+  inline void conv_grouped_backward_weight_cpu(const Dtype* data,
+      const Dtype* output, Dtype* weights_diff) {
+    grouped_conv_backward_weight_cpu(data, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        output, conv_out_channels_, group_,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1], weights_diff);
+  }
 #ifndef CPU_ONLY
   inline void conv_im2col_gpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
@@ -162,11 +205,15 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int conv_in_channels_;
   int conv_out_spatial_dim_;
   int kernel_dim_;
-  int col_offset_;
-  int output_offset_;
+  int64_t col_offset_;
+  int64_t output_offset_;
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  // Per-group weights packed for the built-in GEMM (Caffe::PACKED only).
+  vector<PackedMatrix<Dtype> > packed_weights_;
+  // Per-group filters in CSR form when pruned (TEST phase only).
+  vector<SparseMatrix<Dtype> > sparse_weights_;
 };
 
 /**
@@ -213,8 +260,8 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
    *  first group and input channels 3-4 and output channels 5-8 into the second
    *  group.
    *  - bias_term (\b optional, default true). Whether to have a bias.
-   *  - engine: convolution has CAFFE (matrix multiplication) and CUDNN (library
-   *    kernels + stream parallelism) engines.
+   *  - engine: convolution has CAFFE (matrix multiplication), CUDNN (library
+   *    kernels + stream parallelism) and FFT (CPU frequency domain) engines.
    */
   explicit ConvolutionLayer(const LayerParameter& param)
       : BaseConvolutionLayer<Dtype>(param) {}
@@ -269,6 +316,51 @@ class DeconvolutionLayer : public BaseConvolutionLayer<Dtype> {
   virtual void compute_output_shape();
 };
 
+/**
+ * @brief CPU implementation of ConvolutionLayer in the frequency domain.
+ *        Uses the inherited GEMM path for backward and for GPU mode.
+ *
+ * The input is cut into T x T tiles (T a power of two) that overlap by the
+ * kernel size minus one. Each tile is transformed once per input channel,
+ * multiplied by the cached filter spectra and transformed back, so the cost
+ * per output no longer grows with the kernel area. This wins over im2col +
+ * GEMM for large kernels; tools/fft_conv_benchmark reports the crossover on
+ * a given machine. The filter spectra are recomputed only when the weights
+ * change, and the tile size bounds the workspace for large inputs. Only 2D
+ * convolution is supported, and strided outputs are subsampled from the
+ * dense result.
+ */
+template <typename Dtype>
+class FFTConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit FFTConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), tile_size_(0), weight_version_(0) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// @brief The side of the square FFT tiles.
+  inline int tile_size() const { return tile_size_; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  // Recomputes the conjugated filter spectra if the weights changed.
+  void UpdateWeightSpectra();
+
+  int tile_size_;
+  shared_ptr<FFTPlan<Dtype> > plan_;
+  // Half spectra, T x (T / 2 + 1) per (output, input channel) pair.
+  vector<std::complex<Dtype> > weight_spectra_;
+  shared_ptr<SyncedMemory> weight_source_;
+  unsigned int weight_version_;
+  // Full spectra of one tile for the input channels of a group.
+  vector<std::complex<Dtype> > input_spectra_;
+  vector<std::complex<Dtype> > output_spectrum_;
+};
+
 #ifdef USE_CUDNN
 /*
  * @brief cuDNN implementation of ConvolutionLayer.
@@ -364,8 +456,8 @@ class Im2colLayer : public Layer<Dtype> {
   Blob<int> pad_;
 
   int num_spatial_axes_;
-  int bottom_dim_;
-  int top_dim_;
+  int64_t bottom_dim_;
+  int64_t top_dim_;
 
   int channel_axis_;
   int num_;
@@ -89,11 +89,19 @@ shared_ptr<Net<Dtype> > Net_Init_Load(
   CheckFile(pretrained_param_file);
 
   shared_ptr<Net<Dtype> > net(new Net<Dtype>(param_file,
-      static_cast<Phase>(phase)));
-  net->CopyTrainedLayersFrom(pretrained_param_file);
+      static_cast<Phase>(phase), pretrained_param_file));
   return net;
 }
 
+// Forward of the layers that the listed blobs need
+Dtype Net_ForwardPruned(Net<Dtype>* net, bp::list blob_names) {
+  vector<string> names(bp::len(blob_names));
+  for (int i = 0; i < names.size(); ++i) {
+    names[i] = bp::extract<string>(blob_names[i]);
+  }
+  return net->ForwardPruned(names);
+}
+
 void Net_Save(const Net<Dtype>& net, string filename) {
   NetParameter net_param;
   net.ToProto(&net_param, false);
@@ -223,8 +231,10 @@ BOOST_PYTHON_MODULE(_caffe) {
     .def("__init__", bp::make_constructor(&Net_Init))
     .def("__init__", bp::make_constructor(&Net_Init_Load))
     .def("_forward", &Net<Dtype>::ForwardFromTo)
+    .def("forward_pruned", &Net_ForwardPruned)
     .def("_backward", &Net<Dtype>::BackwardFromTo)
     .def("reshape", &Net<Dtype>::Reshape)
+    .def("preserve_blob", &Net<Dtype>::PreserveBlob)
     // The cast is to select a particular overload.
     .def("copy_from", static_cast<void (Net<Dtype>::*)(const string)>(
         &Net<Dtype>::CopyTrainedLayersFrom))
@@ -259,7 +269,7 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("channels", &Blob<Dtype>::channels)
     .add_property("height",   &Blob<Dtype>::height)
     .add_property("width",    &Blob<Dtype>::width)
-    .add_property("count",    static_cast<int (Blob<Dtype>::*)() const>(
+    .add_property("count",    static_cast<int64_t (Blob<Dtype>::*)() const>(
         &Blob<Dtype>::count))
     .def("reshape",           bp::raw_function(&Blob_Reshape))
     .add_property("data",     bp::make_function(&Blob<Dtype>::mutable_cpu_data,
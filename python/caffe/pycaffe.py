@@ -66,6 +66,8 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
     Parameters
     ----------
     blobs : list of blobs to return in addition to output blobs.
+            Without start and end, only the layers that these and the
+            output blobs depend on run, along with the data layers.
     kwargs : Keys are input blob names and values are blob ndarrays.
              For formatting inputs for Caffe, see Net.preprocess().
              If None, input is taken from data layers.
@@ -102,7 +104,10 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
                 raise Exception('Input is not batch sized')
             self.blobs[in_].data[...] = blob
 
-    self._forward(start_ind, end_ind)
+    if blobs and start is None and end is None:
+        self.forward_pruned(list(outputs))
+    else:
+        self._forward(start_ind, end_ind)
 
     # Unpack blobs to extract
     return {out: self.blobs[out].data for out in outputs}
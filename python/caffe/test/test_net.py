@@ -63,6 +63,35 @@ class TestNet(unittest.TestCase):
         self.net.forward()
         self.net.backward()
 
+    def test_forward_blobs_pruned(self):
+        """forward(blobs=...) runs only the layers that the blobs need, and
+        the data layers still step."""
+        f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
+        f.write("""name: 'prunednet'
+        layer { type: 'DummyData' name: 'data' top: 'data'
+          dummy_data_param { shape { dim: 2 dim: 3 }
+            data_filler { type: 'gaussian' std: 1 } } }
+        layer { type: 'InnerProduct' name: 'ip' bottom: 'data' top: 'ip'
+          inner_product_param { num_output: 4
+            weight_filler { type: 'gaussian' std: 1 } } }
+        layer { type: 'InnerProduct' name: 'side' bottom: 'data' top: 'side'
+          inner_product_param { num_output: 4
+            weight_filler { type: 'gaussian' std: 1 } } }
+        layer { type: 'Silence' name: 'silence' bottom: 'side' }""")
+        f.close()
+        net = caffe.Net(f.name, caffe.TEST)
+        os.remove(f.name)
+        out = net.forward(blobs=['data'])
+        self.assertEqual(set(out.keys()), set(['data', 'ip']))
+        data = out['data'].copy()
+        np.testing.assert_allclose(out['ip'],
+                data.dot(net.params['ip'][0].data.T), rtol=1e-5)
+        self.assertEqual(abs(net.blobs['side'].data).sum(), 0)
+        out = net.forward(blobs=['data'])
+        self.assertNotEqual(abs(out['data'] - data).sum(), 0)
+        net.forward()
+        self.assertNotEqual(abs(net.blobs['side'].data).sum(), 0)
+
     def test_inputs_outputs(self):
         self.assertEqual(self.net.inputs, [])
         self.assertEqual(self.net.outputs, ['loss'])
@@ -1,4 +1,4 @@
-#include <climits>
+#include <limits>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -22,6 +22,9 @@ void Blob<Dtype>::Reshape(const int num, const int channels, const int height,
 template <typename Dtype>
 void Blob<Dtype>::Reshape(const vector<int>& shape) {
   CHECK_LE(shape.size(), kMaxBlobAxes);
+  // The byte size must fit as well.
+  const int64_t max_count = std::numeric_limits<int64_t>::max() /
+      static_cast<int64_t>(sizeof(Dtype));
   count_ = 1;
   shape_.resize(shape.size());
   if (!shape_data_ || shape_data_->size() < shape.size() * sizeof(int)) {
@@ -30,7 +33,10 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
   int* shape_data = static_cast<int*>(shape_data_->mutable_cpu_data());
   for (int i = 0; i < shape.size(); ++i) {
     CHECK_GE(shape[i], 0);
-    CHECK_LE(shape[i], INT_MAX / count_) << "blob size exceeds INT_MAX";
+    if (count_ != 0) {
+      CHECK_LE(shape[i], max_count / count_)
+          << "blob size exceeds INT64_MAX bytes";
+    }
     count_ *= shape[i];
     shape_[i] = shape[i];
     shape_data[i] = shape[i];
@@ -469,25 +475,25 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   Dtype* data_vec = mutable_cpu_data();
   if (proto.double_data_size() > 0) {
     CHECK_EQ(count_, proto.double_data_size());
-    for (int i = 0; i < count_; ++i) {
+    for (int64_t i = 0; i < count_; ++i) {
       data_vec[i] = proto.double_data(i);
     }
   } else {
     CHECK_EQ(count_, proto.data_size());
-    for (int i = 0; i < count_; ++i) {
+    for (int64_t i = 0; i < count_; ++i) {
       data_vec[i] = proto.data(i);
     }
   }
   if (proto.double_diff_size() > 0) {
     CHECK_EQ(count_, proto.double_diff_size());
     Dtype* diff_vec = mutable_cpu_diff();
-    for (int i = 0; i < count_; ++i) {
+    for (int64_t i = 0; i < count_; ++i) {
       diff_vec[i] = proto.double_diff(i);
     }
   } else if (proto.diff_size() > 0) {
     CHECK_EQ(count_, proto.diff_size());
     Dtype* diff_vec = mutable_cpu_diff();
-    for (int i = 0; i < count_; ++i) {
+    for (int64_t i = 0; i < count_; ++i) {
       diff_vec[i] = proto.diff(i);
     }
   }
@@ -502,12 +508,12 @@ void Blob<double>::ToProto(BlobProto* proto, bool write_diff) const {
   proto->clear_double_data();
   proto->clear_double_diff();
   const double* data_vec = cpu_data();
-  for (int i = 0; i < count_; ++i) {
+  for (int64_t i = 0; i < count_; ++i) {
     proto->add_double_data(data_vec[i]);
   }
   if (write_diff) {
     const double* diff_vec = cpu_diff();
-    for (int i = 0; i < count_; ++i) {
+    for (int64_t i = 0; i < count_; ++i) {
       proto->add_double_diff(diff_vec[i]);
     }
   }
@@ -522,12 +528,12 @@ void Blob<float>::ToProto(BlobProto* proto, bool write_diff) const {
   proto->clear_data();
   proto->clear_diff();
   const float* data_vec = cpu_data();
-  for (int i = 0; i < count_; ++i) {
+  for (int64_t i = 0; i < count_; ++i) {
     proto->add_data(data_vec[i]);
   }
   if (write_diff) {
     const float* diff_vec = cpu_diff();
-    for (int i = 0; i < count_; ++i) {
+    for (int64_t i = 0; i < count_; ++i) {
       proto->add_diff(diff_vec[i]);
     }
   }
@@ -52,7 +52,8 @@ void GlobalInit(int* pargc, char*** pargv) {
 #ifdef CPU_ONLY  // CPU-only Caffe.
 
 Caffe::Caffe()
-    : random_generator_(), mode_(Caffe::CPU),
+    : random_generator_(), mode_(Caffe::CPU), cpu_gemm_(Caffe::BLAS),
+      in_place_neurons_(false), layer_threads_(1), numa_node_(-1),
       solver_count_(1), root_solver_(true) { }
 
 Caffe::~Caffe() { }
@@ -97,7 +98,8 @@ void* Caffe::RNG::generator() {
 
 Caffe::Caffe()
     : cublas_handle_(NULL), curand_generator_(NULL), random_generator_(),
-    mode_(Caffe::CPU), solver_count_(1), root_solver_(true) {
+    mode_(Caffe::CPU), cpu_gemm_(Caffe::BLAS), in_place_neurons_(false),
+    layer_threads_(1), numa_node_(-1), solver_count_(1), root_solver_(true) {
   // Try to create a cublas handler, and report an error if failed (but we will
   // keep the program running as one might just want to run CPU code).
   if (cublasCreate(&cublas_handle_) != CUBLAS_STATUS_SUCCESS) {
@@ -2,6 +2,7 @@
 #include <exception>
 
 #include "caffe/internal_thread.hpp"
+#include "caffe/util/host_allocator.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -26,24 +27,32 @@ void InternalThread::StartInternalThread() {
   CUDA_CHECK(cudaGetDevice(&device));
 #endif
   Caffe::Brew mode = Caffe::mode();
+  Caffe::CpuGemm cpu_gemm = Caffe::cpu_gemm();
+  int numa_node = Caffe::numa_node();
   int rand_seed = caffe_rng_rand();
   int solver_count = Caffe::solver_count();
   bool root_solver = Caffe::root_solver();
 
   try {
     thread_.reset(new boost::thread(&InternalThread::entry, this, device, mode,
-          rand_seed, solver_count, root_solver));
+          cpu_gemm, numa_node, rand_seed, solver_count, root_solver));
   } catch (std::exception& e) {
     LOG(FATAL) << "Thread exception: " << e.what();
   }
 }
 
-void InternalThread::entry(int device, Caffe::Brew mode, int rand_seed,
-    int solver_count, bool root_solver) {
+void InternalThread::entry(int device, Caffe::Brew mode,
+    Caffe::CpuGemm cpu_gemm, int numa_node, int rand_seed, int solver_count,
+    bool root_solver) {
 #ifndef CPU_ONLY
   CUDA_CHECK(cudaSetDevice(device));
 #endif
   Caffe::set_mode(mode);
+  Caffe::set_cpu_gemm(cpu_gemm);
+  if (numa_node >= 0) {
+    BindThreadToNumaNode(numa_node);
+    Caffe::set_numa_node(numa_node);
+  }
   Caffe::set_random_seed(rand_seed);
   Caffe::set_solver_count(solver_count);
   Caffe::set_root_solver(root_solver);
@@ -17,7 +17,7 @@ void AbsValLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void AbsValLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  const int count = top[0]->count();
+  const int64_t count = top[0]->count();
   Dtype* top_data = top[0]->mutable_cpu_data();
   caffe_abs(count, bottom[0]->cpu_data(), top_data);
 }
@@ -25,7 +25,7 @@ void AbsValLayer<Dtype>::Forward_cpu(
 template <typename Dtype>
 void AbsValLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  const int count = top[0]->count();
+  const int64_t count = top[0]->count();
   const Dtype* top_diff = top[0]->cpu_diff();
   if (propagate_down[0]) {
     const Dtype* bottom_data = bottom[0]->cpu_data();
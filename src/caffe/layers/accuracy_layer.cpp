@@ -29,6 +29,9 @@ void AccuracyLayer<Dtype>::Reshape(
       << "top_k must be less than or equal to the number of classes.";
   label_axis_ =
       bottom[0]->CanonicalAxisIndex(this->layer_param_.accuracy_param().axis());
+  // The samples and classes are indexed in int.
+  CHECK_LE(bottom[0]->count(), INT_MAX) << this->type()
+      << " takes at most INT_MAX elements.";
   outer_num_ = bottom[0]->count(0, label_axis_);
   inner_num_ = bottom[0]->count(label_axis_ + 1);
   CHECK_EQ(outer_num_ * inner_num_, bottom[1]->count())
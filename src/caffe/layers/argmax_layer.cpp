@@ -33,6 +33,9 @@ void ArgMaxLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ArgMaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  // The samples and the positions within them are indexed in int.
+  CHECK_LE(bottom[0]->count(), INT_MAX) << this->type()
+      << " takes at most INT_MAX elements.";
   std::vector<int> shape(bottom[0]->num_axes(), 1);
   if (has_axis_) {
     // Produces max_ind or max_val per axis
@@ -3,8 +3,11 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/util/grouped_conv.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/sparse_gemm.hpp"
 #include "caffe/vision_layers.hpp"
 
 namespace caffe {
@@ -15,6 +18,12 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Configure the kernel size, padding, stride, and inputs.
   ConvolutionParameter conv_param = this->layer_param_.convolution_param();
   force_nd_im2col_ = conv_param.force_nd_im2col();
+  sparse_threshold_ = conv_param.sparse_threshold();
+  cpu_algorithm_ = conv_param.cpu_algorithm();
+  fused_relu_ = conv_param.has_relu_param();
+  relu_negative_slope_ = conv_param.relu_param().negative_slope();
+  CHECK_GE(relu_negative_slope_, 0)
+      << "relu_param needs a negative_slope of at least 0.";
   channel_axis_ = bottom[0]->CanonicalAxisIndex(conv_param.axis());
   const int first_spatial_axis = channel_axis_ + 1;
   const int num_axes = bottom[0]->num_axes();
@@ -165,6 +174,21 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   kernel_dim_ = this->blobs_[0]->count(1);
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
+  // With few inputs per filter (e.g. depthwise convolution) im2col and one
+  // tiny GEMM per group are slow; convolve directly instead. A 1x1 kernel
+  // needs no im2col, and sparse or packed filters are asked for on purpose,
+  // so AUTO leaves those to the GEMM.
+  if (cpu_algorithm_ == ConvolutionParameter_CpuAlgorithm_DIRECT) {
+    CHECK(!force_nd_im2col_ && num_spatial_axes_ == 2)
+        << "The DIRECT algorithm only supports 2D convolution.";
+    grouped_conv_ = true;
+  } else {
+    grouped_conv_ = cpu_algorithm_ == ConvolutionParameter_CpuAlgorithm_AUTO
+        && !force_nd_im2col_ && num_spatial_axes_ == 2 && group_ > 1 &&
+        kernel_dim_ <= 64 && this->blobs_[0]->count(2) > 1 &&
+        !(this->phase_ == TEST && sparse_threshold_ > 0) &&
+        Caffe::cpu_gemm() != Caffe::PACKED;
+  }
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
@@ -200,8 +224,9 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   } else {
     conv_out_spatial_dim_ = top[0]->count(first_spatial_axis);
   }
-  col_offset_ = kernel_dim_ * conv_out_spatial_dim_;
-  output_offset_ = conv_out_channels_ * conv_out_spatial_dim_ / group_;
+  col_offset_ = static_cast<int64_t>(kernel_dim_) * conv_out_spatial_dim_;
+  output_offset_ = static_cast<int64_t>(conv_out_channels_) *
+      conv_out_spatial_dim_ / group_;
   // Setup input dimensions (conv_input_shape_).
   vector<int> bottom_dim_blob_shape(1, num_spatial_axes_ + 1);
   conv_input_shape_.Reshape(bottom_dim_blob_shape);
@@ -243,6 +268,10 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
+  if (grouped_conv_) {
+    conv_grouped_cpu(input, weights, output);
+    return;
+  }
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
@@ -250,7 +279,40 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     }
     col_buff = col_buffer_.cpu_data();
   }
+  // The layer's own filters can be kept in a faster form between calls:
+  // compressed when pruned (TEST phase only) or packed for the built-in GEMM.
+  const bool own_weights = (weights == this->blobs_[0]->cpu_data());
+  const bool sparse = own_weights && this->phase_ == TEST &&
+      sparse_threshold_ > 0;
+  const bool packed = own_weights &&
+      (cpu_algorithm_ == ConvolutionParameter_CpuAlgorithm_PACKED_GEMM ||
+      (cpu_algorithm_ == ConvolutionParameter_CpuAlgorithm_AUTO &&
+      Caffe::cpu_gemm() == Caffe::PACKED));
+  if (sparse) {
+    sparse_weights_.resize(group_);
+  }
+  if (packed) {
+    packed_weights_.resize(group_);
+  }
   for (int g = 0; g < group_; ++g) {
+    if (sparse) {
+      sparse_weights_[g].FromDense(conv_out_channels_ / group_, kernel_dim_,
+          this->blobs_[0]->data(), weight_offset_ * g, sparse_threshold_);
+      if (sparse_weights_[g].is_sparse()) {
+        caffe_cpu_csrmm<Dtype>(sparse_weights_[g], conv_out_spatial_dim_,
+            (Dtype)1., col_buff + col_offset_ * g, (Dtype)0.,
+            output + output_offset_ * g);
+        continue;
+      }
+    }
+    if (packed) {
+      packed_weights_[g].PackLeft(CblasNoTrans, conv_out_channels_ / group_,
+          kernel_dim_, this->blobs_[0]->data(), weight_offset_ * g);
+      caffe_cpu_packed_gemm<Dtype>(packed_weights_[g], CblasNoTrans,
+          conv_out_spatial_dim_, (Dtype)1., col_buff + col_offset_ * g,
+          (Dtype)0., output + output_offset_ * g);
+      continue;
+    }
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
         group_, conv_out_spatial_dim_, kernel_dim_,
         (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
@@ -261,14 +323,18 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
-      out_spatial_dim_, 1, (Dtype)1., bias, bias_multiplier_.cpu_data(),
-      (Dtype)1., output);
+  // One pass over the output instead of a rank-1 GEMM plus a ReLU layer.
+  caffe_cpu_bias_relu<Dtype>(num_output_, out_spatial_dim_, bias, true,
+      fused_relu_, relu_negative_slope_, output);
 }
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
+  if (grouped_conv_) {
+    conv_grouped_backward_data_cpu(output, weights, input);
+    return;
+  }
   Dtype* col_buff = col_buffer_.mutable_cpu_data();
   if (is_1x1_) {
     col_buff = input;
@@ -287,6 +353,10 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
+  if (grouped_conv_) {
+    conv_grouped_backward_weight_cpu(input, output, weights);
+    return;
+  }
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
@@ -312,6 +382,7 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
+  CHECK(!fused_relu_) << "relu_param is only supported on the CPU.";
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
@@ -5,6 +5,7 @@
 #include "caffe/data_layers.hpp"
 #include "caffe/net.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/memory_tracker.hpp"
 
 namespace caffe {
 
@@ -33,7 +34,7 @@ template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
-      prefetch_free_(), prefetch_full_() {
+      prefetch_free_(), prefetch_full_(), prefetch_current_(NULL) {
   for (int i = 0; i < PREFETCH_COUNT; ++i) {
     prefetch_free_.push(&prefetch_[i]);
   }
@@ -47,6 +48,8 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
   // calls so that the prefetch thread does not accidentally make simultaneous
   // cudaMalloc calls when the main thread is running. In some GPUs this
   // seems to cause failures if we do not so.
+  MemoryTracker::Scope memory_scope(
+      MemoryTracker::Owner(this->layer_param_.name() + " prefetch"));
   for (int i = 0; i < PREFETCH_COUNT; ++i) {
     prefetch_[i].data_.mutable_cpu_data();
     if (this->output_labels_) {
@@ -71,6 +74,8 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
 
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
+  MemoryTracker::Scope memory_scope(
+      MemoryTracker::Owner(this->layer_param_.name() + " prefetch"));
 #ifndef CPU_ONLY
   cudaStream_t stream;
   if (Caffe::mode() == Caffe::GPU) {
@@ -103,22 +108,39 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // The tops are done with the batch they adopted in the last Forward.
+  if (prefetch_current_) {
+    prefetch_free_.push(prefetch_current_);
+    prefetch_current_ = NULL;
+  }
   Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
-  // Copy the data
-  caffe_copy(batch->data_.count(), batch->data_.cpu_data(),
-             top[0]->mutable_cpu_data());
-  DLOG(INFO) << "Prefetch copied";
+  if (this->IsShared()) {
+    // Copy the data, as the nets sharing this layer each need their own.
+    caffe_copy(batch->data_.count(), batch->data_.cpu_data(),
+               top[0]->mutable_cpu_data());
+    DLOG(INFO) << "Prefetch copied";
+  } else {
+    // Adopt the data; the batch stays out of the queue until the next Forward.
+    top[0]->ShareData(batch->data_);
+  }
   if (this->output_labels_) {
     // Reshape to loaded labels.
     top[1]->ReshapeLike(batch->label_);
-    // Copy the labels.
-    caffe_copy(batch->label_.count(), batch->label_.cpu_data(),
-        top[1]->mutable_cpu_data());
+    if (this->IsShared()) {
+      // Copy the labels.
+      caffe_copy(batch->label_.count(), batch->label_.cpu_data(),
+          top[1]->mutable_cpu_data());
+    } else {
+      top[1]->ShareData(batch->label_);
+    }
+  }
+  if (this->IsShared()) {
+    prefetch_free_.push(batch);
+  } else {
+    prefetch_current_ = batch;
   }
-
-  prefetch_free_.push(batch);
 }
 
 #ifdef CPU_ONLY
@@ -7,23 +7,43 @@ namespace caffe {
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // The tops are done with the batch they adopted in the last Forward. Wait
+  // for the kernels reading it before the next batch is loaded into it.
+  if (prefetch_current_) {
+    CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+    prefetch_free_.push(prefetch_current_);
+    prefetch_current_ = NULL;
+  }
   Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
-  // Copy the data
-  caffe_copy(batch->data_.count(), batch->data_.gpu_data(),
-      top[0]->mutable_gpu_data());
+  if (this->IsShared()) {
+    // Copy the data, as the nets sharing this layer each need their own.
+    caffe_copy(batch->data_.count(), batch->data_.gpu_data(),
+        top[0]->mutable_gpu_data());
+  } else {
+    // Adopt the data; the batch stays out of the queue until the next Forward.
+    top[0]->ShareData(batch->data_);
+  }
   if (this->output_labels_) {
     // Reshape to loaded labels.
     top[1]->ReshapeLike(batch->label_);
-    // Copy the labels.
-    caffe_copy(batch->label_.count(), batch->label_.gpu_data(),
-        top[1]->mutable_gpu_data());
+    if (this->IsShared()) {
+      // Copy the labels.
+      caffe_copy(batch->label_.count(), batch->label_.gpu_data(),
+          top[1]->mutable_gpu_data());
+    } else {
+      top[1]->ShareData(batch->label_);
+    }
+  }
+  if (this->IsShared()) {
+    // Ensure the copy is synchronous wrt the host, so that the next batch
+    // isn't copied in meanwhile.
+    CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
+    prefetch_free_.push(batch);
+  } else {
+    prefetch_current_ = batch;
   }
-  // Ensure the copy is synchronous wrt the host, so that the next batch isn't
-  // copied in meanwhile.
-  CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
-  prefetch_free_.push(batch);
 }
 
 INSTANTIATE_LAYER_GPU_FORWARD(BasePrefetchingDataLayer);
@@ -38,13 +38,13 @@ void BatchReindexLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   if (top[0]->count() == 0) {
     return;
   }
-  int inner_dim = bottom[0]->count() / bottom[0]->shape(0);
+  const int64_t inner_dim = bottom[0]->count() / bottom[0]->shape(0);
   const Dtype* in = bottom[0]->cpu_data();
   const Dtype* permut = bottom[1]->cpu_data();
   Dtype* out = top[0]->mutable_cpu_data();
-  for (int index = 0; index < top[0]->count(); ++index) {
-    int n = index / (inner_dim);
-    int in_n = static_cast<int>(permut[n]);
+  for (int64_t index = 0; index < top[0]->count(); ++index) {
+    const int64_t n = index / (inner_dim);
+    const int64_t in_n = static_cast<int>(permut[n]);
     out[index] = in[in_n * (inner_dim) + index % (inner_dim)];
   }
 }
@@ -57,14 +57,14 @@ void BatchReindexLayer<Dtype>::Backward_cpu(
   if (!propagate_down[0]) {
     return;
   }
-  int inner_dim = bottom[0]->count() / bottom[0]->shape(0);
+  const int64_t inner_dim = bottom[0]->count() / bottom[0]->shape(0);
   Dtype* bot_diff = bottom[0]->mutable_cpu_diff();
   const Dtype* permut = bottom[1]->cpu_data();
   const Dtype* top_diff = top[0]->cpu_diff();
   caffe_set(bottom[0]->count(), Dtype(0), bot_diff);
-  for (int index = 0; index < top[0]->count(); ++index) {
-    int n = index / (inner_dim);
-    int in_n = static_cast<int>(permut[n]);
+  for (int64_t index = 0; index < top[0]->count(); ++index) {
+    const int64_t n = index / (inner_dim);
+    const int64_t in_n = static_cast<int>(permut[n]);
     bot_diff[in_n * (inner_dim) + index % (inner_dim)] += top_diff[index];
   }
 }
@@ -33,8 +33,9 @@ void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     for (int n = 0; n < this->num_; ++n) {
       this->backward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
           top_data + n * this->top_dim_);
-      if (this->bias_term_) {
-        const Dtype* bias = this->blobs_[1]->cpu_data();
+      if (this->bias_term_ || this->fused_relu_) {
+        const Dtype* bias =
+            this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
       }
     }
@@ -47,6 +48,11 @@ void DeconvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
+    if (this->fused_relu_) {
+      // Like a ReLU layer running in place, this overwrites the top diff.
+      caffe_cpu_relu_backward(top[i]->count(), top[i]->cpu_data(),
+          this->relu_negative_slope_, top[i]->mutable_cpu_diff());
+    }
     const Dtype* top_diff = top[i]->cpu_diff();
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
@@ -48,7 +48,7 @@ void EltwiseLayer<Dtype>::Forward_cpu(
   int* mask = NULL;
   const Dtype* bottom_data_a = NULL;
   const Dtype* bottom_data_b = NULL;
-  const int count = top[0]->count();
+  const int64_t count = top[0]->count();
   Dtype* top_data = top[0]->mutable_cpu_data();
   switch (op_) {
   case EltwiseParameter_EltwiseOp_PROD:
@@ -72,7 +72,7 @@ void EltwiseLayer<Dtype>::Forward_cpu(
     // bottom 0 & 1
     bottom_data_a = bottom[0]->cpu_data();
     bottom_data_b = bottom[1]->cpu_data();
-    for (int idx = 0; idx < count; ++idx) {
+    for (int64_t idx = 0; idx < count; ++idx) {
       if (bottom_data_a[idx] > bottom_data_b[idx]) {
         top_data[idx] = bottom_data_a[idx];  // maxval
         mask[idx] = 0;  // maxid
@@ -84,7 +84,7 @@ void EltwiseLayer<Dtype>::Forward_cpu(
     // bottom 2++
     for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
       bottom_data_b = bottom[blob_idx]->cpu_data();
-      for (int idx = 0; idx < count; ++idx) {
+      for (int64_t idx = 0; idx < count; ++idx) {
         if (bottom_data_b[idx] > top_data[idx]) {
           top_data[idx] = bottom_data_b[idx];  // maxval
           mask[idx] = blob_idx;  // maxid
@@ -101,7 +101,7 @@ template <typename Dtype>
 void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   const int* mask = NULL;
-  const int count = top[0]->count();
+  const int64_t count = top[0]->count();
   const Dtype* top_data = top[0]->cpu_data();
   const Dtype* top_diff = top[0]->cpu_diff();
   for (int i = 0; i < bottom.size(); ++i) {
@@ -136,7 +136,7 @@ void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         break;
       case EltwiseParameter_EltwiseOp_MAX:
         mask = max_idx_.cpu_data();
-        for (int index = 0; index < count; ++index) {
+        for (int64_t index = 0; index < count; ++index) {
           Dtype gradient = 0;
           if (mask[index] == i) {
             gradient += top_diff[index];
@@ -19,7 +19,7 @@ void EuclideanLossLayer<Dtype>::Reshape(
 template <typename Dtype>
 void EuclideanLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  int count = bottom[0]->count();
+  int64_t count = bottom[0]->count();
   caffe_sub(
       count,
       bottom[0]->cpu_data(),
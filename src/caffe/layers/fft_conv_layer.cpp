@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+#include "caffe/layer.hpp"
+#include "caffe/util/fft.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/vision_layers.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  CHECK_EQ(this->num_spatial_axes_, 2)
+      << "FFT convolution only supports 2D convolution.";
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int* kernel_shape = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  // Tiles of four times the kernel keep most of each transform useful, but
+  // there is no point in a tile larger than the (padded) input it covers.
+  const int kernel_max = std::max(kernel_shape[0], kernel_shape[1]);
+  int extent = 0;
+  for (int i = 0; i < 2; ++i) {
+    extent = std::max(extent,
+        (this->output_shape_[i] - 1) * stride[i] + kernel_shape[i]);
+  }
+  const int tile_size = std::min(fft_size(std::max(4 * kernel_max, 16)),
+      fft_size(extent));
+  if (tile_size != tile_size_) {
+    tile_size_ = tile_size;
+    plan_.reset(new FFTPlan<Dtype>(tile_size_));
+    // Force the filter spectra to be recomputed for the new tile size.
+    weight_source_.reset();
+  }
+  const int channels_per_group = this->channels_ / this->group_;
+  input_spectra_.resize(channels_per_group * tile_size_ * tile_size_);
+  output_spectrum_.resize(tile_size_ * tile_size_);
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::UpdateWeightSpectra() {
+  const shared_ptr<SyncedMemory>& weights = this->blobs_[0]->data();
+  if (weight_source_ == weights && weight_version_ == weights->version()) {
+    return;
+  }
+  const int T = tile_size_;
+  const int half = T / 2 + 1;
+  const int kernel_h = this->kernel_shape_.cpu_data()[0];
+  const int kernel_w = this->kernel_shape_.cpu_data()[1];
+  const int channels_per_group = this->channels_ / this->group_;
+  const int filters = this->num_output_ * channels_per_group;
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  weight_spectra_.resize(filters * T * half);
+  vector<std::complex<Dtype> > buffer(T * T);
+  for (int f = 0; f < filters; ++f) {
+    std::fill(buffer.begin(), buffer.end(), std::complex<Dtype>(0));
+    for (int h = 0; h < kernel_h; ++h) {
+      for (int w = 0; w < kernel_w; ++w) {
+        buffer[h * T + w] = weight[(f * kernel_h + h) * kernel_w + w];
+      }
+    }
+    plan_->Forward2D(&buffer[0]);
+    // Conjugating turns the product into a correlation.
+    std::complex<Dtype>* spectrum = &weight_spectra_[f * T * half];
+    for (int u = 0; u < T; ++u) {
+      for (int v = 0; v < half; ++v) {
+        spectrum[u * half + v] = std::conj(buffer[u * T + v]);
+      }
+    }
+  }
+  weight_source_ = weights;
+  weight_version_ = weights->version();
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  UpdateWeightSpectra();
+  const int T = tile_size_;
+  const int half = T / 2 + 1;
+  const Dtype scale = Dtype(1) / (T * T);
+  const int* kernel_shape = this->kernel_shape_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int height = this->input_shape(1);
+  const int width = this->input_shape(2);
+  const int height_out = this->output_shape_[0];
+  const int width_out = this->output_shape_[1];
+  // The stride 1 outputs that the strided outputs are sampled from, and how
+  // many of them each tile produces without wrapping around.
+  const int dense_h = (height_out - 1) * stride[0] + 1;
+  const int dense_w = (width_out - 1) * stride[1] + 1;
+  const int step_h = T - kernel_shape[0] + 1;
+  const int step_w = T - kernel_shape[1] + 1;
+  const int channels_per_group = this->channels_ / this->group_;
+  const int outputs_per_group = this->num_output_ / this->group_;
+  // Complex values are accessed as interleaved (real, imaginary) pairs.
+  Dtype* acc = reinterpret_cast<Dtype*>(&output_spectrum_[0]);
+  const Dtype* in_spectra = reinterpret_cast<const Dtype*>(&input_spectra_[0]);
+  const Dtype* w_spectra = reinterpret_cast<const Dtype*>(&weight_spectra_[0]);
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      const Dtype* input = bottom_data + n * this->bottom_dim_;
+      Dtype* output = top_data + n * this->top_dim_;
+      for (int g = 0; g < this->group_; ++g) {
+        for (int y0 = 0; y0 < dense_h; y0 += step_h) {
+          for (int x0 = 0; x0 < dense_w; x0 += step_w) {
+            for (int c = 0; c < channels_per_group; ++c) {
+              const Dtype* im = input +
+                  (g * channels_per_group + c) * height * width;
+              std::complex<Dtype>* tile = &input_spectra_[c * T * T];
+              for (int r = 0; r < T; ++r) {
+                const int h = y0 + r - pad[0];
+                for (int s = 0; s < T; ++s) {
+                  const int w = x0 + s - pad[1];
+                  tile[r * T + s] = (h >= 0 && h < height && w >= 0 &&
+                      w < width) ? im[h * width + w] : Dtype(0);
+                }
+              }
+              plan_->Forward2D(tile);
+            }
+            for (int o = g * outputs_per_group;
+                 o < (g + 1) * outputs_per_group; ++o) {
+              // The output is real, so only half of its spectrum needs the
+              // products; the rest follows from Hermitian symmetry.
+              caffe_set(2 * T * T, Dtype(0), acc);
+              for (int c = 0; c < channels_per_group; ++c) {
+                const Dtype* x = in_spectra + 2 * c * T * T;
+                const Dtype* w = w_spectra +
+                    2 * (o * channels_per_group + c) * T * half;
+                for (int u = 0; u < T; ++u) {
+                  Dtype* a = acc + 2 * u * T;
+                  const Dtype* xu = x + 2 * u * T;
+                  const Dtype* wu = w + 2 * u * half;
+                  for (int v = 0; v < half; ++v) {
+                    a[2 * v] += xu[2 * v] * wu[2 * v] -
+                        xu[2 * v + 1] * wu[2 * v + 1];
+                    a[2 * v + 1] += xu[2 * v] * wu[2 * v + 1] +
+                        xu[2 * v + 1] * wu[2 * v];
+                  }
+                }
+              }
+              for (int u = 0; u < T; ++u) {
+                const int u_mirror = (T - u) % T;
+                for (int v = half; v < T; ++v) {
+                  output_spectrum_[u * T + v] =
+                      std::conj(output_spectrum_[u_mirror * T + T - v]);
+                }
+              }
+              plan_->Inverse2D(&output_spectrum_[0]);
+              Dtype* out = output + o * height_out * width_out;
+              const int rows = std::min(step_h, dense_h - y0);
+              const int cols = std::min(step_w, dense_w - x0);
+              for (int r = 0; r < rows; ++r) {
+                if ((y0 + r) % stride[0] != 0) { continue; }
+                Dtype* out_row = out + (y0 + r) / stride[0] * width_out;
+                for (int s = 0; s < cols; ++s) {
+                  if ((x0 + s) % stride[1] != 0) { continue; }
+                  out_row[(x0 + s) / stride[1]] =
+                      scale * output_spectrum_[r * T + s].real();
+                }
+              }
+            }
+          }
+        }
+      }
+      if (this->bias_term_ || this->fused_relu_) {
+        this->forward_cpu_bias(output,
+            this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL);
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(FFTConvolutionLayer);
+
+}  // namespace caffe
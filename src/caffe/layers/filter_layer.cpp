@@ -67,10 +67,11 @@ void FilterLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int t = 0; t < top.size(); ++t) {
     const Dtype* bottom_data = bottom[t]->cpu_data();
     Dtype* top_data = top[t]->mutable_cpu_data();
-    int dim = bottom[t]->count() / bottom[t]->shape(0);
+    const int64_t dim = bottom[t]->count() / bottom[t]->shape(0);
     for (int n = 0; n < new_tops_num; ++n) {
-      int data_offset_top = n * dim;
-      int data_offset_bottom = indices_to_forward_[n] * bottom[t]->count(1);
+      const int64_t data_offset_top = n * dim;
+      const int64_t data_offset_bottom =
+          indices_to_forward_[n] * bottom[t]->count(1);
       caffe_copy(dim, bottom_data + data_offset_bottom,
           top_data + data_offset_top);
     }
@@ -88,11 +89,11 @@ void FilterLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     // bottom[last] is the selector and never needs backpropagation
     // so we can iterate over top vector because top.size() == bottom.size() -1
     if (propagate_down[i]) {
-      const int dim = top[i]->count() / top[i]->shape(0);
+      const int64_t dim = top[i]->count() / top[i]->shape(0);
       int next_to_backward_offset = 0;
       int batch_offset = 0;
-      int data_offset_bottom = 0;
-      int data_offset_top = 0;
+      int64_t data_offset_bottom = 0;
+      int64_t data_offset_top = 0;
       for (int n = 0; n < bottom[i]->shape(0); n++) {
         data_offset_bottom = n * dim;
         if (next_to_backward_offset >= indices_to_forward_.size()) {
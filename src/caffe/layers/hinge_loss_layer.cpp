@@ -10,33 +10,39 @@
 
 namespace caffe {
 
+template <typename Dtype>
+void HingeLossLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::Reshape(bottom, top);
+  margin_.ReshapeLike(*bottom[0]);
+}
+
 template <typename Dtype>
 void HingeLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  Dtype* margin = margin_.mutable_cpu_data();
   const Dtype* label = bottom[1]->cpu_data();
   int num = bottom[0]->num();
-  int count = bottom[0]->count();
-  int dim = count / num;
+  int64_t count = bottom[0]->count();
+  int64_t dim = count / num;
 
-  caffe_copy(count, bottom_data, bottom_diff);
+  caffe_copy(count, bottom_data, margin);
   for (int i = 0; i < num; ++i) {
-    bottom_diff[i * dim + static_cast<int>(label[i])] *= -1;
+    margin[i * dim + static_cast<int>(label[i])] *= -1;
   }
   for (int i = 0; i < num; ++i) {
-    for (int j = 0; j < dim; ++j) {
-      bottom_diff[i * dim + j] = std::max(
-        Dtype(0), 1 + bottom_diff[i * dim + j]);
+    for (int64_t j = 0; j < dim; ++j) {
+      margin[i * dim + j] = std::max(Dtype(0), 1 + margin[i * dim + j]);
     }
   }
   Dtype* loss = top[0]->mutable_cpu_data();
   switch (this->layer_param_.hinge_loss_param().norm()) {
   case HingeLossParameter_Norm_L1:
-    loss[0] = caffe_cpu_asum(count, bottom_diff) / num;
+    loss[0] = caffe_cpu_asum(count, margin) / num;
     break;
   case HingeLossParameter_Norm_L2:
-    loss[0] = caffe_cpu_dot(count, bottom_diff, bottom_diff) / num;
+    loss[0] = caffe_cpu_dot(count, margin, margin) / num;
     break;
   default:
     LOG(FATAL) << "Unknown Norm";
@@ -54,9 +60,10 @@ void HingeLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const Dtype* label = bottom[1]->cpu_data();
     int num = bottom[0]->num();
-    int count = bottom[0]->count();
-    int dim = count / num;
+    int64_t count = bottom[0]->count();
+    int64_t dim = count / num;
 
+    caffe_copy(count, margin_.cpu_data(), bottom_diff);
     for (int i = 0; i < num; ++i) {
       bottom_diff[i * dim + static_cast<int>(label[i])] *= -1;
     }
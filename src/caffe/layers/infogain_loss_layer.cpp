@@ -38,7 +38,7 @@ void InfogainLossLayer<Dtype>::Reshape(
   CHECK_EQ(bottom[1]->height(), 1);
   CHECK_EQ(bottom[1]->width(), 1);
   const int num = bottom[0]->num();
-  const int dim = bottom[0]->count() / num;
+  const int64_t dim = bottom[0]->count() / num;
   CHECK_EQ(infogain->num(), 1);
   CHECK_EQ(infogain->channels(), 1);
   CHECK_EQ(infogain->height(), dim);
@@ -58,7 +58,7 @@ void InfogainLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     infogain_mat = bottom[2]->cpu_data();
   }
   int num = bottom[0]->num();
-  int dim = bottom[0]->count() / bottom[0]->num();
+  const int64_t dim = bottom[0]->count() / bottom[0]->num();
   Dtype loss = 0;
   for (int i = 0; i < num; ++i) {
     int label = static_cast<int>(bottom_label[i]);
@@ -93,7 +93,7 @@ void InfogainLossLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     }
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     int num = bottom[0]->num();
-    int dim = bottom[0]->count() / bottom[0]->num();
+    const int64_t dim = bottom[0]->count() / bottom[0]->num();
     const Dtype scale = - top[0]->cpu_diff()[0] / num;
     for (int i = 0; i < num; ++i) {
       const int label = static_cast<int>(bottom_label[i]);
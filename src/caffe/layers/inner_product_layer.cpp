@@ -5,6 +5,8 @@
 #include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/sparse_gemm.hpp"
 #include "caffe/vision_layers.hpp"
 
 namespace caffe {
@@ -14,6 +16,11 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int num_output = this->layer_param_.inner_product_param().num_output();
   bias_term_ = this->layer_param_.inner_product_param().bias_term();
+  fused_relu_ = this->layer_param_.inner_product_param().has_relu_param();
+  relu_negative_slope_ =
+      this->layer_param_.inner_product_param().relu_param().negative_slope();
+  CHECK_GE(relu_negative_slope_, 0)
+      << "relu_param needs a negative_slope of at least 0.";
   N_ = num_output;
   const int axis = bottom[0]->CanonicalAxisIndex(
       this->layer_param_.inner_product_param().axis());
@@ -82,13 +89,31 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
-  if (bias_term_) {
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
-        bias_multiplier_.cpu_data(),
-        this->blobs_[1]->cpu_data(), (Dtype)1., top_data);
+  const float sparse_threshold =
+      this->layer_param_.inner_product_param().sparse_threshold();
+  if (this->phase_ == TEST && sparse_threshold > 0) {
+    sparse_weight_.FromDense(N_, K_, this->blobs_[0]->data(), 0,
+        sparse_threshold);
+  }
+  if (this->phase_ == TEST && sparse_threshold > 0 &&
+      sparse_weight_.is_sparse()) {
+    caffe_cpu_gemm_csrt<Dtype>(M_, (Dtype)1., bottom_data, sparse_weight_,
+        (Dtype)0., top_data);
+  } else if (Caffe::cpu_gemm() == Caffe::PACKED) {
+    // W^T is packed once and reused until the weight blob is written to.
+    packed_weight_.PackRight(CblasTrans, K_, N_, this->blobs_[0]->data(), 0);
+    caffe_cpu_packed_gemm<Dtype>(CblasNoTrans, M_, (Dtype)1., bottom_data,
+        packed_weight_, (Dtype)0., top_data);
+  } else {
+    const Dtype* weight = this->blobs_[0]->cpu_data();
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
+  if (bias_term_ || fused_relu_) {
+    // One pass over the output instead of a rank-1 GEMM plus a ReLU layer.
+    caffe_cpu_bias_relu<Dtype>(M_, N_,
+        bias_term_ ? this->blobs_[1]->cpu_data() : NULL, false, fused_relu_,
+        relu_negative_slope_, top_data);
   }
 }
 
@@ -96,6 +121,11 @@ template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  if (fused_relu_) {
+    // Like a ReLU layer running in place, this overwrites the top diff.
+    caffe_cpu_relu_backward(top[0]->count(), top[0]->cpu_data(),
+        relu_negative_slope_, top[0]->mutable_cpu_diff());
+  }
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
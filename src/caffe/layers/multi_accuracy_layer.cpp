@@ -36,6 +36,9 @@ void MultiAccuracyLayer<Dtype>::Reshape(
   const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top){
   label_axis_ =
       bottom[0]->CanonicalAxisIndex(this->layer_param_.multi_accuracy_param().axis());
+  // The samples and classes are indexed in int.
+  CHECK_LE(bottom[0]->count(), INT_MAX) << this->type()
+      << " takes at most INT_MAX elements.";
   outer_num_ = bottom[0]->count(0, label_axis_);
   inner_num_ = bottom[0]->count(label_axis_ + 1);
   CHECK_EQ(bottom[0]->count(), bottom[1]->count());
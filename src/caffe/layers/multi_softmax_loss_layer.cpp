@@ -36,6 +36,9 @@ void MultiSoftmaxWithLossLayer<Dtype>::Reshape(
   softmax_layer_->Reshape(softmax_bottom_vec_, softmax_top_vec_);
   softmax_axis_ =
       bottom[0]->CanonicalAxisIndex(this->layer_param_.softmax_param().axis());
+  // The samples and classes are indexed in int.
+  CHECK_LE(bottom[0]->count(), INT_MAX) << this->type()
+      << " takes at most INT_MAX elements.";
   outer_num_ = bottom[0]->count(0, softmax_axis_);
   inner_num_ = bottom[0]->count(softmax_axis_ + 1);
   CHECK_EQ(bottom[0]->count(), bottom[1]->count())
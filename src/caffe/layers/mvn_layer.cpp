@@ -10,6 +10,9 @@ namespace caffe {
 template <typename Dtype>
 void MVNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  // The means are taken by gemv, which is indexed in int.
+  CHECK_LE(bottom[0]->count(), INT_MAX) << this->type()
+      << " takes at most INT_MAX elements.";
   top[0]->Reshape(bottom[0]->num(), bottom[0]->channels(),
       bottom[0]->height(), bottom[0]->width());
   mean_.Reshape(bottom[0]->num(), bottom[0]->channels(),
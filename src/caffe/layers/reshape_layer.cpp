@@ -69,7 +69,7 @@ void ReshapeLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (inferred_axis_ >= 0) {
     // A -1 dim was specified; infer the correct dimension by computing the
     // product of the other dimensions.
-    int explicit_count = constant_count_;
+    int64_t explicit_count = constant_count_;
     explicit_count *= bottom[0]->count(0, start_axis);
     explicit_count *= bottom[0]->count(end_axis);
     for (int i = 0; i < copy_axes_.size(); ++i) {
@@ -79,7 +79,9 @@ void ReshapeLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK_EQ(0, bottom[0]->count() % explicit_count) << "bottom count ("
         << bottom[0]->count() << ") must be divisible by the product of "
         << "the specified dimensions (" << explicit_count << ")";
-    const int inferred_dim = bottom[0]->count() / explicit_count;
+    const int64_t inferred_dim = bottom[0]->count() / explicit_count;
+    CHECK_LE(inferred_dim, INT_MAX) << "inferred dimension (" << inferred_dim
+        << ") must fit in int";
     top_shape[start_axis + inferred_axis_] = inferred_dim;
   }
   top[0]->Reshape(top_shape);
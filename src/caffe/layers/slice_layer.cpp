@@ -39,7 +39,7 @@ void SliceLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
   num_slices_ = bottom[0]->count(0, slice_axis_);
   slice_size_ = bottom[0]->count(slice_axis_ + 1);
-  int count = 0;
+  int64_t count = 0;
   if (slice_point_.size() != 0) {
     CHECK_EQ(slice_point_.size(), top.size() - 1);
     CHECK_LE(top.size(), bottom_slice_axis);
@@ -83,9 +83,9 @@ void SliceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < top.size(); ++i) {
     Dtype* top_data = top[i]->mutable_cpu_data();
     const int top_slice_axis = top[i]->shape(slice_axis_);
-    for (int n = 0; n < num_slices_; ++n) {
-      const int top_offset = n * top_slice_axis * slice_size_;
-      const int bottom_offset =
+    for (int64_t n = 0; n < num_slices_; ++n) {
+      const int64_t top_offset = n * top_slice_axis * slice_size_;
+      const int64_t bottom_offset =
           (n * bottom_slice_axis + offset_slice_axis) * slice_size_;
       caffe_copy(top_slice_axis * slice_size_,
           bottom_data + bottom_offset, top_data + top_offset);
@@ -104,9 +104,9 @@ void SliceLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   for (int i = 0; i < top.size(); ++i) {
     const Dtype* top_diff = top[i]->cpu_diff();
     const int top_slice_axis = top[i]->shape(slice_axis_);
-    for (int n = 0; n < num_slices_; ++n) {
-      const int top_offset = n * top_slice_axis * slice_size_;
-      const int bottom_offset =
+    for (int64_t n = 0; n < num_slices_; ++n) {
+      const int64_t top_offset = n * top_slice_axis * slice_size_;
+      const int64_t bottom_offset =
           (n * bottom_slice_axis + offset_slice_axis) * slice_size_;
       caffe_copy(top_slice_axis * slice_size_,
           top_diff + top_offset, bottom_diff + bottom_offset);
@@ -20,6 +20,8 @@ void SplitLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
         "allow in-place computation.";
     top[i]->ReshapeLike(*bottom[0]);
     CHECK_EQ(count_, top[i]->count());
+    // Share here too, so that Net memory planning sees a single buffer.
+    top[i]->ShareData(*bottom[0]);
   }
 }
 
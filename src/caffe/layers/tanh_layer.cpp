@@ -14,8 +14,8 @@ void TanHLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
+  const int64_t count = bottom[0]->count();
+  for (int64_t i = 0; i < count; ++i) {
     top_data[i] = tanh(bottom_data[i]);
   }
 }
@@ -28,9 +28,9 @@ void TanHLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_data = top[0]->cpu_data();
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    const int count = bottom[0]->count();
+    const int64_t count = bottom[0]->count();
     Dtype tanhx;
-    for (int i = 0; i < count; ++i) {
+    for (int64_t i = 0; i < count; ++i) {
       tanhx = top_data[i];
       bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
     }
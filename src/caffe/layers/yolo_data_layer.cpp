@@ -195,6 +195,9 @@ void caffe::YoloDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
 	prefetch_label[offset] = box_coord[coord_id];
       }
     }
+    for (int box_id = 0; box_id < box_coords.size(); box_id++) {
+      delete[] box_coords[box_id];
+    }
 
     trans_time += timer.MicroSeconds();
 
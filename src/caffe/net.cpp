@@ -1,4 +1,11 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <list>
 #include <map>
 #include <set>
 #include <string>
@@ -12,46 +19,277 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/conv_tuner.hpp"
+#include "caffe/util/fuse_activations.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/in_place.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/memory_tracker.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
 namespace caffe {
 
+// Places the host memory of a blob as asked if it is large enough.
+static void PlaceHostMemory(const MemoryPlacement& param, SyncedMemory* mem) {
+  if (mem->size() < param.min_bytes()) {
+    return;
+  }
+  HostPlacement placement;
+  placement.huge_pages = param.huge_pages();
+  if (param.numa() == MemoryPlacement_Numa_LOCAL) {
+    placement.numa = HostPlacement::NUMA_LOCAL;
+  } else if (param.numa() == MemoryPlacement_Numa_INTERLEAVE) {
+    placement.numa = HostPlacement::NUMA_INTERLEAVE;
+  }
+  mem->set_placement(placement);
+}
+
+// Allocates the memory of a blob where the current mode computes.
+static void AllocateMemory(SyncedMemory* mem) {
+  if (Caffe::mode() == Caffe::GPU) {
+    mem->mutable_gpu_data();
+  } else {
+    mem->mutable_cpu_data();
+  }
+}
+
+// Folds the bytes into a 64-bit FNV-1a style hash, eight at a time.
+static uint64_t HashBytes(const void* data, const size_t size,
+    uint64_t hash) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));  // NOLINT(caffe/alt_fn)
+    hash = (hash ^ word) * 1099511628211ULL;
+  }
+  for (; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Whether the layer combines the samples of a batch, so that running it on
+// each micro-batch of the batch gives other results. Layers that are not
+// known to keep the samples apart, such as Python layers, combine them.
+static bool MixesSamples(const LayerParameter& layer) {
+  const string& type = layer.type();
+  if (layer.bottom_size() == 0) {
+    // Data layers start a batch rather than combine one.
+    return false;
+  }
+  if (type == "Concat") {
+    return layer.concat_param().has_axis() ?
+        layer.concat_param().axis() == 0 :
+        layer.concat_param().concat_dim() == 0;
+  }
+  if (type == "Slice") {
+    return layer.slice_param().has_axis() ?
+        layer.slice_param().axis() == 0 : layer.slice_param().slice_dim() == 0;
+  }
+  if (type == "Softmax" || type == "SoftmaxWithLoss") {
+    return layer.softmax_param().axis() == 0;
+  }
+  if (type == "InnerProduct") {
+    return layer.inner_product_param().axis() == 0;
+  }
+  if (type == "Flatten") {
+    return layer.flatten_param().axis() == 0;
+  }
+  if (type == "Tile") {
+    return layer.tile_param().axis() == 0;
+  }
+  if (type == "Reduction") {
+    return layer.reduction_param().axis() == 0;
+  }
+  if (type == "ArgMax") {
+    return layer.argmax_param().has_axis() && layer.argmax_param().axis() == 0;
+  }
+  if (type == "Reshape") {
+    const BlobShape& shape = layer.reshape_param().shape();
+    return layer.reshape_param().axis() == 0 && shape.dim_size() > 0 &&
+        shape.dim(0) > 0;
+  }
+  // The losses and accuracies average over the batch, as the results of
+  // the micro-batches are averaged.
+  return !(type == "AbsVal" || type == "BNLL" || type == "Dropout" ||
+      type == "Exp" || type == "Log" || type == "Power" || type == "PReLU" ||
+      type == "ReLU" || type == "Sigmoid" || type == "TanH" ||
+      type == "Threshold" || type == "Convolution" ||
+      type == "Deconvolution" || type == "Pooling" || type == "LRN" ||
+      type == "SPP" || type == "Im2col" || type == "Eltwise" ||
+      type == "Split" || type == "Silence" || type == "Embed" ||
+      type == "MVN" || type == "Accuracy" || type == "MultiAccuracy" ||
+      type == "EuclideanLoss" || type == "HingeLoss" ||
+      type == "InfogainLoss" || type == "MultinomialLogisticLoss" ||
+      type == "SigmoidCrossEntropyLoss" || type == "ContrastiveLoss" ||
+      type == "MultiSoftmaxWithLoss");
+}
+
+// Finds the layers, in order, that the needed blobs depend on: walking back
+// from the last layer, a layer is needed if it writes a needed blob, and
+// then the blobs it reads are needed as well.
+template <typename BlobKey>
+static vector<int> FindNeededLayers(const vector<vector<BlobKey> >& bottoms,
+    const vector<vector<BlobKey> >& tops, set<BlobKey> needed) {
+  vector<int> layers;
+  for (int i = tops.size() - 1; i >= 0; --i) {
+    bool writes_needed = false;
+    for (int j = 0; j < tops[i].size() && !writes_needed; ++j) {
+      writes_needed = needed.count(tops[i][j]);
+    }
+    if (writes_needed) {
+      layers.push_back(i);
+      needed.insert(bottoms[i].begin(), bottoms[i].end());
+    }
+  }
+  std::reverse(layers.begin(), layers.end());
+  return layers;
+}
+
 template <typename Dtype>
 Net<Dtype>::Net(const NetParameter& param, const Net* root_net)
-    : root_net_(root_net) {
+    : root_net_(root_net), weight_source_(NULL) {
+  Init(param);
+}
+
+template <typename Dtype>
+Net<Dtype>::Net(const NetParameter& param, const Net* root_net,
+    const Net* weight_source)
+    : root_net_(root_net), weight_source_(weight_source) {
   Init(param);
 }
 
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase, const Net* root_net)
-    : root_net_(root_net) {
+    : root_net_(root_net), weight_source_(NULL) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   param.mutable_state()->set_phase(phase);
   Init(param);
 }
 
+template <typename Dtype>
+Net<Dtype>::Net(const string& param_file, Phase phase,
+    const string& trained_filename, const Net* root_net)
+    : root_net_(root_net), weight_source_(NULL) {
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(param_file, &param);
+  param.mutable_state()->set_phase(phase);
+  if (!param.fold_affine_layers()) {
+    Init(param);
+    CopyTrainedLayersFrom(trained_filename);
+    return;
+  }
+  // Folding rewrites the weights, so they must come with the definition.
+  NetParameter trained;
+  if (trained_filename.size() >= 3 &&
+      trained_filename.compare(trained_filename.size() - 3, 3, ".h5") == 0) {
+    NetParameter unfolded(param);
+    unfolded.clear_fold_affine_layers();
+    Net<Dtype> unfolded_net(unfolded, root_net);
+    unfolded_net.CopyTrainedLayersFromHDF5(trained_filename);
+    unfolded_net.ToProto(&trained);
+  } else {
+    ReadNetParamsFromBinaryFileOrDie(trained_filename, &trained);
+  }
+  map<string, int> trained_layer_ids;
+  for (int i = 0; i < trained.layer_size(); ++i) {
+    trained_layer_ids[trained.layer(i).name()] = i;
+  }
+  for (int i = 0; i < param.layer_size(); ++i) {
+    map<string, int>::const_iterator it =
+        trained_layer_ids.find(param.layer(i).name());
+    if (it != trained_layer_ids.end()) {
+      param.mutable_layer(i)->mutable_blobs()->CopyFrom(
+          trained.layer(it->second).blobs());
+    }
+  }
+  Init(param);
+}
+
 template <typename Dtype>
 void Net<Dtype>::Init(const NetParameter& in_param) {
   CHECK(Caffe::root_solver() || root_net_)
       << "root_net_ needs to be set for all non-root solvers";
+  // Fold before anything else, so that replicas and compiled copies, which
+  // start from the definition, do not apply a folded scale twice.
+  if (in_param.fold_affine_layers() && !in_param.compiled() &&
+      in_param.state().phase() == TEST && !in_param.force_backward()) {
+    NetParameter folded_param;
+    const int num_folded = FoldAffineLayers(in_param, &folded_param);
+    LOG_IF(INFO, Caffe::root_solver()) << "Folded " << num_folded
+        << " affine layers into the weights of the layers before them.";
+    folded_param.clear_fold_affine_layers();
+    Init(folded_param);
+    return;
+  }
   // Set phase from the state.
   phase_ = in_param.state().phase();
-  // Filter layers based on their include/exclude rules and
-  // the current NetState.
-  NetParameter filtered_param;
-  FilterNet(in_param, &filtered_param);
-  LOG_IF(INFO, Caffe::root_solver())
-      << "Initializing net from parameters: " << std::endl
-      << filtered_param.DebugString();
-  // Create a copy of filtered_param with splits added where necessary.
+  const bool in_place_neurons = in_param.has_in_place_neurons() ?
+      in_param.in_place_neurons() : Caffe::in_place_neurons();
+  // Keep the definition without weights to build replicas from.
   NetParameter param;
-  InsertSplits(filtered_param, &param);
+  if (in_param.compiled()) {
+    // Copy the weights of a compiled net once, and set them aside while
+    // copying the definition.
+    param.CopyFrom(in_param);
+    vector<google::protobuf::RepeatedPtrField<BlobProto> > weights(
+        param.layer_size());
+    for (int i = 0; i < param.layer_size(); ++i) {
+      param.mutable_layer(i)->mutable_blobs()->Swap(&weights[i]);
+    }
+    replica_param_.CopyFrom(param);
+    for (int i = 0; i < param.layer_size(); ++i) {
+      param.mutable_layer(i)->mutable_blobs()->Swap(&weights[i]);
+    }
+  } else {
+    replica_param_.CopyFrom(in_param);
+    for (int i = 0; i < replica_param_.layer_size(); ++i) {
+      replica_param_.mutable_layer(i)->clear_blobs();
+    }
+  }
+  replica_param_.set_in_place_neurons(in_place_neurons);
+  const int layer_threads = in_param.has_layer_threads() ?
+      in_param.layer_threads() : Caffe::layer_threads();
+  replica_param_.set_layer_threads(layer_threads);
+  if (in_param.compiled()) {
+    // The layers were filtered, rewritten and split when compiled.
+    LOG_IF(INFO, Caffe::root_solver()) << "Initializing compiled net "
+        << in_param.name() << " of " << in_param.layer_size() << " layers.";
+  } else {
+    // Filter layers based on their include/exclude rules and
+    // the current NetState.
+    NetParameter filtered_param;
+    FilterNet(in_param, &filtered_param);
+    if (in_place_neurons) {
+      NetParameter in_place_param;
+      RunNeuronsInPlace(filtered_param, &in_place_param);
+      filtered_param.Swap(&in_place_param);
+    }
+    if (in_param.fuse_activations() && phase_ == TEST &&
+        !in_param.force_backward() && Caffe::mode() == Caffe::CPU) {
+      NetParameter fused_param;
+      FuseActivations(filtered_param, &fused_param);
+      filtered_param.Swap(&fused_param);
+    }
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Initializing net from parameters: " << std::endl
+        << filtered_param.DebugString();
+    // Create a copy of filtered_param with splits added where necessary.
+    InsertSplits(filtered_param, &param);
+    if (in_param.elide_splits()) {
+      NetParameter elided_param;
+      const int num_elided = ElideSplits(param, &elided_param);
+      param.Swap(&elided_param);
+      LOG_IF(INFO, Caffe::root_solver())
+          << "Left out " << num_elided << " Split layers.";
+    }
+  }
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
   map<string, int> blob_name_to_idx;
@@ -72,6 +310,18 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     const int layer_id = -1;  // inputs have fake layer ID -1
     AppendTop(param, layer_id, input_id, &available_blobs, &blob_name_to_idx);
   }
+  // Set up the layers for the largest batch, so that smaller ones fit.
+  max_batch_size_ = param.max_batch_size();
+  vector<int> input_batch_sizes;
+  for (int i = 0; i < net_input_blobs_.size() && max_batch_size_ > 0; ++i) {
+    vector<int> shape = net_input_blobs_[i]->shape();
+    CHECK(!shape.empty() && shape[0] <= max_batch_size_)
+        << "Input " << blob_names_[net_input_blob_indices_[i]]
+        << " needs a batch of at most max_batch_size " << max_batch_size_;
+    input_batch_sizes.push_back(shape[0]);
+    shape[0] = max_batch_size_;
+    net_input_blobs_[i]->Reshape(shape);
+  }
   int break_point = 0;
   LOG(INFO) << "Break point" << break_point++;
   // For each layer, set up its input and output
@@ -81,7 +331,13 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   param_id_vecs_.resize(param.layer_size());
   top_id_vecs_.resize(param.layer_size());
   bottom_need_backward_.resize(param.layer_size());
+  shared_ptr<ConvolutionTuner<Dtype> > conv_tuner;
+  memory_owner_ = MemoryTracker::Owner(name_);
   for (int layer_id = 0; layer_id < param.layer_size(); ++layer_id) {
+    // Count the memory allocated by the layer, from its setup on, against it.
+    layer_memory_owners_.push_back(
+        MemoryTracker::Owner(name_ + "/" + param.layer(layer_id).name()));
+    MemoryTracker::Scope memory_scope(layer_memory_owners_[layer_id]);
     // For non-root solvers, whether this layer is shared from root_net_.
     bool share_from_root = !Caffe::root_solver()
         && root_net_->layers_[layer_id]->ShareInParallel();
@@ -89,6 +345,46 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     if (!param.layer(layer_id).has_phase()) {
       param.mutable_layer(layer_id)->set_phase(phase_);
     }
+    // Inherit the sparse weight threshold from net if unset.
+    if (param.has_sparse_threshold()) {
+      LayerParameter* layer = param.mutable_layer(layer_id);
+      if (layer->type() == "Convolution" &&
+          !layer->convolution_param().has_sparse_threshold()) {
+        layer->mutable_convolution_param()->set_sparse_threshold(
+            param.sparse_threshold());
+      } else if (layer->type() == "InnerProduct" &&
+          !layer->inner_product_param().has_sparse_threshold()) {
+        layer->mutable_inner_product_param()->set_sparse_threshold(
+            param.sparse_threshold());
+      }
+    }
+    // Time the CPU convolution algorithms on the actual input shape unless
+    // the layer picks its own.
+    if (param.tune_convolution() && Caffe::mode() == Caffe::CPU &&
+        !share_from_root && param.layer(layer_id).type() == "Convolution" &&
+        param.layer(layer_id).bottom_size() > 0) {
+      LayerParameter* layer = param.mutable_layer(layer_id);
+      const ConvolutionParameter& conv_param = layer->convolution_param();
+      map<string, int>::const_iterator bottom =
+          blob_name_to_idx.find(layer->bottom(0));
+      if (bottom != blob_name_to_idx.end() &&
+          conv_param.engine() != ConvolutionParameter_Engine_CUDNN &&
+          conv_param.engine() != ConvolutionParameter_Engine_FFT &&
+          conv_param.cpu_algorithm() ==
+          ConvolutionParameter_CpuAlgorithm_AUTO) {
+        if (!conv_tuner) {
+          conv_tuner.reset(new ConvolutionTuner<Dtype>(param.tuning_cache()));
+        }
+        conv_tuner->Tune(blobs_[bottom->second]->shape(), layer);
+        // Replicas use the choice without tuning again.
+        for (int i = 0; i < replica_param_.layer_size(); ++i) {
+          if (replica_param_.layer(i).name() == layer->name()) {
+            replica_param_.mutable_layer(i)->mutable_convolution_param()->
+                CopyFrom(layer->convolution_param());
+          }
+        }
+      }
+    }
     // Setup layer.
     const LayerParameter& layer_param = param.layer(layer_id);
     if (layer_param.propagate_down_size() > 0) {
@@ -102,8 +398,33 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       layers_.push_back(root_net_->layers_[layer_id]);
       layers_[layer_id]->SetShared(true);
     } else {
+      // Set the weights aside, so that the layer does not copy them along
+      // with its LayerParameter, and load them into its blobs directly.
+      google::protobuf::RepeatedPtrField<BlobProto> weights;
+      param.mutable_layer(layer_id)->mutable_blobs()->Swap(&weights);
       layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
+      if (weights.size() > 0) {
+        vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[layer_id]->blobs();
+        blobs.resize(weights.size());
+        for (int j = 0; j < weights.size(); ++j) {
+          blobs[j].reset(new Blob<Dtype>());
+          blobs[j]->FromProto(weights.Get(j));
+        }
+      }
+      // With its weights in place the layer skips creating and filling them.
+      if (weight_source_ && weight_source_->has_layer(layer_param.name())) {
+        const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+            weight_source_->layer_by_name(layer_param.name())->blobs();
+        vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[layer_id]->blobs();
+        blobs.resize(source_blobs.size());
+        for (int j = 0; j < source_blobs.size(); ++j) {
+          blobs[j].reset(new Blob<Dtype>(source_blobs[j]->shape()));
+          blobs[j]->ShareData(*source_blobs[j]);
+        }
+      }
     }
+    // The layer holds any weights given with it now.
+    param.mutable_layer(layer_id)->clear_blobs();
     layer_names_.push_back(layer_param.name());
     LOG_IF(INFO, Caffe::root_solver())
         << "Creating Layer " << layer_param.name();
@@ -269,6 +590,45 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       }
     }
   }
+  // Only the diffs that Backward reads or writes are ever allocated.
+  blob_diff_used_.assign(blobs_.size(), false);
+  size_t diff_memory = 0;
+  size_t full_diff_memory = 0;
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      if (layer_need_backward_[layer_id] || layers_[layer_id]->loss(top_id)) {
+        blob_diff_used_[top_id_vecs_[layer_id][top_id]] = true;
+      }
+    }
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+         ++bottom_id) {
+      if (bottom_need_backward_[layer_id][bottom_id]) {
+        blob_diff_used_[bottom_id_vecs_[layer_id][bottom_id]] = true;
+      }
+    }
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    full_diff_memory += blobs_[blob_id]->count();
+    if (blob_diff_used_[blob_id]) {
+      diff_memory += blobs_[blob_id]->count();
+    }
+  }
+  params_need_backward_.assign(learnable_params_.size(), false);
+  for (int param_id = 0; param_id < params_.size(); ++param_id) {
+    const pair<int, int>& index = param_layer_indices_[param_id];
+    if (layers_[index.first]->param_propagate_down(index.second)) {
+      params_need_backward_[learnable_param_ids_[param_id]] = true;
+    }
+  }
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    full_diff_memory += learnable_params_[i]->count();
+    if (params_need_backward_[i]) {
+      diff_memory += learnable_params_[i]->count();
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory required for diffs: " << diff_memory * sizeof(Dtype)
+      << " (" << full_diff_memory * sizeof(Dtype) << " for all blobs).";
   // In the end, all remaining blobs are considered output blobs.
   for (set<string>::iterator it = available_blobs.begin();
       it != available_blobs.end(); ++it) {
@@ -285,6 +645,72 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   }
   ShareWeights();
   debug_info_ = param.debug_info();
+  check_unused_diffs_ = param.check_unused_diffs();
+  plan_memory_ = param.plan_memory() && phase_ == TEST;
+  LOG_IF(WARNING, param.plan_memory() && phase_ != TEST)
+      << "plan_memory is ignored outside the TEST phase.";
+  for (int i = 0; i < param.preserve_blob_size(); ++i) {
+    CHECK(has_blob(param.preserve_blob(i)))
+        << "Unknown blob to preserve " << param.preserve_blob(i);
+    preserved_blob_ids_.insert(blob_names_index_[param.preserve_blob(i)]);
+  }
+  // Each layer reshapes in its first Forward.
+  reshaped_shapes_.assign(layers_.size(), vector<vector<int> >());
+  reshaped_memory_.assign(layers_.size(), vector<const SyncedMemory*>());
+  micro_batch_size_ = phase_ == TEST ? param.micro_batch_size() : 0;
+  for (int i = 0; i < layers_.size() && micro_batch_size_ > 0; ++i) {
+    if (MixesSamples(layers_[i]->layer_param())) {
+      LOG(WARNING) << "Not pipelining over micro-batches, as "
+          << layer_names_[i] << " combines the samples of a batch.";
+      micro_batch_size_ = 0;
+    }
+  }
+  if (param.has_cache_blob() && phase_ == TEST) {
+    InitForwardCache(param);
+  }
+  LOG_IF(WARNING, param.has_cache_blob() && phase_ != TEST)
+      << "cache_blob is ignored outside the TEST phase.";
+  pipeline_stages_ = param.pipeline_stages();
+  LOG_IF(WARNING, param.micro_batch_size() > 0 && phase_ != TEST)
+      << "micro_batch_size is ignored outside the TEST phase.";
+  checkpointing_ = param.gradient_checkpointing() && phase_ == TRAIN;
+  materialized_segment_ = -1;
+  if (checkpointing_) {
+    InitCheckpointSegments(param);
+  }
+  param_placement_ = param.param_placement();
+  activation_placement_ = param.activation_placement();
+  InitFanOuts();
+  PlanMemory();
+  PlaceMemory();
+  if (max_batch_size_ > 0) {
+    // Allocate what the first Forward of the largest batch would, except for
+    // the buffers inside the layers, and give the inputs their own batch.
+    for (int i = 0; i < net_input_blobs_.size(); ++i) {
+      MemoryTracker::Scope memory_scope(memory_owner_);
+      if (net_input_blobs_[i]->count() > 0) {
+        AllocateMemory(net_input_blobs_[i]->data().get());
+      }
+      vector<int> shape = net_input_blobs_[i]->shape();
+      shape[0] = input_batch_sizes[i];
+      net_input_blobs_[i]->Reshape(shape);
+    }
+    for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+      MemoryTracker::Scope memory_scope(layer_memory_owners_[layer_id]);
+      for (int i = 0; i < top_vecs_[layer_id].size(); ++i) {
+        Blob<Dtype>* top = top_vecs_[layer_id][i];
+        if (top->count() == 0) { continue; }
+        AllocateMemory(top->data().get());
+        if (blob_diff_used_[top_id_vecs_[layer_id][i]]) {
+          AllocateMemory(top->diff().get());
+        }
+      }
+    }
+    // The other blobs follow the inputs back to their batch, keeping the
+    // memory for the largest one.
+    Reshape();
+  }
+  ScheduleLayers(layer_threads);
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
@@ -453,7 +879,8 @@ int Net<Dtype>::AppendBottom(const NetParameter& param, const int layer_id,
     map<string, int>* blob_name_to_idx) {
   const LayerParameter& layer_param = param.layer(layer_id);
   const string& blob_name = layer_param.bottom(bottom_id);
-  if (available_blobs->find(blob_name) == available_blobs->end()) {
+  // Without Split layers, several layers may read a blob (see InitFanOuts).
+  if (blob_name_to_idx->find(blob_name) == blob_name_to_idx->end()) {
     LOG(FATAL) << "Unknown bottom blob '" << blob_name << "' (layer '"
                << layer_param.name() << "', bottom index " << bottom_id << ")";
   }
@@ -568,22 +995,207 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
   }
 }
 
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardLayer(const int layer_id) {
+  ShareFanOutData(layer_id);
+  const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+  // Reshape only computes the tops and buffers from the bottom shapes, and
+  // shares the memory of the bottoms (e.g. Split) that data layers replace.
+  bool reshape = bottom.empty() || layers_[layer_id]->ShapeDependsOnData() ||
+      reshaped_shapes_[layer_id].size() != bottom.size();
+  for (int i = 0; i < bottom.size() && !reshape; ++i) {
+    reshape = bottom[i]->shape() != reshaped_shapes_[layer_id][i] ||
+        (bottom[i]->count() && (
+        bottom[i]->data().get() != reshaped_memory_[layer_id][2 * i] ||
+        bottom[i]->diff().get() != reshaped_memory_[layer_id][2 * i + 1]));
+  }
+  const Dtype loss = layers_[layer_id]->Forward(bottom,
+      top_vecs_[layer_id], reshape);
+  if (reshape) {
+    RememberBottoms(layer_id);
+  }
+  return loss;
+}
+
+template <typename Dtype>
+void Net<Dtype>::CheckBatchSize() const {
+  for (int i = 0; i < net_input_blobs_.size() && max_batch_size_ > 0; ++i) {
+    CHECK_LE(net_input_blobs_[i]->shape(0), max_batch_size_)
+        << "The batch of input " << blob_names_[net_input_blob_indices_[i]]
+        << " exceeds max_batch_size.";
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::RememberBottoms(const int layer_id) {
+  const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+  vector<vector<int> >& shapes = reshaped_shapes_[layer_id];
+  vector<const SyncedMemory*>& memory = reshaped_memory_[layer_id];
+  shapes.resize(bottom.size());
+  memory.assign(2 * bottom.size(), NULL);
+  for (int i = 0; i < bottom.size(); ++i) {
+    shapes[i] = bottom[i]->shape();
+    if (bottom[i]->count()) {
+      memory[2 * i] = bottom[i]->data().get();
+      memory[2 * i + 1] = bottom[i]->diff().get();
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitFanOuts() {
+  // A layer reads a blob as its last writer left it, so the readers of a
+  // blob between two writers (e.g. in-place layers) read the same values.
+  map<pair<int, int>, vector<pair<int, int> > > readers;
+  vector<int> last_writer(blobs_.size(), -1);
+  bottom_fan_outs_.resize(layers_.size());
+  for (int i = 0; i < layers_.size(); ++i) {
+    bottom_fan_outs_[i].assign(bottom_id_vecs_[i].size(), -1);
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      const int blob_id = bottom_id_vecs_[i][j];
+      readers[make_pair(blob_id, last_writer[blob_id])].push_back(
+          make_pair(i, j));
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      last_writer[top_id_vecs_[i][j]] = i;
+    }
+  }
+  for (map<pair<int, int>, vector<pair<int, int> > >::const_iterator it =
+       readers.begin(); it != readers.end(); ++it) {
+    const vector<pair<int, int> >& reads = it->second;
+    if (reads.size() < 2) { continue; }
+    const int blob_id = it->first.first;
+    // The last reader that needs the gradient runs first in Backward, and
+    // writes the diff of the blob itself.
+    int direct = reads.size() - 1;
+    while (direct > 0 &&
+        !bottom_need_backward_[reads[direct].first][reads[direct].second]) {
+      --direct;
+    }
+    const int fan_out = fan_out_diffs_.size();
+    fan_out_diffs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    fan_out_diffs_.back()->ReshapeLike(*blobs_[blob_id]);
+    fan_out_layers_.push_back(vector<int>());
+    for (int k = 0; k < reads.size(); ++k) {
+      const int layer_id = reads[k].first;
+      CHECK(k == 0 || reads[k - 1].first != layer_id)
+          << layer_names_[layer_id] << " reads " << blob_names_[blob_id]
+          << " twice, which needs a Split.";
+      const vector<int>& tops = top_id_vecs_[layer_id];
+      CHECK(std::find(tops.begin(), tops.end(), blob_id) == tops.end())
+          << layer_names_[layer_id] << " overwrites " << blob_names_[blob_id]
+          << " that other layers read, which needs a Split.";
+      bottom_fan_outs_[layer_id][reads[k].second] = fan_out;
+      fan_out_layers_.back().push_back(layer_id);
+      if (k != direct) {
+        fan_out_proxies_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        bottom_vecs_[layer_id][reads[k].second] = fan_out_proxies_.back().get();
+        ShareFanOutData(layer_id);
+      }
+    }
+  }
+  fan_out_written_.assign(fan_out_diffs_.size(), 0);
+  LOG_IF(INFO, Caffe::root_solver() && !fan_out_diffs_.empty())
+      << fan_out_diffs_.size() << " blobs are read by several layers.";
+}
+
+template <typename Dtype>
+void Net<Dtype>::ShareFanOutData(const int layer_id) {
+  for (int i = 0; i < bottom_vecs_[layer_id].size(); ++i) {
+    Blob<Dtype>* proxy = bottom_vecs_[layer_id][i];
+    const Blob<Dtype>& blob = *blobs_[bottom_id_vecs_[layer_id][i]];
+    if (proxy != &blob) {
+      proxy->ReshapeLike(blob);
+      if (blob.count() > 0) {
+        proxy->ShareData(blob);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::BackwardLayer(const int layer_id) {
+  const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+  const vector<bool>& need_backward = bottom_need_backward_[layer_id];
+  const vector<int>& fan_outs = bottom_fan_outs_[layer_id];
+  for (int i = 0; i < bottom.size(); ++i) {
+    if (bottom[i] != blobs_[bottom_id_vecs_[layer_id][i]].get() &&
+        need_backward[i] && bottom[i]->count() > 0) {
+      Blob<Dtype>* diff = fan_out_diffs_[fan_outs[i]].get();
+      diff->ReshapeLike(*bottom[i]);
+      bottom[i]->ShareDiff(*diff);
+    }
+  }
+  layers_[layer_id]->Backward(top_vecs_[layer_id], need_backward, bottom);
+  // Add the gradients of the proxies to what the later readers wrote.
+  for (int i = 0; i < bottom.size(); ++i) {
+    if (fan_outs[i] < 0 || !need_backward[i]) { continue; }
+    Blob<Dtype>* blob = blobs_[bottom_id_vecs_[layer_id][i]].get();
+    const bool written = fan_out_written_[fan_outs[i]];
+    fan_out_written_[fan_outs[i]] = true;
+    if (bottom[i] == blob || blob->count() == 0) { continue; }
+    switch (Caffe::mode()) {
+    case Caffe::CPU:
+      if (written) {
+        caffe_axpy(blob->count(), Dtype(1), bottom[i]->cpu_diff(),
+            blob->mutable_cpu_diff());
+      } else {
+        caffe_copy(blob->count(), bottom[i]->cpu_diff(),
+            blob->mutable_cpu_diff());
+      }
+      break;
+    case Caffe::GPU:
+#ifndef CPU_ONLY
+      if (written) {
+        caffe_gpu_axpy(blob->count(), Dtype(1), bottom[i]->gpu_diff(),
+            blob->mutable_gpu_diff());
+      } else {
+        caffe_copy(blob->count(), bottom[i]->gpu_diff(),
+            blob->mutable_gpu_diff());
+      }
+#else
+      NO_GPU;
+#endif
+      break;
+    }
+  }
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
+  CheckBatchSize();
   Dtype loss = 0;
   if (debug_info_) {
     for (int i = 0; i < net_input_blobs_.size(); ++i) {
       InputDebugInfo(i);
     }
   }
+  if (layer_pool_ && !debug_info_ && Caffe::mode() == Caffe::CPU) {
+    loss = RunLayersInParallel(start, end, true);
+    if (check_unused_diffs_) { CheckUnusedDiffs(); }
+    return loss;
+  }
   for (int i = start; i <= end; ++i) {
+    // Remember the random state for recomputing the segment in Backward.
+    if (checkpointing_ && segment_starts_[layer_segment_[i]] == i) {
+      segment_rngs_[layer_segment_[i]] = *caffe_rng();
+    }
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
-    Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    MemoryTracker::Scope memory_scope(layer_memory_owners_[i]);
+    Dtype layer_loss = ForwardLayer(i);
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
   }
+  if (checkpointing_) {
+    // Later segments overwrite the activations of earlier ones, so only the
+    // last segment run completely is current.
+    const int segment_id = layer_segment_[end];
+    materialized_segment_ =
+        (start <= segment_starts_[segment_id]) ? segment_id : -1;
+  }
+  if (check_unused_diffs_) { CheckUnusedDiffs(); }
   return loss;
 }
 
@@ -599,6 +1211,16 @@ Dtype Net<Dtype>::ForwardTo(int end) {
 
 template <typename Dtype>
 const vector<Blob<Dtype>*>& Net<Dtype>::ForwardPrefilled(Dtype* loss) {
+  if (forward_cache_) {
+    const Dtype cached_loss = ForwardCached();
+    if (loss != NULL) {
+      *loss = cached_loss;
+    }
+    return net_output_blobs_;
+  }
+  if (micro_batch_size_ > 0 && Caffe::mode() == Caffe::CPU && !debug_info_) {
+    return ForwardPipelined(micro_batch_size_, pipeline_stages_, loss);
+  }
   if (loss != NULL) {
     *loss = ForwardFromTo(0, layers_.size() - 1);
   } else {
@@ -607,6 +1229,61 @@ const vector<Blob<Dtype>*>& Net<Dtype>::ForwardPrefilled(Dtype* loss) {
   return net_output_blobs_;
 }
 
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardPruned(const vector<string>& blob_names) {
+  vector<int> blob_ids;
+  for (int i = 0; i < blob_names.size(); ++i) {
+    CHECK(has_blob(blob_names[i])) << "Unknown blob name " << blob_names[i];
+    blob_ids.push_back(blob_names_index_[blob_names[i]]);
+    // Later layers must not reuse the memory of the blobs under a plan.
+    if (plan_memory_) {
+      PreserveBlob(blob_names[i]);
+    }
+  }
+  std::sort(blob_ids.begin(), blob_ids.end());
+  blob_ids.erase(std::unique(blob_ids.begin(), blob_ids.end()),
+      blob_ids.end());
+  CheckBatchSize();
+  if (micro_batch_size_ > 0 && Caffe::mode() == Caffe::CPU && !debug_info_) {
+    return RunPipeline(micro_batch_size_, pipeline_stages_,
+        set<int>(blob_ids.begin(), blob_ids.end()));
+  }
+  map<vector<int>, vector<int> >::iterator plan =
+      pruned_layers_.find(blob_ids);
+  if (plan == pruned_layers_.end()) {
+    vector<int> layer_ids = FindNeededLayers(bottom_id_vecs_, top_id_vecs_,
+        set<int>(blob_ids.begin(), blob_ids.end()));
+    // The data layers always run, so that their cursors stay in step.
+    for (int i = 0; i < layers_.size(); ++i) {
+      if (bottom_vecs_[i].empty() && !top_vecs_[i].empty()) {
+        layer_ids.push_back(i);
+      }
+    }
+    std::sort(layer_ids.begin(), layer_ids.end());
+    layer_ids.erase(std::unique(layer_ids.begin(), layer_ids.end()),
+        layer_ids.end());
+    plan = pruned_layers_.insert(make_pair(blob_ids, layer_ids)).first;
+    LOG_IF(INFO, Caffe::root_solver()) << "Forward of " << blob_ids.size()
+        << " blobs runs " << plan->second.size() << " of " << layers_.size()
+        << " layers.";
+  }
+  const vector<int>& layer_ids = plan->second;
+  if (debug_info_) {
+    for (int i = 0; i < net_input_blobs_.size(); ++i) {
+      InputDebugInfo(i);
+    }
+  }
+  Dtype loss = 0;
+  for (int i = 0; i < layer_ids.size(); ++i) {
+    MemoryTracker::Scope memory_scope(layer_memory_owners_[layer_ids[i]]);
+    loss += ForwardLayer(layer_ids[i]);
+    if (debug_info_) { ForwardDebugInfo(layer_ids[i]); }
+  }
+  // Skipped layers may have left any segment incomplete.
+  materialized_segment_ = -1;
+  return loss;
+}
+
 template <typename Dtype>
 const vector<Blob<Dtype>*>& Net<Dtype>::Forward(
     const vector<Blob<Dtype>*> & bottom, Dtype* loss) {
@@ -642,13 +1319,23 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  fan_out_written_.assign(fan_out_written_.size(), 0);
+  if (layer_pool_ && !debug_info_ && Caffe::mode() == Caffe::CPU) {
+    RunLayersInParallel(start, end, false);
+    if (check_unused_diffs_) { CheckUnusedDiffs(); }
+    return;
+  }
   for (int i = start; i >= end; --i) {
     if (layer_need_backward_[i]) {
-      layers_[i]->Backward(
-          top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      if (checkpointing_ && layer_segment_[i] != materialized_segment_) {
+        RecomputeSegment(layer_segment_[i]);
+      }
+      MemoryTracker::Scope memory_scope(layer_memory_owners_[i]);
+      BackwardLayer(i);
       if (debug_info_) { BackwardDebugInfo(i); }
     }
   }
+  if (check_unused_diffs_) { CheckUnusedDiffs(); }
 }
 
 template <typename Dtype>
@@ -740,6 +1427,32 @@ void Net<Dtype>::UpdateDebugInfo(const int param_id) {
   }
 }
 
+template <typename Dtype>
+shared_ptr<Net<Dtype> > Net<Dtype>::Replicate() const {
+  NetParameter param(replica_param_);
+  if (phase_ == TEST) {
+    param.set_plan_memory(true);
+  }
+  for (set<int>::const_iterator it = preserved_blob_ids_.begin();
+       it != preserved_blob_ids_.end(); ++it) {
+    param.add_preserve_blob(blob_names_[*it]);
+  }
+  return ReplicateFrom(param);
+}
+
+template <typename Dtype>
+shared_ptr<Net<Dtype> > Net<Dtype>::ReplicateFrom(
+    const NetParameter& in_param) const {
+  shared_ptr<Net<Dtype> > replica(new Net<Dtype>(in_param, NULL, this));
+  CHECK_EQ(params_.size(), replica->params_.size());
+  for (int i = 0; i < params_.size(); ++i) {
+    CHECK(params_[i]->shape() == replica->params_[i]->shape())
+        << "Replica param " << param_display_names_[i] << " differs in shape";
+    replica->params_[i]->ShareData(*params_[i]);
+  }
+  return replica;
+}
+
 template <typename Dtype>
 void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   int num_source_layers = other->layers().size();
@@ -770,6 +1483,9 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
       target_blobs[j]->ShareData(*source_blob);
     }
   }
+  // The pipeline replicas still share the previous weights.
+  pipeline_.reset();
+  ClearForwardCache();
 }
 
 template <typename Dtype>
@@ -803,8 +1519,1058 @@ void Net<Dtype>::Backward() {
 
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
+  CheckBatchSize();
   for (int i = 0; i < layers_.size(); ++i) {
+    MemoryTracker::Scope memory_scope(layer_memory_owners_[i]);
+    ShareFanOutData(i);
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    RememberBottoms(i);
+  }
+  // Smaller batches keep the memory set up for the largest one.
+  if (max_batch_size_ == 0) {
+    PlanMemory();
+    PlaceMemory();
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::LogMemoryUsage() const {
+  const bool gpu = Caffe::mode() == Caffe::GPU;
+  LOG(INFO) << "Memory usage of " << name_ << " in bytes (current / peak):";
+  vector<int> owners(layer_memory_owners_);
+  vector<string> names(layer_names_);
+  owners.push_back(memory_owner_);
+  names.push_back("(arena)");
+  for (int i = 0; i < owners.size(); ++i) {
+    const MemoryTracker::Usage host =
+        MemoryTracker::GetUsage(owners[i], MemoryTracker::HOST);
+    const MemoryTracker::Usage device =
+        MemoryTracker::GetUsage(owners[i], MemoryTracker::GPU);
+    ostringstream line;
+    line << std::setfill(' ') << std::setw(10) << names[i] << "\thost: "
+        << host.bytes << " / " << host.peak_bytes;
+    if (gpu) {
+      line << "\tgpu: " << device.bytes << " / " << device.peak_bytes;
+    }
+    LOG(INFO) << line.str();
+  }
+  const MemoryTracker::Usage host =
+      MemoryTracker::GetTotal(MemoryTracker::HOST);
+  ostringstream total;
+  total << "Total memory: host " << host.bytes << " / " << host.peak_bytes;
+  if (gpu) {
+    const MemoryTracker::Usage device =
+        MemoryTracker::GetTotal(MemoryTracker::GPU);
+    total << ", gpu " << device.bytes << " / " << device.peak_bytes;
+  }
+  LOG(INFO) << total.str();
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlaceMemory() {
+  // Blobs that borrow their data from the memory arena only record the
+  // placement; the arena itself is placed by PlanMemory.
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    if (learnable_params_[i]->count() == 0) { continue; }
+    PlaceHostMemory(param_placement_, learnable_params_[i]->data().get());
+    PlaceHostMemory(param_placement_, learnable_params_[i]->diff().get());
+  }
+  for (int i = 0; i < blobs_.size(); ++i) {
+    if (blobs_[i]->count() == 0) { continue; }
+    PlaceHostMemory(activation_placement_, blobs_[i]->data().get());
+    PlaceHostMemory(activation_placement_, blobs_[i]->diff().get());
+  }
+  for (int i = 0; i < fan_out_diffs_.size(); ++i) {
+    if (fan_out_diffs_[i]->count() == 0) { continue; }
+    PlaceHostMemory(activation_placement_, fan_out_diffs_[i]->diff().get());
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::FindBuffers(map<SyncedMemory*, int>* buffer_ids,
+    vector<shared_ptr<SyncedMemory> >* buffers, vector<int>* first_use,
+    vector<int>* last_use, vector<bool>* plannable) const {
+  // Blobs that share data (in-place layers, Split, Flatten, ...) form one
+  // buffer, live from the first layer that uses any of them to the last.
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int i = 0; i < 2; ++i) {
+      const vector<Blob<Dtype>*>& blobs = i ? top_vecs_[layer_id] :
+          bottom_vecs_[layer_id];
+      for (int j = 0; j < blobs.size(); ++j) {
+        if (blobs[j]->count() == 0) { continue; }
+        const shared_ptr<SyncedMemory>& buffer = blobs[j]->data();
+        map<SyncedMemory*, int>::iterator it = buffer_ids->find(buffer.get());
+        if (it == buffer_ids->end()) {
+          it = buffer_ids->insert(make_pair(buffer.get(),
+              static_cast<int>(buffers->size()))).first;
+          buffers->push_back(buffer);
+          first_use->push_back(layer_id);
+          last_use->push_back(layer_id);
+          plannable->push_back(true);
+        }
+        (*last_use)[it->second] = layer_id;
+        // Data layers may fill their tops from elsewhere, e.g. set_cpu_data.
+        if (bottom_vecs_[layer_id].size() == 0) {
+          (*plannable)[it->second] = false;
+        }
+      }
+    }
+  }
+  // The caller writes the inputs before Forward.
+  for (int i = 0; i < net_input_blobs_.size(); ++i) {
+    if (net_input_blobs_[i]->count() == 0) { continue; }
+    map<SyncedMemory*, int>::iterator it =
+        buffer_ids->find(net_input_blobs_[i]->data().get());
+    if (it != buffer_ids->end()) {
+      (*plannable)[it->second] = false;
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanMemory() {
+  if (!plan_memory_ && !checkpointing_) {
+    return;
+  }
+  const int num_layers = layers_.size();
+  map<SyncedMemory*, int> buffer_ids;
+  vector<shared_ptr<SyncedMemory> > buffers;
+  vector<int> first_use, last_use;
+  vector<bool> plannable;
+  FindBuffers(&buffer_ids, &buffers, &first_use, &last_use, &plannable);
+  // The outputs and preserved blobs stay live until Forward ends.
+  vector<int> kept_blob_ids(net_output_blob_indices_);
+  kept_blob_ids.insert(kept_blob_ids.end(), preserved_blob_ids_.begin(),
+      preserved_blob_ids_.end());
+  for (int i = 0; i < kept_blob_ids.size(); ++i) {
+    const Blob<Dtype>* blob = blobs_[kept_blob_ids[i]].get();
+    if (blob->count() == 0) { continue; }
+    map<SyncedMemory*, int>::iterator it =
+        buffer_ids.find(blob->data().get());
+    if (it != buffer_ids.end()) {
+      last_use[it->second] = num_layers;
+    }
+  }
+  if (checkpointing_) {
+    // A buffer used within one segment only is recomputed with it and so is
+    // live for just that segment; the others are never overwritten.
+    for (int i = 0; i < buffers.size(); ++i) {
+      if (last_use[i] == num_layers ||
+          layer_segment_[first_use[i]] != layer_segment_[last_use[i]]) {
+        plannable[i] = false;
+      } else {
+        first_use[i] = last_use[i] = layer_segment_[first_use[i]];
+      }
+    }
+  }
+  // Place the largest buffers first, each at the lowest offset that is free
+  // of the buffers already placed whose lifetimes overlap its own.
+  const size_t kAlignment = 64;
+  vector<pair<size_t, int> > by_size;
+  for (int i = 0; i < buffers.size(); ++i) {
+    if (plannable[i]) {
+      const size_t size = (buffers[i]->size() + kAlignment - 1) /
+          kAlignment * kAlignment;
+      by_size.push_back(make_pair(size, i));
+    }
+  }
+  std::stable_sort(by_size.rbegin(), by_size.rend());
+  vector<size_t> offsets(buffers.size());
+  vector<pair<size_t, int> > placed;
+  size_t arena_size = 0;
+  size_t total_size = 0;
+  for (int i = 0; i < by_size.size(); ++i) {
+    const size_t size = by_size[i].first;
+    const int id = by_size[i].second;
+    vector<pair<size_t, size_t> > taken;
+    for (int j = 0; j < placed.size(); ++j) {
+      const int other = placed[j].second;
+      if (first_use[other] <= last_use[id] &&
+          first_use[id] <= last_use[other]) {
+        taken.push_back(make_pair(offsets[other],
+            offsets[other] + placed[j].first));
+      }
+    }
+    std::sort(taken.begin(), taken.end());
+    size_t offset = 0;
+    for (int j = 0; j < taken.size() && taken[j].first < offset + size; ++j) {
+      offset = std::max(offset, taken[j].second);
+    }
+    offsets[id] = offset;
+    placed.push_back(make_pair(size, id));
+    arena_size = std::max(arena_size, offset + size);
+    total_size += size;
+  }
+  // Move the buffers into the new arena, keeping their current contents.
+  MemoryTracker::Scope memory_scope(memory_owner_);
+  shared_ptr<SyncedMemory> arena(new SyncedMemory(arena_size));
+  PlaceHostMemory(activation_placement_, arena.get());
+  char* arena_data = arena_size ?
+      static_cast<char*>(arena->mutable_cpu_data()) : NULL;
+  for (int i = 0; i < placed.size(); ++i) {
+    SyncedMemory* buffer = buffers[placed[i].second].get();
+    char* data = arena_data + offsets[placed[i].second];
+    if (buffer->head() != SyncedMemory::UNINITIALIZED) {
+      memcpy(data, buffer->cpu_data(), buffer->size());
+    }
+    buffer->set_cpu_data(data);
+  }
+  memory_arena_ = arena;
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory plan: " << placed.size() << " buffers share "
+      << arena_size << " bytes instead of " << total_size << ".";
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitCheckpointSegments(const NetParameter& param) {
+  const int num_layers = layers_.size();
+  map<SyncedMemory*, int> buffer_ids;
+  vector<shared_ptr<SyncedMemory> > buffers;
+  vector<int> first_use, last_use;
+  vector<bool> plannable;
+  FindBuffers(&buffer_ids, &buffers, &first_use, &last_use, &plannable);
+  // Recomputing a segment must find its inputs as they were when it first
+  // ran, so no layer may overwrite in place a buffer of an earlier segment.
+  vector<bool> can_start(num_layers, true);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+    const vector<Blob<Dtype>*>& top = top_vecs_[layer_id];
+    for (int i = 0; i < top.size(); ++i) {
+      if (top[i]->count() == 0 ||
+          std::find(bottom.begin(), bottom.end(), top[i]) == bottom.end()) {
+        continue;
+      }
+      const int buffer_id = buffer_ids[top[i]->data().get()];
+      for (int j = first_use[buffer_id] + 1; j <= layer_id; ++j) {
+        can_start[j] = false;
+      }
+    }
+  }
+  segment_starts_.assign(1, 0);
+  bool marked = false;
+  for (int layer_id = 0; layer_id + 1 < num_layers; ++layer_id) {
+    if (!layers_[layer_id]->layer_param().checkpoint()) { continue; }
+    marked = true;
+    if (can_start[layer_id + 1]) {
+      segment_starts_.push_back(layer_id + 1);
+    } else {
+      LOG(WARNING) << "Ignoring the checkpoint after "
+          << layer_names_[layer_id] << ": a later layer overwrites it.";
+    }
+  }
+  if (!marked) {
+    int num_segments = param.checkpoint_segments();
+    if (num_segments == 0) {
+      num_segments = std::max(1,
+          static_cast<int>(sqrt(static_cast<double>(num_layers)) + 0.5));
+    }
+    // Balance the segments by the bytes of activations they produce.
+    vector<size_t> produced(num_layers, 0);
+    size_t total = 0;
+    for (int i = 0; i < buffers.size(); ++i) {
+      if (plannable[i]) {
+        produced[first_use[i]] += buffers[i]->size();
+        total += buffers[i]->size();
+      }
+    }
+    size_t sum = 0;
+    for (int layer_id = 0; layer_id + 1 < num_layers &&
+         segment_starts_.size() < num_segments; ++layer_id) {
+      sum += produced[layer_id];
+      if (can_start[layer_id + 1] &&
+          sum * num_segments >= total * segment_starts_.size()) {
+        segment_starts_.push_back(layer_id + 1);
+      }
+    }
+  }
+  layer_segment_.resize(num_layers);
+  for (int i = 0; i < segment_starts_.size(); ++i) {
+    const int end = (i + 1 < segment_starts_.size()) ?
+        segment_starts_[i + 1] : num_layers;
+    for (int layer_id = segment_starts_[i]; layer_id < end; ++layer_id) {
+      layer_segment_[layer_id] = i;
+    }
+  }
+  segment_rngs_.resize(segment_starts_.size());
+  LOG_IF(INFO, Caffe::root_solver()) << "Gradient checkpointing with "
+      << segment_starts_.size() << " segments.";
+}
+
+template <typename Dtype>
+void Net<Dtype>::RecomputeSegment(const int segment_id) {
+  const int start = segment_starts_[segment_id];
+  const int end = (segment_id + 1 < segment_starts_.size()) ?
+      segment_starts_[segment_id + 1] - 1 : layers_.size() - 1;
+  // Replay the random numbers of the original pass, e.g. dropout masks.
+  const rng_t rng = *caffe_rng();
+  *caffe_rng() = segment_rngs_[segment_id];
+  for (int i = start; i <= end; ++i) {
+    // The tops of data layers keep their own memory, and rerunning them
+    // would load the next batch.
+    if (bottom_vecs_[i].size() > 0) {
+      MemoryTracker::Scope memory_scope(layer_memory_owners_[i]);
+      ForwardLayer(i);
+    }
+  }
+  *caffe_rng() = rng;
+  materialized_segment_ = segment_id;
+}
+
+template <typename Dtype>
+void Net<Dtype>::CheckUnusedDiffs() const {
+  // Blobs may share the diff of a blob that needs it, e.g. Reshape tops.
+  set<const SyncedMemory*> used_diffs;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (blob_diff_used_[blob_id] && blobs_[blob_id]->count() > 0) {
+      used_diffs.insert(blobs_[blob_id]->diff().get());
+    }
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const Blob<Dtype>& blob = *blobs_[blob_id];
+    if (blob_diff_used_[blob_id] || blob.count() == 0 ||
+        used_diffs.count(blob.diff().get())) {
+      continue;
+    }
+    CHECK_EQ(blob.diff()->head(), SyncedMemory::UNINITIALIZED)
+        << "Blob " << blob_names_[blob_id] << " has no gradient, but its "
+        << "diff was allocated.";
+  }
+  for (int param_id = 0; param_id < params_.size(); ++param_id) {
+    if (param_owners_[param_id] >= 0 ||
+        params_need_backward_[learnable_param_ids_[param_id]]) {
+      continue;
+    }
+    CHECK_EQ(params_[param_id]->diff()->head(), SyncedMemory::UNINITIALIZED)
+        << "Param " << param_display_names_[param_id] << " of layer "
+        << layer_names_[param_layer_indices_[param_id].first]
+        << " has no gradient, but its diff was allocated.";
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::ScheduleLayers(const int num_threads) {
+  const int num_layers = layers_.size();
+  layer_deps_.assign(num_layers, vector<int>());
+  layer_dependents_.assign(num_layers, vector<int>());
+  layer_pool_.reset();
+  layer_rngs_.clear();
+  // Blobs that share their data (e.g. the tops of Split and Reshape layers
+  // with their bottom) are one buffer here, so that a layer writing one of
+  // them waits for the layers reading the others.
+  map<const void*, int> buffer_ids;
+  vector<int> blob_buffers(blobs_.size());
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const void* buffer = blobs_[blob_id]->count() > 0 ?
+        static_cast<const void*>(blobs_[blob_id]->data().get()) :
+        static_cast<const void*>(blobs_[blob_id].get());
+    if (!buffer_ids.count(buffer)) {
+      const int buffer_id = buffer_ids.size();
+      buffer_ids[buffer] = buffer_id;
+    }
+    blob_buffers[blob_id] = buffer_ids[buffer];
+  }
+  vector<int> last_writer(buffer_ids.size(), -1);
+  vector<vector<int> > readers(buffer_ids.size());
+  map<int, int> last_param_user;
+  for (int i = 0; i < num_layers; ++i) {
+    set<int> deps;
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      const int buffer = blob_buffers[bottom_id_vecs_[i][j]];
+      if (last_writer[buffer] >= 0) { deps.insert(last_writer[buffer]); }
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      const int buffer = blob_buffers[top_id_vecs_[i][j]];
+      if (last_writer[buffer] >= 0) { deps.insert(last_writer[buffer]); }
+      deps.insert(readers[buffer].begin(), readers[buffer].end());
+    }
+    // Layers sharing a parameter accumulate its gradient in Backward.
+    for (int j = 0; j < param_id_vecs_[i].size(); ++j) {
+      const int param_id = param_id_vecs_[i][j];
+      const int owner = param_owners_[param_id] < 0 ? param_id :
+          param_owners_[param_id];
+      if (last_param_user.count(owner)) {
+        deps.insert(last_param_user[owner]);
+      }
+      last_param_user[owner] = i;
+    }
+    deps.erase(i);
+    layer_deps_[i].assign(deps.begin(), deps.end());
+    for (set<int>::iterator it = deps.begin(); it != deps.end(); ++it) {
+      layer_dependents_[*it].push_back(i);
+    }
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      readers[blob_buffers[bottom_id_vecs_[i][j]]].push_back(i);
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      const int buffer = blob_buffers[top_id_vecs_[i][j]];
+      last_writer[buffer] = i;
+      readers[buffer].clear();
+    }
+  }
+  // Backward runs the same graph with the edges reversed, and the readers of
+  // a fan-out one after another from the last.
+  vector<set<int> > backward_deps(num_layers);
+  for (int i = 0; i < num_layers; ++i) {
+    backward_deps[i].insert(layer_dependents_[i].begin(),
+        layer_dependents_[i].end());
+  }
+  for (int i = 0; i < fan_out_layers_.size(); ++i) {
+    for (int j = 0; j + 1 < fan_out_layers_[i].size(); ++j) {
+      backward_deps[fan_out_layers_[i][j]].insert(fan_out_layers_[i][j + 1]);
+    }
+  }
+  backward_deps_.assign(num_layers, vector<int>());
+  backward_dependents_.assign(num_layers, vector<int>());
+  for (int i = 0; i < num_layers; ++i) {
+    backward_deps_[i].assign(backward_deps[i].begin(), backward_deps[i].end());
+    for (set<int>::iterator it = backward_deps[i].begin();
+         it != backward_deps[i].end(); ++it) {
+      backward_dependents_[*it].push_back(i);
+    }
+  }
+  if (num_threads <= 1) {
+    return;
+  }
+  if (plan_memory_ || checkpointing_) {
+    // The memory plan and the segments assume the layers run in order.
+    LOG_IF(INFO, Caffe::root_solver()) << "Running the layers of " << name_
+        << " in order: they share planned memory.";
+    return;
+  }
+  bool independent = false;
+  for (int i = 1; i < num_layers && !independent; ++i) {
+    independent = layer_deps_[i].empty() || layer_deps_[i].back() != i - 1;
+  }
+  if (!independent) {
+    return;
+  }
+  layer_pool_.reset(new ThreadPool(num_threads));
+  for (int i = 0; i < num_layers; ++i) {
+    layer_rngs_.push_back(
+        shared_ptr<Caffe::RNG>(new Caffe::RNG(caffe_rng_rand())));
+  }
+  LOG_IF(INFO, Caffe::root_solver()) << "Running independent layers of "
+      << name_ << " on " << num_threads << " threads.";
+}
+
+template <typename Dtype>
+struct Net<Dtype>::ParallelPass {
+  bool forward;
+  int first;
+  int last;
+  // How many layers each layer still waits for.
+  vector<int> waiting;
+  int remaining;
+  vector<Dtype> losses;
+  // The thread-local settings of the calling thread, for the pool threads.
+  Caffe::Brew mode;
+  Caffe::CpuGemm cpu_gemm;
+  int solver_count;
+  bool root_solver;
+  boost::mutex mutex;
+  boost::condition_variable done;
+};
+
+template <typename Dtype>
+Dtype Net<Dtype>::RunLayersInParallel(const int start, const int end,
+    const bool forward) {
+  const int first = forward ? start : end;
+  const int last = forward ? end : start;
+  if (first > last) {
+    return 0;
+  }
+  ParallelPass pass;
+  pass.forward = forward;
+  pass.first = first;
+  pass.last = last;
+  pass.waiting.resize(layers_.size());
+  pass.remaining = last - first + 1;
+  pass.losses.resize(layers_.size());
+  pass.mode = Caffe::mode();
+  pass.cpu_gemm = Caffe::cpu_gemm();
+  pass.solver_count = Caffe::solver_count();
+  pass.root_solver = Caffe::root_solver();
+  vector<int> ready;
+  for (int i = first; i <= last; ++i) {
+    const vector<int>& deps = forward ? layer_deps_[i] : backward_deps_[i];
+    for (int j = 0; j < deps.size(); ++j) {
+      pass.waiting[i] += (deps[j] >= first && deps[j] <= last);
+    }
+    if (pass.waiting[i] == 0) {
+      ready.push_back(i);
+    }
+  }
+  for (int i = 0; i < ready.size(); ++i) {
+    layer_pool_->Submit(boost::bind(&Net<Dtype>::RunScheduledLayer, this,
+        &pass, ready[i]));
+  }
+  boost::mutex::scoped_lock lock(pass.mutex);
+  while (pass.remaining > 0) {
+    pass.done.wait(lock);
+  }
+  // Sum in layer order, so that the loss does not depend on the schedule.
+  Dtype loss = 0;
+  for (int i = first; i <= last; ++i) {
+    loss += pass.losses[i];
+  }
+  return loss;
+}
+
+template <typename Dtype>
+void Net<Dtype>::RunScheduledLayer(ParallelPass* pass, const int layer_id) {
+  Caffe::set_mode(pass->mode);
+  Caffe::set_cpu_gemm(pass->cpu_gemm);
+  Caffe::set_solver_count(pass->solver_count);
+  Caffe::set_root_solver(pass->root_solver);
+  // Each layer draws from its own stream, whichever thread runs it.
+  Caffe::swap_rng_stream(&layer_rngs_[layer_id]);
+  {
+    MemoryTracker::Scope memory_scope(layer_memory_owners_[layer_id]);
+    if (pass->forward) {
+      pass->losses[layer_id] = ForwardLayer(layer_id);
+    } else if (layer_need_backward_[layer_id]) {
+      BackwardLayer(layer_id);
+    }
+  }
+  Caffe::swap_rng_stream(&layer_rngs_[layer_id]);
+  const vector<int>& next = pass->forward ? layer_dependents_[layer_id] :
+      backward_dependents_[layer_id];
+  vector<int> ready;
+  boost::mutex::scoped_lock lock(pass->mutex);
+  for (int i = 0; i < next.size(); ++i) {
+    if (next[i] >= pass->first && next[i] <= pass->last &&
+        --pass->waiting[next[i]] == 0) {
+      ready.push_back(next[i]);
+    }
+  }
+  if (--pass->remaining == 0) {
+    pass->done.notify_all();
+  }
+  lock.unlock();
+  for (int i = 0; i < ready.size(); ++i) {
+    layer_pool_->Submit(boost::bind(&Net<Dtype>::RunScheduledLayer, this,
+        pass, ready[i]));
+  }
+}
+
+template <typename Dtype>
+struct Net<Dtype>::Pipeline {
+  int micro_batch_size;
+  int num_stages;
+  set<int> result_ids;
+  int num_micro_batches;
+  // The whole-batch blobs that feed the replicas, and their shapes when the
+  // replicas were built.
+  vector<Blob<Dtype>*> inputs;
+  vector<vector<int> > input_shapes;
+  // The outputs and preserved blobs, each taken as micro-batch slices or
+  // (without a batch axis) as the mean over the micro-batches.
+  vector<Blob<Dtype>*> results;
+  vector<bool> sliced;
+  // The replicas, one per stage, and their blobs that match the above.
+  vector<shared_ptr<Net> > lanes;
+  vector<vector<Blob<Dtype>*> > lane_inputs;
+  vector<vector<Blob<Dtype>*> > lane_results;
+  // The first layer of each stage in the replicas, and the end.
+  vector<int> stage_starts;
+  shared_ptr<ThreadPool> pool;
+  // How many micro-batches each stage has finished in the current pass.
+  vector<int> finished;
+  vector<Dtype> losses;
+  // The thread-local settings of the calling thread, for the pool threads.
+  Caffe::CpuGemm cpu_gemm;
+  int solver_count;
+  bool root_solver;
+  boost::mutex mutex;
+  boost::condition_variable progress;
+};
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& Net<Dtype>::ForwardPipelined(
+    const int micro_batch_size, const int num_stages, Dtype* loss) {
+  set<int> result_ids(preserved_blob_ids_);
+  result_ids.insert(net_output_blob_indices_.begin(),
+      net_output_blob_indices_.end());
+  const Dtype pipeline_loss =
+      RunPipeline(micro_batch_size, num_stages, result_ids);
+  if (loss != NULL) {
+    *loss = pipeline_loss;
+  }
+  return net_output_blobs_;
+}
+
+template <typename Dtype>
+Dtype Net<Dtype>::RunPipeline(const int micro_batch_size,
+    const int num_stages, const set<int>& result_ids) {
+  CHECK_EQ(phase_, TEST) << "Only the TEST phase runs pipelined.";
+  CHECK_EQ(Caffe::mode(), Caffe::CPU) << "Only the CPU runs pipelined.";
+  CHECK_GT(micro_batch_size, 0);
+  CHECK_GT(num_stages, 0);
+  // The data layers fill the whole batch, as in Forward.
+  int num_data_layers = 0;
+  while (num_data_layers < layers_.size() &&
+      bottom_vecs_[num_data_layers].empty()) {
+    ++num_data_layers;
+  }
+  Dtype data_loss = num_data_layers ? ForwardTo(num_data_layers - 1) : 0;
+  if (num_data_layers == layers_.size()) {
+    return data_loss;
+  }
+  vector<Blob<Dtype>*> inputs(net_input_blobs_);
+  for (int i = 0; i < num_data_layers; ++i) {
+    inputs.insert(inputs.end(), top_vecs_[i].begin(), top_vecs_[i].end());
+  }
+  bool rebuild = !pipeline_ ||
+      pipeline_->micro_batch_size != micro_batch_size ||
+      pipeline_->num_stages != num_stages ||
+      pipeline_->inputs != inputs || pipeline_->result_ids != result_ids;
+  for (int i = 0; i < inputs.size() && !rebuild; ++i) {
+    rebuild = inputs[i]->shape() != pipeline_->input_shapes[i];
+  }
+  if (rebuild) {
+    BuildPipeline(micro_batch_size, num_stages, num_data_layers, inputs,
+        result_ids);
+  }
+  Pipeline* pipeline = pipeline_.get();
+  pipeline->finished.assign(pipeline->stage_starts.size() - 1, 0);
+  pipeline->losses.assign(pipeline->num_micro_batches, 0);
+  pipeline->cpu_gemm = Caffe::cpu_gemm();
+  pipeline->solver_count = Caffe::solver_count();
+  pipeline->root_solver = Caffe::root_solver();
+  for (int stage = 0; stage < pipeline->finished.size(); ++stage) {
+    pipeline->pool->Submit(boost::bind(&Net<Dtype>::RunPipelineStage, this,
+        stage));
+  }
+  {
+    boost::mutex::scoped_lock lock(pipeline->mutex);
+    while (pipeline->finished.back() < pipeline->num_micro_batches) {
+      pipeline->progress.wait(lock);
+    }
+  }
+  const Dtype scale = Dtype(1) / pipeline->num_micro_batches;
+  for (int i = 0; i < pipeline->results.size(); ++i) {
+    if (!pipeline->sliced[i]) {
+      caffe_scal(pipeline->results[i]->count(), scale,
+          pipeline->results[i]->mutable_cpu_data());
+    }
+  }
+  Dtype lanes_loss = 0;
+  for (int m = 0; m < pipeline->num_micro_batches; ++m) {
+    lanes_loss += pipeline->losses[m];
+  }
+  return data_loss + lanes_loss * scale;
+}
+
+template <typename Dtype>
+void Net<Dtype>::BuildPipeline(const int micro_batch_size,
+    const int num_stages, const int num_data_layers,
+    const vector<Blob<Dtype>*>& inputs, const set<int>& result_ids) {
+  pipeline_.reset(new Pipeline());
+  Pipeline* pipeline = pipeline_.get();
+  pipeline->micro_batch_size = micro_batch_size;
+  pipeline->num_stages = num_stages;
+  pipeline->inputs = inputs;
+  pipeline->result_ids = result_ids;
+  // The results may still be shaped for an earlier batch.
+  for (int i = num_data_layers; i < layers_.size(); ++i) {
+    MemoryTracker::Scope memory_scope(layer_memory_owners_[i]);
+    ShareFanOutData(i);
+    layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    RememberBottoms(i);
+  }
+  PlanMemory();
+  PlaceMemory();
+  vector<string> input_names(net_input_blob_indices_.size());
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    input_names[i] = blob_names_[net_input_blob_indices_[i]];
+  }
+  set<string> data_layer_names;
+  for (int i = 0; i < num_data_layers; ++i) {
+    data_layer_names.insert(layer_names_[i]);
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      input_names.push_back(blob_names_[top_id_vecs_[i][j]]);
+    }
+  }
+  CHECK(!inputs.empty()) << "Pipelining needs inputs or data layers.";
+  const int batch_size = inputs[0]->shape(0);
+  CHECK_EQ(batch_size % micro_batch_size, 0) << "The batch size "
+      << batch_size << " is not a multiple of the micro-batch size "
+      << micro_batch_size;
+  pipeline->num_micro_batches = batch_size / micro_batch_size;
+  // The replicas take the data as inputs of one micro-batch each.
+  NetParameter filtered_param;
+  FilterNet(replica_param_, &filtered_param);
+  NetParameter param(filtered_param);
+  param.clear_layer();
+  param.clear_input();
+  param.clear_input_shape();
+  param.clear_input_dim();
+  param.clear_micro_batch_size();
+  param.clear_max_batch_size();
+  param.set_layer_threads(1);
+  param.set_plan_memory(true);
+  for (int i = 0; i < inputs.size(); ++i) {
+    CHECK_GT(inputs[i]->num_axes(), 0) << input_names[i] << " has no batch";
+    CHECK_EQ(inputs[i]->shape(0), batch_size)
+        << input_names[i] << " differs in batch size from " << input_names[0];
+    pipeline->input_shapes.push_back(inputs[i]->shape());
+    param.add_input(input_names[i]);
+    BlobShape* shape = param.add_input_shape();
+    for (int j = 0; j < inputs[i]->num_axes(); ++j) {
+      shape->add_dim(j ? inputs[i]->shape(j) : micro_batch_size);
+    }
+  }
+  const set<string> input_name_set(input_names.begin(), input_names.end());
+  vector<string> result_names;
+  for (set<int>::const_iterator it = result_ids.begin();
+       it != result_ids.end(); ++it) {
+    if (!input_name_set.count(blob_names_[*it])) {
+      result_names.push_back(blob_names_[*it]);
+      param.add_preserve_blob(blob_names_[*it]);
+    }
+  }
+  // The replicas leave out the layers that the results do not need.
+  vector<const LayerParameter*> layers;
+  vector<vector<string> > bottoms, tops;
+  for (int i = 0; i < filtered_param.layer_size(); ++i) {
+    const LayerParameter& layer = filtered_param.layer(i);
+    if (!data_layer_names.count(layer.name())) {
+      layers.push_back(&layer);
+      bottoms.push_back(vector<string>(layer.bottom().begin(),
+          layer.bottom().end()));
+      tops.push_back(vector<string>(layer.top().begin(), layer.top().end()));
+    }
+  }
+  const vector<int> needed_layers = FindNeededLayers(bottoms, tops,
+      set<string>(result_names.begin(), result_names.end()));
+  for (int i = 0; i < needed_layers.size(); ++i) {
+    const LayerParameter& layer = *layers[needed_layers[i]];
+    CHECK(!MixesSamples(layer)) << "Cannot pipeline " << layer.name()
+        << ", which combines the samples of a batch.";
+    param.add_layer()->CopyFrom(layer);
+  }
+  // Cut the layers into stages of about equal work: the size of the tops,
+  // and of the weights applied at every output position.
+  pipeline->lanes.push_back(ReplicateFrom(param));
+  const Net<Dtype>& replica = *pipeline->lanes[0];
+  const int num_layers = replica.layers_.size();
+  vector<double> costs(num_layers, 1);
+  double total_cost = 0;
+  for (int i = 0; i < num_layers; ++i) {
+    const vector<Blob<Dtype>*>& tops = replica.top_vecs_[i];
+    for (int j = 0; j < tops.size(); ++j) {
+      costs[i] += tops[j]->count();
+    }
+    const int positions = (!tops.empty() && tops[0]->num_axes() > 2) ?
+        tops[0]->count(2) : 1;
+    const vector<shared_ptr<Blob<Dtype> > >& blobs =
+        replica.layers_[i]->blobs();
+    for (int j = 0; j < blobs.size(); ++j) {
+      costs[i] += static_cast<double>(blobs[j]->count()) * positions;
+    }
+    total_cost += costs[i];
+  }
+  const int stages = std::max(1, std::min(num_stages, num_layers));
+  pipeline->stage_starts.push_back(0);
+  double cost = 0;
+  for (int i = 0; i + 1 < num_layers; ++i) {
+    cost += costs[i];
+    const int cuts = stages - pipeline->stage_starts.size();
+    if (cuts > 0 && (cost * stages >= total_cost *
+        pipeline->stage_starts.size() || num_layers - i - 1 == cuts)) {
+      pipeline->stage_starts.push_back(i + 1);
+    }
+  }
+  pipeline->stage_starts.push_back(num_layers);
+  // One replica per stage, so that every stage has a micro-batch to work on.
+  while (pipeline->lanes.size() < stages) {
+    pipeline->lanes.push_back(ReplicateFrom(param));
+  }
+  for (int lane = 0; lane < stages; ++lane) {
+    const Net<Dtype>& lane_net = *pipeline->lanes[lane];
+    pipeline->lane_inputs.push_back(lane_net.net_input_blobs_);
+    pipeline->lane_results.push_back(vector<Blob<Dtype>*>());
+    for (int i = 0; i < result_names.size(); ++i) {
+      pipeline->lane_results.back().push_back(
+          lane_net.blob_by_name(result_names[i]).get());
+    }
+  }
+  for (int i = 0; i < result_names.size(); ++i) {
+    Blob<Dtype>* result = blob_by_name(result_names[i]).get();
+    const Blob<Dtype>* lane_result = pipeline->lane_results[0][i];
+    const bool sliced = result->num_axes() > 0 &&
+        lane_result->num_axes() > 0 && result->shape(0) == batch_size &&
+        lane_result->shape(0) == micro_batch_size &&
+        result->count() == lane_result->count() * pipeline->num_micro_batches;
+    CHECK(sliced || result->shape() == lane_result->shape())
+        << "Cannot pipeline " << result_names[i] << " of shape "
+        << result->shape_string() << " by micro-batches of shape "
+        << lane_result->shape_string();
+    pipeline->results.push_back(result);
+    pipeline->sliced.push_back(sliced);
+  }
+  pipeline->pool.reset(new ThreadPool(stages));
+  LOG_IF(INFO, Caffe::root_solver()) << "Pipelining " << name_
+      << " in " << stages << " stages over micro-batches of "
+      << micro_batch_size << ".";
+}
+
+template <typename Dtype>
+void Net<Dtype>::RunPipelineStage(const int stage) {
+  Pipeline* pipeline = pipeline_.get();
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_cpu_gemm(pipeline->cpu_gemm);
+  Caffe::set_solver_count(pipeline->solver_count);
+  Caffe::set_root_solver(pipeline->root_solver);
+  const int num_stages = pipeline->stage_starts.size() - 1;
+  const int num_lanes = pipeline->lanes.size();
+  for (int m = 0; m < pipeline->num_micro_batches; ++m) {
+    {
+      // Wait for the micro-batch to leave the previous stage, or at the
+      // first stage for its replica to finish the earlier micro-batch.
+      boost::mutex::scoped_lock lock(pipeline->mutex);
+      while (stage ? pipeline->finished[stage - 1] <= m :
+          pipeline->finished[num_stages - 1] < m - num_lanes + 1) {
+        pipeline->progress.wait(lock);
+      }
+    }
+    const int lane = m % num_lanes;
+    if (stage == 0) {
+      for (int i = 0; i < pipeline->inputs.size(); ++i) {
+        Blob<Dtype>* input = pipeline->lane_inputs[lane][i];
+        caffe_copy(input->count(),
+            pipeline->inputs[i]->cpu_data() + input->count() * m,
+            input->mutable_cpu_data());
+      }
+    }
+    const Dtype loss = pipeline->lanes[lane]->ForwardFromTo(
+        pipeline->stage_starts[stage], pipeline->stage_starts[stage + 1] - 1);
+    if (stage == num_stages - 1) {
+      for (int i = 0; i < pipeline->results.size(); ++i) {
+        const Blob<Dtype>* lane_result = pipeline->lane_results[lane][i];
+        const int64_t count = lane_result->count();
+        Dtype* result = pipeline->results[i]->mutable_cpu_data();
+        if (pipeline->sliced[i]) {
+          caffe_copy(count, lane_result->cpu_data(), result + count * m);
+        } else if (m == 0) {
+          caffe_copy(count, lane_result->cpu_data(), result);
+        } else {
+          caffe_axpy(count, Dtype(1), lane_result->cpu_data(), result);
+        }
+      }
+    }
+    boost::mutex::scoped_lock lock(pipeline->mutex);
+    pipeline->losses[m] += loss;
+    pipeline->finished[stage] = m + 1;
+    pipeline->progress.notify_all();
+  }
+}
+
+template <typename Dtype>
+struct Net<Dtype>::ForwardCache {
+  int blob_id;
+  // The last layer that writes the blob, and the data layers before it.
+  int layer_id;
+  int num_data_layers;
+  int capacity;
+  // The inputs and data tops that make up the key.
+  vector<int> key_blob_ids;
+  // The blobs that only the skipped layers write.
+  set<int> skipped_blob_ids;
+  // The weights of the skipped layers, and their memory and its version
+  // when the values were cached.
+  vector<Blob<Dtype>*> params;
+  vector<const SyncedMemory*> param_memory;
+  vector<unsigned int> param_versions;
+  // The key blobs, the blob and the loss of the layers up to it.
+  struct Entry {
+    vector<shared_ptr<Blob<Dtype> > > key;
+    shared_ptr<Blob<Dtype> > value;
+    Dtype loss;
+  };
+  // The entries by the hash of their key, and the hashes from the least to
+  // the most recently used.
+  map<uint64_t, Entry> entries;
+  std::list<uint64_t> recency;
+};
+
+template <typename Dtype>
+void Net<Dtype>::InitForwardCache(const NetParameter& param) {
+  CHECK(has_blob(param.cache_blob()))
+      << "Unknown cache_blob " << param.cache_blob();
+  CHECK_GT(param.cache_batches(), 0);
+  forward_cache_.reset(new ForwardCache());
+  ForwardCache* cache = forward_cache_.get();
+  cache->blob_id = blob_names_index_[param.cache_blob()];
+  cache->capacity = param.cache_batches();
+  cache->num_data_layers = 0;
+  while (cache->num_data_layers < layers_.size() &&
+      bottom_vecs_[cache->num_data_layers].empty()) {
+    ++cache->num_data_layers;
+  }
+  // The later layers must find everything else they read as the data, the
+  // inputs or themselves left it.
+  vector<int> last_writer(blobs_.size(), -1);
+  cache->layer_id = -1;
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < bottom_id_vecs_[i].size() && cache->layer_id >= 0;
+         ++j) {
+      const int blob_id = bottom_id_vecs_[i][j];
+      CHECK(blob_id == cache->blob_id ||
+          last_writer[blob_id] < cache->num_data_layers ||
+          last_writer[blob_id] > cache->layer_id)
+          << layer_names_[i] << " reads " << blob_names_[blob_id]
+          << " from before cache_blob " << param.cache_blob();
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      last_writer[top_id_vecs_[i][j]] = i;
+      if (top_id_vecs_[i][j] == cache->blob_id) {
+        cache->layer_id = i;
+      }
+    }
+  }
+  CHECK_GE(cache->layer_id, cache->num_data_layers) << "cache_blob "
+      << param.cache_blob() << " is not written by a layer after the data.";
+  // A hit leaves those blobs as the previous batch left them.
+  for (int i = 0; i < blobs_.size(); ++i) {
+    if (i != cache->blob_id && last_writer[i] >= cache->num_data_layers &&
+        last_writer[i] <= cache->layer_id) {
+      cache->skipped_blob_ids.insert(i);
+    }
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    CHECK(!cache->skipped_blob_ids.count(net_output_blob_indices_[i]))
+        << "Output " << blob_names_[net_output_blob_indices_[i]]
+        << " comes only from layers before cache_blob "
+        << param.cache_blob();
+  }
+  for (set<int>::const_iterator it = preserved_blob_ids_.begin();
+       it != preserved_blob_ids_.end(); ++it) {
+    CHECK(!cache->skipped_blob_ids.count(*it)) << "Preserved blob "
+        << blob_names_[*it] << " comes only from layers before cache_blob "
+        << param.cache_blob();
+  }
+  set<int> key_candidates(net_input_blob_indices_.begin(),
+      net_input_blob_indices_.end());
+  for (int i = 0; i < cache->num_data_layers; ++i) {
+    key_candidates.insert(top_id_vecs_[i].begin(), top_id_vecs_[i].end());
+  }
+  for (int i = 0; i < param.cache_key_blob_size(); ++i) {
+    const string& name = param.cache_key_blob(i);
+    CHECK(has_blob(name) && key_candidates.count(blob_names_index_[name]))
+        << "cache_key_blob " << name << " is not an input or data top.";
+    cache->key_blob_ids.push_back(blob_names_index_[name]);
+  }
+  if (cache->key_blob_ids.empty()) {
+    cache->key_blob_ids.assign(key_candidates.begin(), key_candidates.end());
+  }
+  for (int i = cache->num_data_layers; i <= cache->layer_id; ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[i]->blobs();
+    for (int j = 0; j < blobs.size(); ++j) {
+      cache->params.push_back(blobs[j].get());
+    }
+  }
+  cache->param_memory.resize(cache->params.size());
+  cache->param_versions.resize(cache->params.size());
+  LOG_IF(INFO, Caffe::root_solver()) << "Caching " << param.cache_blob()
+      << " for " << cache->capacity << " batches, to resume after "
+      << layer_names_[cache->layer_id] << ".";
+}
+
+// Whether the blobs hold the same shape and bytes.
+template <typename Dtype>
+static bool SameData(const Blob<Dtype>& a, const Blob<Dtype>& b) {
+  return a.shape() == b.shape() && (a.count() == 0 ||
+      !memcmp(a.cpu_data(), b.cpu_data(), a.count() * sizeof(Dtype)));
+}
+
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardCached() {
+  ForwardCache* cache = forward_cache_.get();
+  // The values are stale once the weights are written to or replaced.
+  bool stale = false;
+  for (int i = 0; i < cache->params.size(); ++i) {
+    const SyncedMemory* memory = cache->params[i]->data().get();
+    stale |= memory != cache->param_memory[i] ||
+        memory->version() != cache->param_versions[i];
+    cache->param_memory[i] = memory;
+    cache->param_versions[i] = memory->version();
+  }
+  if (stale) {
+    ClearForwardCache();
+  }
+  // The data layers produce the next batch either way.
+  Dtype loss = cache->num_data_layers ?
+      ForwardTo(cache->num_data_layers - 1) : 0;
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < cache->key_blob_ids.size(); ++i) {
+    const Blob<Dtype>& key = *blobs_[cache->key_blob_ids[i]];
+    const vector<int>& shape = key.shape();
+    hash = HashBytes(shape.data(), shape.size() * sizeof(int), hash);
+    if (key.count() > 0) {
+      hash = HashBytes(key.cpu_data(), key.count() * sizeof(Dtype), hash);
+    }
+  }
+  Blob<Dtype>* blob = blobs_[cache->blob_id].get();
+  typename map<uint64_t, typename ForwardCache::Entry>::iterator entry =
+      cache->entries.find(hash);
+  // The hash only finds the entry; its key has to match as well.
+  bool hit = entry != cache->entries.end();
+  for (int i = 0; hit && i < cache->key_blob_ids.size(); ++i) {
+    hit = SameData(*entry->second.key[i], *blobs_[cache->key_blob_ids[i]]);
+  }
+  // Blobs preserved since Init may need the skipped layers.
+  for (set<int>::const_iterator it = preserved_blob_ids_.begin();
+       hit && it != preserved_blob_ids_.end(); ++it) {
+    hit = !cache->skipped_blob_ids.count(*it);
+  }
+  if (hit) {
+    blob->CopyFrom(*entry->second.value, false, true);
+    cache->recency.remove(hash);
+  } else {
+    const Dtype prefix_loss =
+        ForwardFromTo(cache->num_data_layers, cache->layer_id);
+    if (entry != cache->entries.end()) {
+      cache->recency.remove(hash);
+    } else if (cache->entries.size() == cache->capacity) {
+      cache->entries.erase(cache->recency.front());
+      cache->recency.pop_front();
+    }
+    MemoryTracker::Scope memory_scope(memory_owner_);
+    typename ForwardCache::Entry& new_entry = cache->entries[hash];
+    new_entry.key.clear();
+    for (int i = 0; i < cache->key_blob_ids.size(); ++i) {
+      new_entry.key.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      new_entry.key[i]->CopyFrom(*blobs_[cache->key_blob_ids[i]], false,
+          true);
+    }
+    new_entry.value.reset(new Blob<Dtype>());
+    new_entry.value->CopyFrom(*blob, false, true);
+    new_entry.loss = prefix_loss;
+    entry = cache->entries.find(hash);
+  }
+  cache->recency.push_back(hash);
+  loss += entry->second.loss;
+  if (cache->layer_id + 1 < layers_.size()) {
+    loss += ForwardFrom(cache->layer_id + 1);
+  }
+  return loss;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ClearForwardCache() {
+  if (forward_cache_) {
+    forward_cache_->entries.clear();
+    forward_cache_->recency.clear();
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::PreserveBlob(const string& blob_name) {
+  CHECK(has_blob(blob_name)) << "Unknown blob name " << blob_name;
+  const int blob_id = blob_names_index_[blob_name];
+  if (preserved_blob_ids_.insert(blob_id).second) {
+    PlanMemory();
   }
 }
 
@@ -844,6 +2610,7 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
     }
   }
+  ClearForwardCache();
 }
 
 template <typename Dtype>
@@ -912,6 +2679,7 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  ClearForwardCache();
 }
 
 template <typename Dtype>
@@ -929,6 +2697,32 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::ToCompiledProto(NetParameter* param) const {
+  // Keep the options of the net, but describe the layers as they were built.
+  param->CopyFrom(replica_param_);
+  param->clear_layer();
+  param->clear_input();
+  param->clear_input_shape();
+  param->clear_input_dim();
+  param->clear_preserve_blob();
+  param->set_compiled(true);
+  for (int i = 0; i < net_input_blobs_.size(); ++i) {
+    param->add_input(blob_names_[net_input_blob_indices_[i]]);
+    BlobShape* shape = param->add_input_shape();
+    for (int j = 0; j < net_input_blobs_[i]->num_axes(); ++j) {
+      shape->add_dim(net_input_blobs_[i]->shape(j));
+    }
+  }
+  for (set<int>::const_iterator it = preserved_blob_ids_.begin();
+       it != preserved_blob_ids_.end(); ++it) {
+    param->add_preserve_blob(blob_names_[*it]);
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    layers_[i]->ToProto(param->add_layer(), false);
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
@@ -989,13 +2783,17 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
+    // Without a gradient the update would be zero.
+    if (!params_need_backward_[i]) { continue; }
     learnable_params_[i]->Update();
   }
+  if (check_unused_diffs_) { CheckUnusedDiffs(); }
 }
 
 template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
+    if (!params_need_backward_[i]) { continue; }
     Blob<Dtype>* blob = learnable_params_[i];
     switch (Caffe::mode()) {
     case Caffe::CPU:
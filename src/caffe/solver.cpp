@@ -6,6 +6,7 @@
 #include "caffe/solver.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/memory_tracker.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -258,12 +259,24 @@ void Solver<Dtype>::Step(int iters) {
     for (int i = 0; i < callbacks_.size(); ++i) {
       callbacks_[i]->on_gradients_ready();
     }
-    ApplyUpdate();
+    {
+      MemoryTracker::Scope memory_scope(history_memory_owner());
+      ApplyUpdate();
+    }
 
     // Increment the internal iter_ counter -- its value should always indicate
     // the number of times the weights have been updated.
     ++iter_;
 
+    // All the memory of training is allocated after the first update.
+    if (iter_ == start_iter + 1 && param_.display() && Caffe::root_solver()) {
+      net_->LogMemoryUsage();
+      const MemoryTracker::Usage history = MemoryTracker::GetUsage(
+          history_memory_owner(), MemoryTracker::HOST);
+      LOG(INFO) << "Solver history: host " << history.bytes << " / "
+          << history.peak_bytes;
+    }
+
     SolverAction::Enum request = GetRequestedAction();
 
     // Save a snapshot if needed.
@@ -281,6 +294,11 @@ void Solver<Dtype>::Step(int iters) {
   }
 }
 
+template <typename Dtype>
+int Solver<Dtype>::history_memory_owner() const {
+  return MemoryTracker::Owner(net_->name() + "/solver history");
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Solve(const char* resume_file) {
   CHECK(Caffe::root_solver());
@@ -292,6 +310,7 @@ void Solver<Dtype>::Solve(const char* resume_file) {
 
   if (resume_file) {
     LOG(INFO) << "Restoring previous solver status from " << resume_file;
+    MemoryTracker::Scope memory_scope(history_memory_owner());
     Restore(resume_file);
   }
 
@@ -82,9 +82,12 @@ void SGDSolver<Dtype>::ClipGradients() {
   const Dtype clip_gradients = this->param_.clip_gradients();
   if (clip_gradients < 0) { return; }
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const vector<bool>& need_backward = this->net_->params_need_backward();
   Dtype sumsq_diff = 0;
   for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+    if (need_backward[i]) {
+      sumsq_diff += net_params[i]->sumsq_diff();
+    }
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -93,7 +96,9 @@ void SGDSolver<Dtype>::ClipGradients() {
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
     for (int i = 0; i < net_params.size(); ++i) {
-      net_params[i]->scale_diff(scale_factor);
+      if (need_backward[i]) {
+        net_params[i]->scale_diff(scale_factor);
+      }
     }
   }
 }
@@ -108,6 +113,8 @@ void SGDSolver<Dtype>::ApplyUpdate() {
   ClipGradients();
   for (int param_id = 0; param_id < this->net_->learnable_params().size();
        ++param_id) {
+    // Frozen parameters have no diff to update them with.
+    if (!this->net_->params_need_backward()[param_id]) { continue; }
     Normalize(param_id);
     Regularize(param_id);
     ComputeUpdateValue(param_id, rate);
@@ -8,7 +8,8 @@ namespace caffe {
 
 SyncedMemory::~SyncedMemory() {
   if (cpu_ptr_ && own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, size_, placement_, cpu_malloc_use_cuda_);
+    MemoryTracker::Freed(owner_, MemoryTracker::HOST, size_);
   }
 
 #ifndef CPU_ONLY
@@ -20,14 +21,24 @@ SyncedMemory::~SyncedMemory() {
     }
     CUDA_CHECK(cudaFree(gpu_ptr_));
     cudaSetDevice(initial_device);
+    MemoryTracker::Freed(owner_, MemoryTracker::GPU, size_);
   }
 #endif  // CPU_ONLY
 }
 
+// Counts newly allocated memory against the owner of the first allocation.
+void SyncedMemory::Track(MemoryTracker::Device device) {
+  if (owner_ < 0) {
+    owner_ = MemoryTracker::current_owner();
+  }
+  MemoryTracker::Allocated(owner_, device, size_);
+}
+
 inline void SyncedMemory::to_cpu() {
   switch (head_) {
   case UNINITIALIZED:
-    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    CaffeMallocHost(&cpu_ptr_, size_, placement_, &cpu_malloc_use_cuda_);
+    Track(MemoryTracker::HOST);
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -35,7 +46,8 @@ inline void SyncedMemory::to_cpu() {
   case HEAD_AT_GPU:
 #ifndef CPU_ONLY
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&cpu_ptr_, size_, placement_, &cpu_malloc_use_cuda_);
+      Track(MemoryTracker::HOST);
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
@@ -56,6 +68,7 @@ inline void SyncedMemory::to_gpu() {
   case UNINITIALIZED:
     CUDA_CHECK(cudaGetDevice(&gpu_device_));
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    Track(MemoryTracker::GPU);
     caffe_gpu_memset(size_, 0, gpu_ptr_);
     head_ = HEAD_AT_GPU;
     own_gpu_data_ = true;
@@ -64,6 +77,7 @@ inline void SyncedMemory::to_gpu() {
     if (gpu_ptr_ == NULL) {
       CUDA_CHECK(cudaGetDevice(&gpu_device_));
       CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+      Track(MemoryTracker::GPU);
       own_gpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, cpu_ptr_, gpu_ptr_);
@@ -86,11 +100,27 @@ const void* SyncedMemory::cpu_data() {
 void SyncedMemory::set_cpu_data(void* data) {
   CHECK(data);
   if (own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, size_, placement_, cpu_malloc_use_cuda_);
+    MemoryTracker::Freed(owner_, MemoryTracker::HOST, size_);
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  ++version_;
+}
+
+void SyncedMemory::set_placement(const HostPlacement& placement) {
+  if (placement == placement_) {
+    return;
+  }
+  if (cpu_ptr_ && own_cpu_data_ && !cpu_malloc_use_cuda_) {
+    void* ptr = HostAllocator::Allocate(size_, placement);
+    CHECK(ptr) << "host allocation of size " << size_ << " failed";
+    memcpy(ptr, cpu_ptr_, size_);  // NOLINT(caffe/alt_fn)
+    HostAllocator::Free(cpu_ptr_, size_, placement_);
+    cpu_ptr_ = ptr;
+  }
+  placement_ = placement;
 }
 
 const void* SyncedMemory::gpu_data() {
@@ -113,10 +143,12 @@ void SyncedMemory::set_gpu_data(void* data) {
     }
     CUDA_CHECK(cudaFree(gpu_ptr_));
     cudaSetDevice(initial_device);
+    MemoryTracker::Freed(owner_, MemoryTracker::GPU, size_);
   }
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  ++version_;
 #else
   NO_GPU;
 #endif
@@ -125,6 +157,7 @@ void SyncedMemory::set_gpu_data(void* data) {
 void* SyncedMemory::mutable_cpu_data() {
   to_cpu();
   head_ = HEAD_AT_CPU;
+  ++version_;
   return cpu_ptr_;
 }
 
@@ -132,6 +165,7 @@ void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
   to_gpu();
   head_ = HEAD_AT_GPU;
+  ++version_;
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -144,6 +178,7 @@ void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
   if (gpu_ptr_ == NULL) {
     CUDA_CHECK(cudaGetDevice(&gpu_device_));
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    Track(MemoryTracker::GPU);
     own_gpu_data_ = true;
   }
   const cudaMemcpyKind put = cudaMemcpyHostToDevice;
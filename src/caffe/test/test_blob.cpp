@@ -52,6 +52,22 @@ TYPED_TEST(BlobSimpleTest, TestReshape) {
   EXPECT_EQ(this->blob_->count(), 120);
 }
 
+TYPED_TEST(BlobSimpleTest, TestReshapeBeyondInt32) {
+  // Shaping alone does not allocate, so this takes no memory.
+  vector<int> shape(3);
+  shape[0] = 3;
+  shape[1] = 1 << 20;
+  shape[2] = 1 << 10;
+  this->blob_->Reshape(shape);
+  EXPECT_EQ(int64_t(3) << 30, this->blob_->count());
+  EXPECT_EQ(int64_t(1) << 30, this->blob_->count(1));
+  vector<int> index(1, 2);
+  EXPECT_EQ(int64_t(2) << 30, this->blob_->offset(index));
+  this->blob_->Reshape(3, 1 << 20, 1 << 10, 1);
+  EXPECT_EQ(int64_t(2) << 30, this->blob_->offset(2));
+  EXPECT_EQ((int64_t(2) << 30) + 1025, this->blob_->offset(2, 1, 1));
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
@@ -71,6 +71,27 @@ TYPED_TEST(ConcatLayerTest, TestSetupNum) {
   EXPECT_EQ(this->blob_top_->width(), this->blob_bottom_0_->width());
 }
 
+TYPED_TEST(ConcatLayerTest, TestSetupNumBeyondInt32) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Shaping alone does not allocate, so this takes no memory.
+  vector<int> shape(3);
+  shape[0] = 2;
+  shape[1] = 1 << 20;
+  shape[2] = 1 << 10;
+  Blob<Dtype> bottom_0(shape);
+  shape[0] = 1;
+  Blob<Dtype> bottom_1(shape);
+  vector<Blob<Dtype>*> bottom_vec;
+  bottom_vec.push_back(&bottom_0);
+  bottom_vec.push_back(&bottom_1);
+  LayerParameter layer_param;
+  layer_param.mutable_concat_param()->set_axis(0);
+  ConcatLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  EXPECT_EQ(3, this->blob_top_->shape(0));
+  EXPECT_EQ(int64_t(3) << 30, this->blob_top_->count());
+}
+
 TYPED_TEST(ConcatLayerTest, TestSetupChannels) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -397,6 +397,212 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestPackedGemmConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_cpu_gemm(Caffe::PACKED);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Changing the weights must invalidate the packed filters.
+  caffe_scal(layer->blobs()[0]->count(), Dtype(-2),
+      layer->blobs()[0]->mutable_cpu_data());
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_cpu_gemm(Caffe::BLAS);
+  // Check against reference convolution.
+  const Dtype* top_data;
+  const Dtype* ref_top_data;
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  top_data = this->blob_top_->cpu_data();
+  ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestSparseConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->set_sparse_threshold(0.5);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Prune all but the first tap of every filter of the first two groups;
+  // the last group stays dense.
+  Dtype* weights = layer->blobs()[0]->mutable_cpu_data();
+  const int kernel_dim = layer->blobs()[0]->count(1);
+  for (int i = 0; i < 2 * kernel_dim; ++i) {
+    if (i % kernel_dim != 0) {
+      weights[i] = 0;
+    }
+  }
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  const Dtype* top_data;
+  const Dtype* ref_top_data;
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  top_data = this->blob_top_->cpu_data();
+  ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestDepthwiseConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  const Dtype* top_data;
+  const Dtype* ref_top_data;
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  top_data = this->blob_top_->cpu_data();
+  ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestCpuAlgorithms) {
+  typedef typename TypeParam::Dtype Dtype;
+  const ConvolutionParameter_CpuAlgorithm algorithms[] = {
+    ConvolutionParameter_CpuAlgorithm_GEMM,
+    ConvolutionParameter_CpuAlgorithm_PACKED_GEMM,
+    ConvolutionParameter_CpuAlgorithm_DIRECT
+  };
+  for (int a = 0; a < 3; ++a) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->add_stride(2);
+    convolution_param->add_pad(1);
+    convolution_param->set_num_output(4);
+    convolution_param->set_cpu_algorithm(algorithms[a]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("constant");
+    convolution_param->mutable_bias_filler()->set_value(0.1);
+    shared_ptr<Layer<Dtype> > layer(
+        new ConvolutionLayer<Dtype>(layer_param));
+    layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    // Check against reference convolution.
+    caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestAutoGroupedConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  // AUTO convolves directly only for few channels per group and a spatial
+  // kernel, and leaves explicit sparse, packed or GEMM choices alone.
+  const int kernel_sizes[] = { 3, 1, 3, 3, 3 };
+  const float sparse_thresholds[] = { 0, 0, 0.5, 0, 0 };
+  const bool packed[] = { false, false, false, true, false };
+  const bool gemm[] = { false, false, false, false, true };
+  const bool expected[] = { true, false, false, false, false };
+  const Caffe::CpuGemm cpu_gemm = Caffe::cpu_gemm();
+  for (int c = 0; c < 5; ++c) {
+    LayerParameter layer_param;
+    layer_param.set_phase(TEST);
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel_sizes[c]);
+    convolution_param->set_num_output(3);
+    convolution_param->set_group(3);
+    convolution_param->set_sparse_threshold(sparse_thresholds[c]);
+    if (gemm[c]) {
+      convolution_param->set_cpu_algorithm(
+          ConvolutionParameter_CpuAlgorithm_GEMM);
+    }
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    Caffe::set_cpu_gemm(packed[c] ? Caffe::PACKED : Caffe::BLAS);
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(expected[c], layer.grouped_conv()) << "case " << c;
+  }
+  Caffe::set_cpu_gemm(cpu_gemm);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestFFTConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Large enough to need several tiles per image.
+  this->blob_bottom_->Reshape(2, 4, 40, 37);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(5);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(2);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(2);
+  convolution_param->set_engine(ConvolutionParameter_Engine_FFT);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<FFTConvolutionLayer<Dtype> > layer(
+      new FFTConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_LT(layer->tile_size(), 40);
+  for (int pass = 0; pass < 2; ++pass) {
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    // Check against reference convolution.
+    caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-3);
+    }
+    // Changing the weights must invalidate the cached filter spectra.
+    filler.Fill(layer->blobs()[0].get());
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
@@ -689,6 +895,101 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestGradientDepthwise) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestGradientFFT) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(2);
+  convolution_param->set_engine(ConvolutionParameter_Engine_FFT);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  FFTConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestGradientFusedReLU) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> conv(layer_param);
+  conv.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  LayerParameter relu_layer_param;
+  relu_layer_param.mutable_relu_param()->set_negative_slope(0.1);
+  ReLULayer<Dtype> relu(relu_layer_param);
+  relu.SetUp(this->blob_top_vec_, this->blob_top_vec_);
+  convolution_param->mutable_relu_param()->set_negative_slope(0.1);
+  ConvolutionLayer<Dtype> fused(layer_param);
+  vector<Blob<Dtype>*> fused_top_vec(1, this->blob_top_2_);
+  fused.SetUp(this->blob_bottom_vec_, fused_top_vec);
+  for (int j = 0; j < 2; ++j) {
+    fused.blobs()[j]->CopyFrom(*conv.blobs()[j]);
+    caffe_set(conv.blobs()[j]->count(), Dtype(0),
+        conv.blobs()[j]->mutable_cpu_diff());
+    caffe_set(fused.blobs()[j]->count(), Dtype(0),
+        fused.blobs()[j]->mutable_cpu_diff());
+  }
+  // The fused layer gets the gradients of a ReLU layer run in place after
+  // the convolution.
+  conv.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  relu.Forward(this->blob_top_vec_, this->blob_top_vec_);
+  fused.Forward(this->blob_bottom_vec_, fused_top_vec);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  this->ref_blob_top_.reset(new Blob<Dtype>(this->blob_top_->shape()));
+  filler.Fill(this->ref_blob_top_.get());
+  caffe_copy(this->blob_top_->count(), this->ref_blob_top_->cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  caffe_copy(this->blob_top_2_->count(), this->ref_blob_top_->cpu_data(),
+      this->blob_top_2_->mutable_cpu_diff());
+  vector<bool> propagate_down(1, true);
+  relu.Backward(this->blob_top_vec_, propagate_down, this->blob_top_vec_);
+  conv.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_bottom_, true, true);
+  fused.Backward(fused_top_vec, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_diff()[i], this->blob_bottom_->cpu_diff()[i],
+        1e-4);
+  }
+  for (int j = 0; j < 2; ++j) {
+    for (int i = 0; i < conv.blobs()[j]->count(); ++i) {
+      EXPECT_NEAR(conv.blobs()[j]->cpu_diff()[i],
+          fused.blobs()[j]->cpu_diff()[i], 1e-4);
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gtest/gtest.h"
 
 #include "caffe/blob.hpp"
@@ -19,6 +20,20 @@ namespace caffe {
 
 using boost::scoped_ptr;
 
+// A DataLayer that can wait for its prefetch thread.
+template <typename Dtype>
+class PrefetchWaitingDataLayer : public DataLayer<Dtype> {
+ public:
+  explicit PrefetchWaitingDataLayer(const LayerParameter& param)
+      : DataLayer<Dtype>(param) {}
+  // Returns once every batch the tops do not hold is prefetched.
+  void WaitForPrefetch() {
+    while (this->prefetch_full_.size() < this->PREFETCH_COUNT - 1) {
+      boost::this_thread::yield();
+    }
+  }
+};
+
 template <typename TypeParam>
 class DataLayerTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -336,6 +351,30 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  // The tops share the memory of the batch they got, so the prefetch thread
+  // must not reuse it before the next Forward.
+  void TestReadHoldsBatch() {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(1);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+
+    PrefetchWaitingDataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      // Let the prefetch thread fill all the free batches.
+      layer.WaitForPrefetch();
+      EXPECT_EQ(iter % 5, blob_top_label_->cpu_data()[0]);
+      for (int j = 0; j < 24; ++j) {
+        EXPECT_EQ(iter % 5, blob_top_data_->cpu_data()[j])
+            << "debug: iter " << iter << " j " << j;
+      }
+    }
+  }
+
   virtual ~DataLayerTest() { delete blob_top_data_; delete blob_top_label_; }
 
   DataParameter_DB backend_;
@@ -356,6 +395,12 @@ TYPED_TEST(DataLayerTest, TestReadLevelDB) {
   this->TestRead();
 }
 
+TYPED_TEST(DataLayerTest, TestReadHoldsBatchLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadHoldsBatch();
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLevelDB) {
   this->TestReshape(DataParameter_DB_LEVELDB);
 }
@@ -396,6 +441,12 @@ TYPED_TEST(DataLayerTest, TestReadLMDB) {
   this->TestRead();
 }
 
+TYPED_TEST(DataLayerTest, TestReadHoldsBatchLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadHoldsBatch();
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLMDB) {
   this->TestReshape(DataParameter_DB_LMDB);
 }
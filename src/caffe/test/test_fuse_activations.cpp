@@ -0,0 +1,141 @@
+#include <string>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fuse_activations.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class FuseActivationsTest : public ::testing::Test {
+ protected:
+  void RunFuseTest(const string& input_param_string,
+      const string& output_param_string, const int expected_folded) {
+    // Test that FuseActivations called on the proto specified by
+    // input_param_string results in the proto specified by
+    // output_param_string.
+    NetParameter input_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        input_param_string, &input_param));
+    NetParameter expected_output_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        output_param_string, &expected_output_param));
+    NetParameter actual_output_param;
+    EXPECT_EQ(expected_folded,
+        FuseActivations(input_param, &actual_output_param));
+    EXPECT_EQ(expected_output_param.DebugString(),
+        actual_output_param.DebugString());
+    // Also test idempotence.
+    NetParameter double_fused_param;
+    EXPECT_EQ(0, FuseActivations(actual_output_param, &double_fused_param));
+    EXPECT_EQ(actual_output_param.DebugString(),
+        double_fused_param.DebugString());
+  }
+
+  void RunFoldAffineTest(const string& input_param_string,
+      const string& output_param_string, const int expected_folded) {
+    NetParameter input_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        input_param_string, &input_param));
+    NetParameter expected_output_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        output_param_string, &expected_output_param));
+    NetParameter actual_output_param;
+    EXPECT_EQ(expected_folded,
+        FoldAffineLayers(input_param, &actual_output_param));
+    EXPECT_EQ(expected_output_param.DebugString(),
+        actual_output_param.DebugString());
+    NetParameter double_folded_param;
+    EXPECT_EQ(0, FoldAffineLayers(actual_output_param, &double_folded_param));
+    EXPECT_EQ(actual_output_param.DebugString(),
+        double_folded_param.DebugString());
+  }
+};
+
+TEST_F(FuseActivationsTest, TestFold) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'conv1' top: 'ip1' } "
+      "layer { name: 'relu2' type: 'ReLU' bottom: 'ip1' top: 'relu2' "
+      "  relu_param { negative_slope: 0.1 } } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'relu2' top: 'ip2' } ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { relu_param { } } } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'conv1' top: 'relu2' "
+      "  inner_product_param { relu_param { negative_slope: 0.1 } } } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'relu2' top: 'ip2' } ";
+  this->RunFuseTest(input_proto, expected_output_proto, 2);
+}
+
+TEST_F(FuseActivationsTest, TestNoFold) {
+  // ip1 is read by the Sigmoid layer as well as the ReLU, ip2 is preserved,
+  // and the ReLU after conv1 does not read the convolution's output.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "preserve_blob: 'ip2' "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'ip1' } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'ip1' top: 'relu1' } "
+      "layer { name: 'sig1' type: 'Sigmoid' bottom: 'ip1' top: 'sig1' } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'relu1' top: 'ip2' } "
+      "layer { name: 'relu2' type: 'ReLU' bottom: 'ip2' top: 'relu2' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' } "
+      "layer { name: 'relu3' type: 'ReLU' bottom: 'sig1' top: 'relu3' } ";
+  this->RunFuseTest(input_proto, input_proto, 0);
+}
+
+TEST_F(FuseActivationsTest, TestFoldAffine) {
+  // Both Power layers after conv1 end up in its weights and bias; ip1 gains
+  // a bias for the shift. The square in pow4 is not affine.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 1 } "
+      "  blobs { shape { dim: 1 dim: 1 dim: 1 dim: 2 } data: 1 data: 2 } "
+      "  blobs { shape { dim: 1 } data: 3 } } "
+      "layer { name: 'pow1' type: 'Power' bottom: 'conv1' top: 'conv1' "
+      "  power_param { scale: 2 shift: 1 } } "
+      "layer { name: 'pow2' type: 'Power' bottom: 'conv1' top: 'pow2' "
+      "  power_param { scale: 0.5 shift: -1 } } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'pow2' top: 'ip1' "
+      "  inner_product_param { num_output: 2 bias_term: false } "
+      "  blobs { shape { dim: 2 dim: 1 } data: 1 data: -1 } } "
+      "layer { name: 'pow3' type: 'Power' bottom: 'ip1' top: 'ip1' "
+      "  power_param { scale: 3 shift: 2 } } "
+      "layer { name: 'pow4' type: 'Power' bottom: 'ip1' top: 'pow4' "
+      "  power_param { power: 2 } } ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'pow2' convolution_param { num_output: 1 } "
+      "  blobs { shape { dim: 1 dim: 1 dim: 1 dim: 2 } data: 1 data: 2 } "
+      "  blobs { shape { dim: 1 } data: 2.5 } } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'pow2' top: 'ip1' "
+      "  inner_product_param { num_output: 2 bias_term: true } "
+      "  blobs { shape { dim: 2 dim: 1 } data: 3 data: -3 } "
+      "  blobs { shape { dim: 2 } data: 2 data: 2 } } "
+      "layer { name: 'pow4' type: 'Power' bottom: 'ip1' top: 'pow4' "
+      "  power_param { power: 2 } } ";
+  this->RunFoldAffineTest(input_proto, expected_output_proto, 3);
+}
+
+}  // namespace caffe
@@ -12,6 +12,7 @@
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/sgd_solvers.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -696,6 +697,43 @@ TYPED_TEST(SGDSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(SGDSolverTest, TestFrozenParamsIgnoreHistory) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitSolverFromProtoString(
+      "base_lr: 0.01 lr_policy: 'fixed' momentum: 0.9 weight_decay: 0.5 "
+      "net_param { "
+      "  check_unused_diffs: true "
+      "  layer { name: 'data' type: 'DummyData' top: 'data' top: 'targets' "
+      "    dummy_data_param { shape { dim: 4 dim: 3 } shape { dim: 4 dim: 1 } "
+      "      data_filler { type: 'gaussian' } } } "
+      "  layer { name: 'innerprod' type: 'InnerProduct' bottom: 'data' "
+      "    top: 'innerprod' param { lr_mult: 0 } param { lr_mult: 0 } "
+      "    inner_product_param { num_output: 1 "
+      "      weight_filler { type: 'gaussian' } "
+      "      bias_filler { type: 'gaussian' } } } "
+      "  layer { name: 'loss' type: 'EuclideanLoss' bottom: 'innerprod' "
+      "    bottom: 'targets' } "
+      "} ");
+  // As if restored from a snapshot taken before the params were frozen.
+  const vector<shared_ptr<Blob<Dtype> > >& history = this->solver_->history();
+  const vector<Blob<Dtype>*>& params =
+      this->solver_->net()->learnable_params();
+  vector<shared_ptr<Blob<Dtype> > > param_copies(params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    EXPECT_FALSE(this->solver_->net()->params_need_backward()[i]);
+    caffe_set(history[i]->count(), Dtype(1), history[i]->mutable_cpu_data());
+    param_copies[i].reset(new Blob<Dtype>());
+    param_copies[i]->CopyFrom(*params[i], false, true);
+  }
+  this->solver_->Step(2);
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_EQ(param_copies[i]->cpu_data()[j], params[i]->cpu_data()[j])
+          << "param " << i << " moved at dim " << j;
+    }
+  }
+}
+
 
 template <typename TypeParam>
 class AdaGradSolverTest : public GradientBasedSolverTest<TypeParam> {
@@ -0,0 +1,176 @@
+#include <stdint.h>
+
+#include <boost/thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {
+ protected:
+  HostAllocatorTest()
+      : cache_limit_(HostAllocator::cache_limit()),
+        total_cache_limit_(HostAllocator::total_cache_limit()) {
+    // GPU mode would pin host memory instead.
+    Caffe::set_mode(Caffe::CPU);
+  }
+  virtual ~HostAllocatorTest() {
+    HostAllocator::set_cache_limit(cache_limit_);
+    HostAllocator::set_total_cache_limit(total_cache_limit_);
+  }
+
+  const size_t cache_limit_;
+  const size_t total_cache_limit_;
+};
+
+// Records the bytes cached before the thread exits.
+void AllocateAndFree(size_t size, size_t* cached) {
+  HostAllocator::Free(HostAllocator::Allocate(size), size);
+  *cached = HostAllocator::GetStats().bytes_cached;
+}
+
+TEST_F(HostAllocatorTest, TestRoundSize) {
+  EXPECT_EQ(64, HostAllocator::RoundSize(0));
+  EXPECT_EQ(64, HostAllocator::RoundSize(1));
+  EXPECT_EQ(64, HostAllocator::RoundSize(64));
+  EXPECT_EQ(80, HostAllocator::RoundSize(65));
+  EXPECT_EQ(128, HostAllocator::RoundSize(128));
+  EXPECT_EQ(1280, HostAllocator::RoundSize(1025));
+  EXPECT_EQ(1280, HostAllocator::RoundSize(1280));
+  EXPECT_EQ(1536, HostAllocator::RoundSize(1281));
+  for (size_t size = 1; size < 100000; size = size * 3 + 1) {
+    EXPECT_GE(HostAllocator::RoundSize(size), size);
+    EXPECT_LE(HostAllocator::RoundSize(size), size + size / 4 + 64);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestAlignment) {
+  const size_t sizes[] = { 1, 100, 4096, 3 << 20 };
+  for (int i = 0; i < 4; ++i) {
+    void* ptr = HostAllocator::Allocate(sizes[i]);
+    ASSERT_TRUE(ptr);
+    const size_t alignment = (sizes[i] >= (2 << 20)) ? (2 << 20) : 64;
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) % alignment);
+    HostAllocator::Free(ptr, sizes[i]);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestReuse) {
+  HostAllocator::ReleaseCache();
+  const HostAllocator::Stats before = HostAllocator::GetStats();
+  void* ptr = HostAllocator::Allocate(1000);
+  HostAllocator::Free(ptr, 1000);
+  // Another request of the same class gets the block back.
+  void* reused = HostAllocator::Allocate(1010);
+  EXPECT_EQ(ptr, reused);
+  const HostAllocator::Stats stats = HostAllocator::GetStats();
+  EXPECT_EQ(before.misses + 1, stats.misses);
+  EXPECT_EQ(before.hits + 1, stats.hits);
+  EXPECT_EQ(before.bytes_in_use + 1024, stats.bytes_in_use);
+  EXPECT_GE(stats.peak_bytes_in_use, stats.bytes_in_use);
+  HostAllocator::Free(reused, 1010);
+  EXPECT_EQ(before.bytes_in_use, HostAllocator::GetStats().bytes_in_use);
+}
+
+TEST_F(HostAllocatorTest, TestCacheLimit) {
+  HostAllocator::ReleaseCache();
+  HostAllocator::set_cache_limit(0);
+  const size_t cached = HostAllocator::GetStats().bytes_cached;
+  void* ptr = HostAllocator::Allocate(1000);
+  HostAllocator::Free(ptr, 1000);
+  EXPECT_EQ(cached, HostAllocator::GetStats().bytes_cached);
+  HostAllocator::set_cache_limit(1024);
+  ptr = HostAllocator::Allocate(1000);
+  HostAllocator::Free(ptr, 1000);
+  EXPECT_EQ(cached + 1024, HostAllocator::GetStats().bytes_cached);
+  HostAllocator::ReleaseCache();
+  EXPECT_EQ(cached, HostAllocator::GetStats().bytes_cached);
+}
+
+TEST_F(HostAllocatorTest, TestTotalCacheLimit) {
+  HostAllocator::ReleaseCache();
+  const size_t cached = HostAllocator::GetStats().bytes_cached;
+  // Room for one block over all threads.
+  HostAllocator::set_total_cache_limit(cached + 1024);
+  size_t cached_in_thread;
+  AllocateAndFree(1000, &cached_in_thread);
+  EXPECT_EQ(cached + 1024, cached_in_thread);
+  boost::thread other(&AllocateAndFree, 1000, &cached_in_thread);
+  other.join();
+  EXPECT_EQ(cached + 1024, cached_in_thread);
+  // A thread that exits gives its blocks back.
+  HostAllocator::ReleaseCache();
+  HostAllocator::set_total_cache_limit(total_cache_limit_);
+  boost::thread exiting(&AllocateAndFree, 1000, &cached_in_thread);
+  exiting.join();
+  EXPECT_EQ(cached + 1024, cached_in_thread);
+  EXPECT_EQ(cached, HostAllocator::GetStats().bytes_cached);
+}
+
+TEST_F(HostAllocatorTest, TestSyncedMemory) {
+  HostAllocator::ReleaseCache();
+  const HostAllocator::Stats before = HostAllocator::GetStats();
+  {
+    SyncedMemory mem(1000);
+    mem.mutable_cpu_data();
+    EXPECT_EQ(before.bytes_in_use + 1024,
+        HostAllocator::GetStats().bytes_in_use);
+  }
+  EXPECT_EQ(before.bytes_in_use, HostAllocator::GetStats().bytes_in_use);
+  // A recycled block is handed out zeroed like a fresh one.
+  SyncedMemory mem(1000);
+  const char* data = static_cast<const char*>(mem.cpu_data());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(0, data[i]);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestPlacedAllocation) {
+  const HostAllocator::Stats before = HostAllocator::GetStats();
+  const HostPlacement huge_pages(true, HostPlacement::NUMA_DEFAULT);
+  char* ptr = static_cast<char*>(HostAllocator::Allocate(1000, huge_pages));
+  ASSERT_TRUE(ptr);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) % (2 << 20));
+  EXPECT_EQ(before.bytes_in_use + (2 << 20),
+      HostAllocator::GetStats().bytes_in_use);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(0, ptr[i]);
+    ptr[i] = i;
+  }
+  HostAllocator::Free(ptr, 1000, huge_pages);
+  const HostAllocator::Stats stats = HostAllocator::GetStats();
+  EXPECT_EQ(before.bytes_in_use, stats.bytes_in_use);
+  // Placed blocks go back to the system rather than to the cache.
+  EXPECT_EQ(before.bytes_cached, stats.bytes_cached);
+}
+
+TEST_F(HostAllocatorTest, TestSyncedMemoryPlacement) {
+  SyncedMemory mem(1000);
+  char* data = static_cast<char*>(mem.mutable_cpu_data());
+  for (int i = 0; i < 1000; ++i) {
+    data[i] = i;
+  }
+  const HostPlacement interleaved(true, HostPlacement::NUMA_INTERLEAVE);
+  mem.set_placement(interleaved);
+  EXPECT_TRUE(mem.placement() == interleaved);
+  // The contents move to a huge page.
+  const char* placed = static_cast<const char*>(mem.cpu_data());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(placed) % (2 << 20));
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(static_cast<char>(i), placed[i]);
+  }
+  mem.set_placement(HostPlacement());
+  EXPECT_TRUE(mem.placement().is_default());
+  const char* moved = static_cast<const char*>(mem.cpu_data());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(static_cast<char>(i), moved[i]);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,132 @@
+#include <string>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/in_place.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class InPlaceNeuronsTest : public ::testing::Test {
+ protected:
+  void RunInPlaceTest(const string& input_param_string,
+      const string& output_param_string, const int expected_rewritten) {
+    // Test that RunNeuronsInPlace called on the proto specified by
+    // input_param_string results in the proto specified by
+    // output_param_string.
+    NetParameter input_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        input_param_string, &input_param));
+    NetParameter expected_output_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        output_param_string, &expected_output_param));
+    NetParameter actual_output_param;
+    EXPECT_EQ(expected_rewritten,
+        RunNeuronsInPlace(input_param, &actual_output_param));
+    EXPECT_EQ(expected_output_param.DebugString(),
+        actual_output_param.DebugString());
+    // Also test idempotence.
+    NetParameter double_in_place_param;
+    EXPECT_EQ(0,
+        RunNeuronsInPlace(actual_output_param, &double_in_place_param));
+    EXPECT_EQ(actual_output_param.DebugString(),
+        double_in_place_param.DebugString());
+  }
+};
+
+TEST_F(InPlaceNeuronsTest, TestChain) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'ip1' } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'ip1' top: 'relu1' } "
+      "layer { name: 'pow1' type: 'Power' bottom: 'relu1' top: 'pow1' } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'pow1' top: 'ip2' } ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'pow1' } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'pow1' top: 'pow1' } "
+      "layer { name: 'pow1' type: 'Power' bottom: 'pow1' top: 'pow1' } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'pow1' top: 'ip2' } ";
+  this->RunInPlaceTest(input_proto, expected_output_proto, 2);
+}
+
+TEST_F(InPlaceNeuronsTest, TestBackward) {
+  // The Power layer reads its bottom in Backward and the Sigmoid layer its
+  // top, so neither may be overwritten when training.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TRAIN } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'ip1' } "
+      "layer { name: 'sig1' type: 'Sigmoid' bottom: 'ip1' top: 'sig1' } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'sig1' top: 'relu1' } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'relu1' top: 'ip2' } "
+      "layer { name: 'pow1' type: 'Power' bottom: 'ip2' top: 'pow1' } ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TRAIN } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'data' top: 'sig1' } "
+      "layer { name: 'sig1' type: 'Sigmoid' bottom: 'sig1' top: 'sig1' } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'sig1' top: 'relu1' } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'relu1' top: 'ip2' } "
+      "layer { name: 'pow1' type: 'Power' bottom: 'ip2' top: 'pow1' } ";
+  this->RunInPlaceTest(input_proto, expected_output_proto, 1);
+}
+
+TEST_F(InPlaceNeuronsTest, TestFusedReLU) {
+  // The convolution with a fused ReLU reads its top in Backward for the
+  // mask, so the Sigmoid may not overwrite it; the one without may be.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "force_backward: true "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+      "  convolution_param { num_output: 2 kernel_size: 3 relu_param { } } } "
+      "layer { name: 'sig1' type: 'Sigmoid' bottom: 'conv1' top: 'sig1' } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'sig1' top: 'conv2' "
+      "  convolution_param { num_output: 2 kernel_size: 3 } } "
+      "layer { name: 'sig2' type: 'Sigmoid' bottom: 'conv2' top: 'sig2' } ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "force_backward: true "
+      "state { phase: TEST } "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+      "  convolution_param { num_output: 2 kernel_size: 3 relu_param { } } } "
+      "layer { name: 'sig1' type: 'Sigmoid' bottom: 'conv1' top: 'sig1' } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'sig1' top: 'sig2' "
+      "  convolution_param { num_output: 2 kernel_size: 3 } } "
+      "layer { name: 'sig2' type: 'Sigmoid' bottom: 'sig2' top: 'sig2' } ";
+  this->RunInPlaceTest(input_proto, expected_output_proto, 1);
+}
+
+TEST_F(InPlaceNeuronsTest, TestNoRewrite) {
+  // The data layer top, a blob with two consumers, a preserved blob and a
+  // reshaped blob that shares memory with its bottom all stay as they are.
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "preserve_blob: 'ip2' "
+      "layer { name: 'data' type: 'DummyData' top: 'data' } "
+      "layer { name: 'relu0' type: 'ReLU' bottom: 'data' top: 'relu0' } "
+      "layer { name: 'ip1' type: 'InnerProduct' bottom: 'relu0' top: 'ip1' } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'ip1' top: 'relu1' } "
+      "layer { name: 'tanh1' type: 'TanH' bottom: 'ip1' top: 'tanh1' } "
+      "layer { name: 'ip2' type: 'InnerProduct' bottom: 'relu1' top: 'ip2' } "
+      "layer { name: 'relu2' type: 'ReLU' bottom: 'ip2' top: 'relu2' } "
+      "layer { name: 'flat' type: 'Flatten' bottom: 'tanh1' top: 'flat' } "
+      "layer { name: 'exp1' type: 'Exp' bottom: 'flat' top: 'exp1' } ";
+  this->RunInPlaceTest(input_proto, input_proto, 0);
+}
+
+}  // namespace caffe
@@ -92,6 +92,68 @@ TYPED_TEST(InnerProductLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardPackedGemm) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  shared_ptr<InnerProductLayer<Dtype> > layer(
+      new InnerProductLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> blas_top;
+  blas_top.CopyFrom(*this->blob_top_, false, true);
+  Caffe::set_cpu_gemm(Caffe::PACKED);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Caffe::set_cpu_gemm(Caffe::BLAS);
+  for (int i = 0; i < blas_top.count(); ++i) {
+    EXPECT_NEAR(blas_top.cpu_data()[i], this->blob_top_->cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardSparse) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->set_sparse_threshold(0.5);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  shared_ptr<InnerProductLayer<Dtype> > layer(
+      new InnerProductLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype>* weights = layer->blobs()[0].get();
+  for (int i = 0; i < weights->count(); ++i) {
+    if (i % 4 != 0) {
+      weights->mutable_cpu_data()[i] = 0;
+    }
+  }
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int M = this->blob_bottom_->num();
+  const int K = this->blob_bottom_->count(1);
+  vector<Dtype> expected(M * 10);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, 10, K, (Dtype)1.,
+      this->blob_bottom_->cpu_data(), weights->cpu_data(), (Dtype)0.,
+      &expected[0]);
+  for (int i = 0; i < M * 10; ++i) {
+    EXPECT_NEAR(expected[i] + layer->blobs()[1]->cpu_data()[i % 10],
+        this->blob_top_->cpu_data()[i], 1e-4);
+  }
+}
+
 TYPED_TEST(InnerProductLayerTest, TestForwardNoBatch) {
   typedef typename TypeParam::Dtype Dtype;
   this->blob_bottom_vec_.push_back(this->blob_bottom_nobatch_);
@@ -149,4 +211,65 @@ TYPED_TEST(InnerProductLayerTest, TestGradient) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestGradientFusedReLU) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  InnerProductLayer<Dtype> ip(layer_param);
+  ip.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  LayerParameter relu_layer_param;
+  relu_layer_param.mutable_relu_param()->set_negative_slope(0.1);
+  ReLULayer<Dtype> relu(relu_layer_param);
+  relu.SetUp(this->blob_top_vec_, this->blob_top_vec_);
+  inner_product_param->mutable_relu_param()->set_negative_slope(0.1);
+  InnerProductLayer<Dtype> fused(layer_param);
+  Blob<Dtype> fused_top;
+  vector<Blob<Dtype>*> fused_top_vec(1, &fused_top);
+  fused.SetUp(this->blob_bottom_vec_, fused_top_vec);
+  for (int j = 0; j < 2; ++j) {
+    fused.blobs()[j]->CopyFrom(*ip.blobs()[j]);
+    caffe_set(ip.blobs()[j]->count(), Dtype(0),
+        ip.blobs()[j]->mutable_cpu_diff());
+    caffe_set(fused.blobs()[j]->count(), Dtype(0),
+        fused.blobs()[j]->mutable_cpu_diff());
+  }
+  // The fused layer gets the gradients of a ReLU layer run in place after
+  // the inner product.
+  ip.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  relu.Forward(this->blob_top_vec_, this->blob_top_vec_);
+  fused.Forward(this->blob_bottom_vec_, fused_top_vec);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> top_diff(this->blob_top_->shape());
+  filler.Fill(&top_diff);
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      fused_top.mutable_cpu_diff());
+  vector<bool> propagate_down(1, true);
+  relu.Backward(this->blob_top_vec_, propagate_down, this->blob_top_vec_);
+  ip.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_bottom_, true, true);
+  fused.Backward(fused_top_vec, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_diff()[i], this->blob_bottom_->cpu_diff()[i],
+        1e-4);
+  }
+  for (int j = 0; j < 2; ++j) {
+    for (int i = 0; i < ip.blobs()[j]->count(); ++i) {
+      EXPECT_NEAR(ip.blobs()[j]->cpu_diff()[i],
+          fused.blobs()[j]->cpu_diff()[i], 1e-4);
+    }
+  }
+}
+
 }  // namespace caffe
@@ -1,8 +1,10 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
+#include <unistd.h>
 #include <climits>
 #include <cmath>  // for std::fabs
 #include <cstdlib>  // for rand_r
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -150,6 +152,36 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestAcrossInt32Boundary) {
+  // 2^31 + 1024 elements, which BLAS has to take in two pieces.
+  vector<int> shape(2);
+  shape[0] = 2;
+  shape[1] = (1 << 30) + 512;
+  const int64_t n = int64_t(shape[0]) * shape[1];
+  const int64_t bytes = n * sizeof(TypeParam);
+  if (int64_t(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGESIZE) < 2 * bytes) {
+    LOG(INFO) << "Skipping: needs " << bytes << " bytes of memory.";
+    return;
+  }
+  Blob<TypeParam> blob(shape);
+  ASSERT_EQ(n, blob.count());
+  TypeParam* x = blob.mutable_cpu_data();
+  const int64_t indices[] = { 0, INT_MAX - 1, INT_MAX, n - 1 };
+  caffe_set(n, TypeParam(1), x);
+  caffe_scal(n, TypeParam(3), x);
+  caffe_add_scalar(n, TypeParam(1), x);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(4, x[indices[i]]);
+  }
+  // Only the ends are set, so the sums are exact.
+  caffe_set(n, TypeParam(0), x);
+  x[0] = -1;
+  x[n - 1] = 2;
+  EXPECT_EQ(3, caffe_cpu_asum(n, x));
+  EXPECT_EQ(5, caffe_cpu_dot(n, x, x));
+  EXPECT_EQ(3, blob.asum_data());
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
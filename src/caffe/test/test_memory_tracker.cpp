@@ -0,0 +1,130 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/memory_tracker.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class MemoryTrackerTest : public ::testing::Test {};
+
+TEST_F(MemoryTrackerTest, TestOwners) {
+  const int owner = MemoryTracker::Owner("TestOwners owner");
+  EXPECT_GT(owner, 0);
+  EXPECT_EQ(owner, MemoryTracker::Owner("TestOwners owner"));
+  EXPECT_NE(owner, MemoryTracker::Owner("TestOwners other owner"));
+  EXPECT_EQ("TestOwners owner", MemoryTracker::owner_name(owner));
+  EXPECT_EQ("other", MemoryTracker::owner_name(0));
+}
+
+TEST_F(MemoryTrackerTest, TestScope) {
+  const int outer = MemoryTracker::Owner("TestScope outer");
+  const int inner = MemoryTracker::Owner("TestScope inner");
+  const int previous = MemoryTracker::current_owner();
+  {
+    MemoryTracker::Scope outer_scope(outer);
+    EXPECT_EQ(outer, MemoryTracker::current_owner());
+    {
+      MemoryTracker::Scope inner_scope(inner);
+      EXPECT_EQ(inner, MemoryTracker::current_owner());
+    }
+    EXPECT_EQ(outer, MemoryTracker::current_owner());
+  }
+  EXPECT_EQ(previous, MemoryTracker::current_owner());
+}
+
+TEST_F(MemoryTrackerTest, TestSyncedMemory) {
+  Caffe::set_mode(Caffe::CPU);
+  const int owner = MemoryTracker::Owner("TestSyncedMemory owner");
+  const MemoryTracker::Usage total_before =
+      MemoryTracker::GetTotal(MemoryTracker::HOST);
+  {
+    SyncedMemory first(1000);
+    SyncedMemory second(3000);
+    {
+      MemoryTracker::Scope scope(owner);
+      first.mutable_cpu_data();
+    }
+    // The owner is the one in scope at the allocation, not at construction.
+    EXPECT_EQ(owner, first.owner());
+    EXPECT_EQ(-1, second.owner());
+    {
+      MemoryTracker::Scope scope(owner);
+      second.cpu_data();
+    }
+    const MemoryTracker::Usage usage =
+        MemoryTracker::GetUsage(owner, MemoryTracker::HOST);
+    EXPECT_EQ(4000, usage.bytes);
+    EXPECT_EQ(4000, usage.peak_bytes);
+    EXPECT_EQ(total_before.bytes + 4000,
+        MemoryTracker::GetTotal(MemoryTracker::HOST).bytes);
+    // Borrowing memory frees the own memory.
+    char borrowed[1000];
+    first.set_cpu_data(borrowed);
+    EXPECT_EQ(3000,
+        MemoryTracker::GetUsage(owner, MemoryTracker::HOST).bytes);
+  }
+  MemoryTracker::Usage usage =
+      MemoryTracker::GetUsage(owner, MemoryTracker::HOST);
+  EXPECT_EQ(0, usage.bytes);
+  EXPECT_EQ(4000, usage.peak_bytes);
+  EXPECT_EQ(total_before.bytes,
+      MemoryTracker::GetTotal(MemoryTracker::HOST).bytes);
+  MemoryTracker::ResetPeaks();
+  usage = MemoryTracker::GetUsage(owner, MemoryTracker::HOST);
+  EXPECT_EQ(0, usage.peak_bytes);
+}
+
+TEST_F(MemoryTrackerTest, TestNetLayers) {
+  Caffe::set_mode(Caffe::CPU);
+  const string& proto =
+      "name: 'MemoryTrackerNet' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 } "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 4 } "
+      "  bottom: 'data' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip' "
+      "  top: 'relu' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TEST);
+  param.set_in_place_neurons(false);
+  const int ip = MemoryTracker::Owner("MemoryTrackerNet/ip");
+  const int relu = MemoryTracker::Owner("MemoryTrackerNet/relu");
+  {
+    Net<float> net(param);
+    // The setup of ip fills its weights (4 x 3) and bias (4), sets its
+    // bias multiplier (2) and records the shapes of those and of its top.
+    const size_t ip_shapes = (2 + 1 + 1 + 2) * sizeof(int);
+    EXPECT_EQ(18 * sizeof(float) + ip_shapes,
+        MemoryTracker::GetUsage(ip, MemoryTracker::HOST).bytes);
+    net.input_blobs()[0]->mutable_cpu_data();
+    net.ForwardPrefilled();
+    // Then each layer allocates its top (2 x 4) when writing it.
+    EXPECT_EQ(26 * sizeof(float) + ip_shapes,
+        MemoryTracker::GetUsage(ip, MemoryTracker::HOST).bytes);
+    EXPECT_EQ(8 * sizeof(float) + 2 * sizeof(int),
+        MemoryTracker::GetUsage(relu, MemoryTracker::HOST).bytes);
+    net.LogMemoryUsage();
+  }
+  EXPECT_EQ(0, MemoryTracker::GetUsage(ip, MemoryTracker::HOST).bytes);
+  EXPECT_EQ(0, MemoryTracker::GetUsage(relu, MemoryTracker::HOST).bytes);
+}
+
+}  // namespace caffe
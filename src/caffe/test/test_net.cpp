@@ -1,3 +1,4 @@
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <utility>
 #include <vector>
@@ -7,9 +8,13 @@
 #include "gtest/gtest.h"
 
 #include "caffe/common.hpp"
+#include "caffe/data_layers.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/net.hpp"
+#include "caffe/util/fuse_activations.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/memory_tracker.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -2379,4 +2384,1552 @@ TYPED_TEST(NetTest, TestSkipPropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestSparseThresholdInherited) {
+  const string& proto =
+      "name: 'TestNetwork' "
+      "sparse_threshold: 0.75 "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 5 dim: 5 } "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 } "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 sparse_threshold: 0.5 } "
+      "  bottom: 'conv' "
+      "  top: 'ip' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  EXPECT_FLOAT_EQ(0.75, this->net_->layer_by_name("conv")->layer_param()
+      .convolution_param().sparse_threshold());
+  EXPECT_FLOAT_EQ(0.5, this->net_->layer_by_name("ip")->layer_param()
+      .inner_product_param().sparse_threshold());
+}
+
+TYPED_TEST(NetTest, TestTuneConvolution) {
+  if (Caffe::mode() != Caffe::CPU) { return; }
+  string cache_file;
+  MakeTempFilename(&cache_file);
+  const string& proto =
+      "name: 'TestNetwork' "
+      "tune_convolution: true "
+      "tuning_cache: '" + cache_file + "' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 9 dim: 9 } "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 } "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 "
+      "                      cpu_algorithm: GEMM } "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  const ConvolutionParameter& tuned = this->net_->layer_by_name("conv1")
+      ->layer_param().convolution_param();
+  EXPECT_TRUE(tuned.engine() == ConvolutionParameter_Engine_FFT ||
+      (tuned.engine() == ConvolutionParameter_Engine_CAFFE &&
+       tuned.cpu_algorithm() != ConvolutionParameter_CpuAlgorithm_AUTO));
+  // Layers that pick their own algorithm are left alone.
+  const ConvolutionParameter& fixed = this->net_->layer_by_name("conv2")
+      ->layer_param().convolution_param();
+  EXPECT_EQ(ConvolutionParameter_Engine_DEFAULT, fixed.engine());
+  EXPECT_EQ(ConvolutionParameter_CpuAlgorithm_GEMM, fixed.cpu_algorithm());
+  // The choice is cached: edit it and check that a new net follows it.
+  vector<string> lines;
+  {
+    std::ifstream file(cache_file.c_str());
+    string line;
+    while (std::getline(file, line)) {
+      lines.push_back(line);
+    }
+  }
+  ASSERT_EQ(1, lines.size());
+  const string& line = lines[0];
+  const size_t tab = line.rfind('\t');
+  ASSERT_NE(string::npos, tab);
+  {
+    std::ofstream file(cache_file.c_str());
+    file << line.substr(0, tab) << "\tDIRECT\n";
+  }
+  this->InitNetFromProtoString(proto);
+  const ConvolutionParameter& cached = this->net_->layer_by_name("conv1")
+      ->layer_param().convolution_param();
+  EXPECT_EQ(ConvolutionParameter_Engine_CAFFE, cached.engine());
+  EXPECT_EQ(ConvolutionParameter_CpuAlgorithm_DIRECT, cached.cpu_algorithm());
+}
+
+TYPED_TEST(NetTest, TestPlanMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'conv3' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'conv2' "
+      "  top: 'conv3' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'conv1' "
+      "  bottom: 'conv3' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'flat' "
+      "  type: 'Flatten' "
+      "  bottom: 'sum' "
+      "  top: 'flat' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'flat' "
+      "  top: 'ip' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference_net = this->net_;
+  EXPECT_EQ(0, reference_net->planned_memory());
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_plan_memory(true);
+  Net<Dtype> net(param);
+  net.ShareTrainedLayersWith(reference_net.get());
+  // Unplanned, conv1, conv2, conv3 and sum take one conv_size each. conv2
+  // dies before sum is computed, so the two can share.
+  const size_t conv_size = 2 * 4 * 8 * 8 * sizeof(Dtype);
+  EXPECT_EQ(3 * conv_size, net.planned_memory());
+  // Looking a blob up leaves the plan alone; preserving it before Forward
+  // keeps its values.
+  const shared_ptr<Blob<Dtype> > conv2 = net.blob_by_name("conv2");
+  EXPECT_EQ(3 * conv_size, net.planned_memory());
+  net.PreserveBlob("conv2");
+  EXPECT_EQ(4 * conv_size, net.planned_memory());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int pass = 0; pass < 2; ++pass) {
+    filler.Fill(reference_net->input_blobs()[0]);
+    net.input_blobs()[0]->CopyFrom(*reference_net->input_blobs()[0]);
+    reference_net->ForwardPrefilled();
+    net.ForwardPrefilled();
+    const Blob<Dtype>* expected_blobs[] = {
+      reference_net->blob_by_name("ip").get(),
+      reference_net->blob_by_name("conv2").get()
+    };
+    const Blob<Dtype>* blobs[] = { net.output_blobs()[0], conv2.get() };
+    for (int b = 0; b < 2; ++b) {
+      ASSERT_EQ(expected_blobs[b]->count(), blobs[b]->count());
+      for (int i = 0; i < blobs[b]->count(); ++i) {
+        EXPECT_EQ(expected_blobs[b]->cpu_data()[i], blobs[b]->cpu_data()[i]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestGradientCheckpointing) {
+  typedef typename TypeParam::Dtype Dtype;
+  ostringstream proto;
+  proto << "name: 'TestNetwork' "
+      "state { phase: TRAIN } "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+      "input: 'target' "
+      "input_shape { dim: 2 dim: 5 } ";
+  // Four conv + ReLU pairs with dropout after the third and checkpoints
+  // after the second and the fourth.
+  string bottom = "data";
+  for (int i = 1; i <= 4; ++i) {
+    ostringstream top;
+    top << "conv" << i;
+    proto << "layer { name: '" << top.str() << "' type: 'Convolution' "
+        "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' } } "
+        "  bottom: '" << bottom << "' top: '" << top.str() << "' } "
+        "layer { name: 'relu" << i << "' type: 'ReLU' "
+        "  bottom: '" << top.str() << "' top: '" << top.str() << "' "
+        "  checkpoint: " << (i % 2 == 0 ? "true" : "false") << " } ";
+    if (i == 3) {
+      proto << "layer { name: 'drop3' type: 'Dropout' "
+          "  bottom: 'conv3' top: 'conv3' } ";
+    }
+    bottom = top.str();
+  }
+  proto << "layer { name: 'ip' type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'conv4' top: 'ip' } "
+      "layer { name: 'loss' type: 'EuclideanLoss' "
+      "  bottom: 'ip' bottom: 'target' top: 'loss' } ";
+  this->InitNetFromProtoString(proto.str());
+  shared_ptr<Net<Dtype> > reference_net = this->net_;
+  EXPECT_EQ(0, reference_net->num_checkpoint_segments());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < 2; ++i) {
+    filler.Fill(reference_net->input_blobs()[i]);
+  }
+  Caffe::set_random_seed(this->seed_);
+  Dtype expected_loss;
+  reference_net->ForwardPrefilled(&expected_loss);
+  reference_net->ClearParamDiffs();
+  reference_net->Backward();
+  const size_t conv_size = 2 * 4 * 8 * 8 * sizeof(Dtype);
+  for (int marked = 0; marked < 2; ++marked) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto.str(), &param));
+    param.set_gradient_checkpointing(true);
+    for (int i = 0; i < param.layer_size(); ++i) {
+      param.mutable_layer(i)->set_checkpoint(
+          marked && param.layer(i).checkpoint());
+    }
+    Net<Dtype> net(param);
+    net.ShareTrainedLayersWith(reference_net.get());
+    // The 11 layers form 3 segments either way. With the marks, conv1, conv3
+    // and ip are each used within one segment and share their memory.
+    EXPECT_EQ(3, net.num_checkpoint_segments());
+    if (marked) {
+      EXPECT_EQ(conv_size, net.planned_memory());
+    }
+    for (int i = 0; i < 2; ++i) {
+      net.input_blobs()[i]->CopyFrom(*reference_net->input_blobs()[i]);
+    }
+    Caffe::set_random_seed(this->seed_);
+    Dtype loss;
+    net.ForwardPrefilled(&loss);
+    net.ClearParamDiffs();
+    net.Backward();
+    EXPECT_EQ(expected_loss, loss);
+    const vector<Blob<Dtype>*>& params = net.learnable_params();
+    const vector<Blob<Dtype>*>& expected_params =
+        reference_net->learnable_params();
+    ASSERT_EQ(expected_params.size(), params.size());
+    for (int i = 0; i < params.size(); ++i) {
+      for (int j = 0; j < params[i]->count(); ++j) {
+        EXPECT_EQ(expected_params[i]->cpu_diff()[j], params[i]->cpu_diff()[j]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestUnusedDiffs) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A frozen conv1 below a trainable ip, and an unused accuracy-like branch.
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TRAIN } "
+      "check_unused_diffs: true "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 4 dim: 4 } "
+      "input: 'target' "
+      "input_shape { dim: 2 dim: 5 } "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  param { lr_mult: 0 } "
+      "  param { lr_mult: 0 } "
+      "  convolution_param { num_output: 2 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'conv1' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'ip' "
+      "  bottom: 'target' "
+      "  top: 'loss' "
+      "} "
+      "layer { "
+      "  name: 'hinge' "
+      "  type: 'HingeLoss' "
+      "  loss_weight: 0 "
+      "  bottom: 'ip' "
+      "  bottom: 'label' "
+      "  top: 'hinge' "
+      "} ";
+  // The hinge loss needs labels; feed them through a second input.
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.add_input("label");
+  param.add_input_shape()->add_dim(2);
+  Net<Dtype> net(param);
+  const vector<bool>& params_need_backward = net.params_need_backward();
+  ASSERT_EQ(4, params_need_backward.size());
+  EXPECT_FALSE(params_need_backward[0]);
+  EXPECT_FALSE(params_need_backward[1]);
+  EXPECT_TRUE(params_need_backward[2]);
+  EXPECT_TRUE(params_need_backward[3]);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(net.input_blobs()[0]);
+  filler.Fill(net.input_blobs()[1]);
+  caffe_set(2, Dtype(1), net.input_blobs()[2]->mutable_cpu_data());
+  const vector<Blob<Dtype>*>& params = net.learnable_params();
+  const Dtype conv_weight = params[0]->cpu_data()[0];
+  // Forward, Backward and Update check the unused diffs themselves.
+  for (int iter = 0; iter < 2; ++iter) {
+    net.ClearParamDiffs();
+    net.ForwardPrefilled();
+    net.Backward();
+    net.Update();
+  }
+  EXPECT_EQ(conv_weight, params[0]->cpu_data()[0]);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED, params[i]->diff()->head());
+  }
+  EXPECT_NE(SyncedMemory::UNINITIALIZED, params[2]->diff()->head());
+  const char* const unused[] = { "data", "target", "conv1", "label" };
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+        net.blob_by_name(unused[i])->diff()->head()) << unused[i];
+  }
+  EXPECT_NE(SyncedMemory::UNINITIALIZED,
+      net.blob_by_name("ip")->diff()->head());
+}
+
+TYPED_TEST(NetTest, TestPlaceMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+      "force_backward: true "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'conv' "
+      "  top: 'ip' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  // The conv biases (4 values) are too small to be placed.
+  param.mutable_param_placement()->set_huge_pages(true);
+  param.mutable_param_placement()->set_min_bytes(5 * sizeof(Dtype));
+  param.mutable_activation_placement()->set_huge_pages(true);
+  param.mutable_activation_placement()->set_min_bytes(0);
+  Net<Dtype> net(param);
+  const vector<Blob<Dtype>*>& params = net.learnable_params();
+  ASSERT_EQ(4, params.size());
+  EXPECT_TRUE(params[0]->data()->placement().huge_pages);
+  EXPECT_FALSE(params[1]->data()->placement().huge_pages);
+  EXPECT_TRUE(params[2]->data()->placement().huge_pages);
+  EXPECT_TRUE(params[2]->diff()->placement().huge_pages);
+  EXPECT_TRUE(net.blob_by_name("conv")->data()->placement().huge_pages);
+  if (Caffe::mode() == Caffe::CPU) {
+    EXPECT_EQ(0, reinterpret_cast<size_t>(params[0]->cpu_data()) %
+        (2 << 20));
+    EXPECT_EQ(0, reinterpret_cast<size_t>(
+        net.blob_by_name("conv")->cpu_data()) % (2 << 20));
+  }
+  // Placement moves the memory, not the values.
+  NetParameter trained;
+  this->net_->ToProto(&trained);
+  net.CopyTrainedLayersFrom(trained);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->net_->input_blobs()[0]);
+  net.input_blobs()[0]->CopyFrom(*this->net_->input_blobs()[0]);
+  this->net_->ForwardPrefilled();
+  net.ForwardPrefilled();
+  const Blob<Dtype>* expected = this->net_->output_blobs()[0];
+  const Blob<Dtype>* output = net.output_blobs()[0];
+  ASSERT_EQ(expected->count(), output->count());
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_EQ(expected->cpu_data()[i], output->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestInPlaceNeurons) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "in_place_neurons: false "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 6 } "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 8 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip1' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'sig1' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'relu1' "
+      "  top: 'sig1' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'sig1' "
+      "  top: 'ip2' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference_net = this->net_;
+  EXPECT_EQ(5, reference_net->blobs().size());
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_in_place_neurons(true);
+  Net<Dtype> net(param);
+  net.ShareTrainedLayersWith(reference_net.get());
+  // ip1, relu1 and sig1 became one blob named after the last of them.
+  EXPECT_EQ(3, net.blobs().size());
+  EXPECT_FALSE(net.has_blob("ip1"));
+  EXPECT_FALSE(net.has_blob("relu1"));
+  EXPECT_TRUE(net.has_blob("sig1"));
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(reference_net->input_blobs()[0]);
+  net.input_blobs()[0]->CopyFrom(*reference_net->input_blobs()[0]);
+  const Blob<Dtype>* expected = reference_net->ForwardPrefilled()[0];
+  const Blob<Dtype>* output = net.ForwardPrefilled()[0];
+  ASSERT_EQ(expected->count(), output->count());
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_EQ(expected->cpu_data()[i], output->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestFuseActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'conv1' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  relu_param { negative_slope: 0.1 } "
+      "  bottom: 'ip1' "
+      "  top: 'relu2' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference_net = this->net_;
+  EXPECT_EQ(4, reference_net->layers().size());
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_fuse_activations(true);
+  Net<Dtype> net(param);
+  net.ShareTrainedLayersWith(reference_net.get());
+  if (Caffe::mode() == Caffe::CPU) {
+    // Both ReLU layers were folded; ip1 now writes relu2.
+    EXPECT_EQ(2, net.layers().size());
+    EXPECT_FALSE(net.has_layer("relu1"));
+    EXPECT_FALSE(net.has_blob("ip1"));
+  } else {
+    EXPECT_EQ(4, net.layers().size());
+  }
+  EXPECT_TRUE(net.has_blob("relu2"));
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(reference_net->input_blobs()[0]);
+  net.input_blobs()[0]->CopyFrom(*reference_net->input_blobs()[0]);
+  const Blob<Dtype>* expected = reference_net->ForwardPrefilled()[0];
+  const Blob<Dtype>* output = net.ForwardPrefilled()[0];
+  ASSERT_EQ(expected->count(), output->count());
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_NEAR(expected->cpu_data()[i], output->cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(NetTest, TestFoldAffineLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 bias_term: false "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'pow1' "
+      "  type: 'Power' "
+      "  power_param { scale: -0.5 shift: 0.25 } "
+      "  bottom: 'conv1' "
+      "  top: 'pow1' "
+      "} "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'pow1' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'pow2' "
+      "  type: 'Power' "
+      "  power_param { scale: 2 shift: -1 } "
+      "  bottom: 'ip1' "
+      "  top: 'ip1' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference_net = this->net_;
+  // Fold the trained net saved with its weights.
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  NetParameter trained_param;
+  reference_net->ToProto(&trained_param);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    param.mutable_layer(i)->mutable_blobs()->CopyFrom(
+        trained_param.layer(i).blobs());
+  }
+  NetParameter folded_param;
+  EXPECT_EQ(2, FoldAffineLayers(param, &folded_param));
+  // The net folds the same layers itself when asked to at load time, and
+  // its replicas start from the folded definition.
+  param.set_fold_affine_layers(true);
+  Net<Dtype> loaded_net(param);
+  const shared_ptr<Net<Dtype> > replica = loaded_net.Replicate();
+  Net<Dtype> net(folded_param);
+  // So does a net built from a definition file and a weights file.
+  for (int i = 0; i < param.layer_size(); ++i) {
+    param.mutable_layer(i)->clear_blobs();
+  }
+  string definition_file, weights_file;
+  MakeTempFilename(&definition_file);
+  MakeTempFilename(&weights_file);
+  WriteProtoToTextFile(param, definition_file);
+  WriteProtoToBinaryFile(trained_param, weights_file);
+  Net<Dtype> file_net(definition_file, TEST, weights_file);
+  Net<Dtype>* const nets[] = { &net, &loaded_net, replica.get(), &file_net };
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(reference_net->input_blobs()[0]);
+  const Blob<Dtype>* expected = reference_net->ForwardPrefilled()[0];
+  for (int n = 0; n < 4; ++n) {
+    EXPECT_EQ(2, nets[n]->layers().size());
+    EXPECT_EQ(2, nets[n]->layer_by_name("conv1")->blobs().size());
+    nets[n]->input_blobs()[0]->CopyFrom(*reference_net->input_blobs()[0]);
+    const Blob<Dtype>* output = nets[n]->ForwardPrefilled()[0];
+    ASSERT_EQ(expected->count(), output->count());
+    for (int i = 0; i < output->count(); ++i) {
+      EXPECT_NEAR(expected->cpu_data()[i], output->cpu_data()[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestLayerThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "force_backward: true "
+      "layer_threads: 1 "
+      "input: 'data' "
+      "input_shape { dim: 4 dim: 6 } "
+      "input: 'target' "
+      "input_shape { dim: 4 dim: 3 } "
+      "layer { "
+      "  name: 'ip_a' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip_a' "
+      "} "
+      "layer { "
+      "  name: 'relu_a' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip_a' "
+      "  top: 'ip_a' "
+      "} "
+      "layer { "
+      "  name: 'ip_b' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip_b' "
+      "} "
+      "layer { "
+      "  name: 'sigmoid_b' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'ip_b' "
+      "  top: 'sigmoid_b' "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'ip_a' "
+      "  bottom: 'sigmoid_b' "
+      "  top: 'concat' "
+      "} "
+      "layer { "
+      "  name: 'ip_c' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'concat' "
+      "  top: 'ip_c' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'ip_c' "
+      "  bottom: 'target' "
+      "  top: 'loss' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference_net = this->net_;
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_layer_threads(3);
+  Net<Dtype> net(param);
+  net.ShareTrainedLayersWith(reference_net.get());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < 2; ++i) {
+    filler.Fill(reference_net->input_blobs()[i]);
+    net.input_blobs()[i]->CopyFrom(*reference_net->input_blobs()[i]);
+  }
+  // The branches run concurrently, but compute what they do in order.
+  for (int iter = 0; iter < 3; ++iter) {
+    Dtype expected_loss, loss;
+    reference_net->ForwardPrefilled(&expected_loss);
+    net.ForwardPrefilled(&loss);
+    EXPECT_EQ(expected_loss, loss);
+    reference_net->Backward();
+    net.Backward();
+    const Blob<Dtype>& expected_diff = *reference_net->input_blobs()[0];
+    const Blob<Dtype>& diff = *net.input_blobs()[0];
+    for (int i = 0; i < diff.count(); ++i) {
+      EXPECT_EQ(expected_diff.cpu_diff()[i], diff.cpu_diff()[i]);
+    }
+    for (int j = 0; j < net.params().size(); ++j) {
+      const Blob<Dtype>& expected_param = *reference_net->params()[j];
+      const Blob<Dtype>& param_blob = *net.params()[j];
+      for (int i = 0; i < param_blob.count(); ++i) {
+        EXPECT_EQ(expected_param.cpu_diff()[i], param_blob.cpu_diff()[i]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestLayerThreadsDeterministic) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "layer_threads: 2 "
+      "state { phase: TRAIN } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { shape { dim: 8 dim: 16 } "
+      "    data_filler { type: 'constant' value: 1 } } "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'drop_a' "
+      "  type: 'Dropout' "
+      "  bottom: 'data' "
+      "  top: 'drop_a' "
+      "} "
+      "layer { "
+      "  name: 'drop_b' "
+      "  type: 'Dropout' "
+      "  bottom: 'data' "
+      "  top: 'drop_b' "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'drop_a' "
+      "  bottom: 'drop_b' "
+      "  top: 'concat' "
+      "} ";
+  // Each layer draws from its own stream, seeded when the net is built.
+  Caffe::set_random_seed(1701);
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > first_net = this->net_;
+  Caffe::set_random_seed(1701);
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > second_net = this->net_;
+  for (int iter = 0; iter < 3; ++iter) {
+    const Blob<Dtype>* expected = first_net->ForwardPrefilled()[0];
+    const Blob<Dtype>* output = second_net->ForwardPrefilled()[0];
+    ASSERT_EQ(expected->count(), output->count());
+    for (int i = 0; i < output->count(); ++i) {
+      EXPECT_EQ(expected->cpu_data()[i], output->cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardPipelined) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 6 dim: 5 } "
+      "input: 'target' "
+      "input_shape { dim: 6 dim: 2 } "
+      "preserve_blob: 'ip1' "
+      "preserve_blob: 'ip2' "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 4 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip1' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'relu1' "
+      "  top: 'ip2' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'ip2' "
+      "  bottom: 'target' "
+      "  top: 'loss' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference_net = this->net_;
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_micro_batch_size(2);
+  param.set_pipeline_stages(3);
+  Net<Dtype> net(param);
+  net.ShareTrainedLayersWith(reference_net.get());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  const char* results[] = { "ip1", "ip2", "loss" };
+  for (int iter = 0; iter < 2; ++iter) {
+    for (int i = 0; i < 2; ++i) {
+      filler.Fill(reference_net->input_blobs()[i]);
+      net.input_blobs()[i]->CopyFrom(*reference_net->input_blobs()[i]);
+    }
+    Dtype expected_loss, loss;
+    reference_net->ForwardPrefilled(&expected_loss);
+    net.ForwardPrefilled(&loss);
+    EXPECT_NEAR(expected_loss, loss, 1e-4);
+    // The micro-batches give the slices of the batch, and the mean loss.
+    for (int j = 0; j < 3; ++j) {
+      const Blob<Dtype>& expected = *reference_net->blob_by_name(results[j]);
+      const Blob<Dtype>& result = *net.blob_by_name(results[j]);
+      ASSERT_EQ(expected.count(), result.count());
+      for (int i = 0; i < result.count(); ++i) {
+        EXPECT_NEAR(expected.cpu_data()[i], result.cpu_data()[i], 1e-4);
+      }
+    }
+  }
+  // The pipeline can also run just the layers that some blobs need.
+  caffe_set(net.blob_by_name("ip2")->count(), Dtype(0),
+      net.blob_by_name("ip2")->mutable_cpu_data());
+  net.ForwardPruned(vector<string>(1, "ip2"));
+  const Blob<Dtype>& expected = *reference_net->blob_by_name("ip2");
+  const Blob<Dtype>& result = *net.blob_by_name("ip2");
+  for (int i = 0; i < result.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], result.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardPipelinedMixingSamples) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 4 dim: 5 } "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  concat_param { axis: 0 } "
+      "  bottom: 'ip1' "
+      "  bottom: 'ip1' "
+      "  top: 'concat' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'concat' "
+      "  top: 'ip2' "
+      "} ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference_net = this->net_;
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(
+      "micro_batch_size: 2 pipeline_stages: 2 " + proto);
+  Net<Dtype>& net = *this->net_;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(reference_net->input_blobs()[0]);
+  net.input_blobs()[0]->CopyFrom(*reference_net->input_blobs()[0]);
+  // The Concat along the batch axis keeps the net from pipelining, so it
+  // runs the whole batch.
+  const Blob<Dtype>& expected = *reference_net->ForwardPrefilled()[0];
+  const Blob<Dtype>& output = *net.ForwardPrefilled()[0];
+  ASSERT_TRUE(expected.shape() == output.shape());
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], output.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardPruned) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 4 dim: 5 } "
+      "input: 'target' "
+      "input_shape { dim: 4 dim: 2 } "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip1' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'ip1' "
+      "  top: 'ip2' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'ip2' "
+      "  bottom: 'target' "
+      "  top: 'loss' "
+      "} "
+      "layer { "
+      "  name: 'unused' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'unused' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->net_->input_blobs()[0]);
+  filler.Fill(this->net_->input_blobs()[1]);
+  this->net_->ForwardPrefilled();
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->net_->blob_by_name("ip2"), false, true);
+  const Dtype kUntouched = 42;
+  const char* skipped[] = { "loss", "unused" };
+  for (int j = 0; j < 2; ++j) {
+    caffe_set(this->net_->blob_by_name(skipped[j])->count(), kUntouched,
+        this->net_->blob_by_name(skipped[j])->mutable_cpu_data());
+  }
+  caffe_set(expected.count(), Dtype(0),
+      this->net_->blob_by_name("ip2")->mutable_cpu_data());
+  // ip2 needs ip1 and relu1, but neither the loss nor the unused branch.
+  vector<string> blob_names(1, "ip2");
+  EXPECT_EQ(0, this->net_->ForwardPruned(blob_names));
+  const Blob<Dtype>& result = *this->net_->blob_by_name("ip2");
+  for (int i = 0; i < result.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], result.cpu_data()[i]);
+  }
+  for (int j = 0; j < 2; ++j) {
+    const Blob<Dtype>& blob = *this->net_->blob_by_name(skipped[j]);
+    for (int i = 0; i < blob.count(); ++i) {
+      EXPECT_EQ(kUntouched, blob.cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardPrunedRunsDataLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'images' "
+      "  type: 'MemoryData' "
+      "  memory_data_param { batch_size: 2 channels: 3 height: 1 width: 1 } "
+      "  top: 'data' "
+      "  top: 'image_id' "
+      "} "
+      "layer { "
+      "  name: 'targets' "
+      "  type: 'MemoryData' "
+      "  memory_data_param { batch_size: 2 channels: 1 height: 1 width: 1 } "
+      "  top: 'target' "
+      "  top: 'target_id' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  // Two batches of images and of targets.
+  vector<Dtype> images(12), image_ids(4), targets(4), target_ids(4);
+  for (int i = 0; i < 12; ++i) {
+    images[i] = i;
+  }
+  for (int i = 0; i < 4; ++i) {
+    image_ids[i] = i;
+    targets[i] = 10 + i;
+    target_ids[i] = i;
+  }
+  shared_ptr<MemoryDataLayer<Dtype> > image_layer =
+      boost::static_pointer_cast<MemoryDataLayer<Dtype> >(
+          this->net_->layer_by_name("images"));
+  shared_ptr<MemoryDataLayer<Dtype> > target_layer =
+      boost::static_pointer_cast<MemoryDataLayer<Dtype> >(
+          this->net_->layer_by_name("targets"));
+  image_layer->Reset(images.data(), image_ids.data(), 4);
+  target_layer->Reset(targets.data(), target_ids.data(), 4);
+  // The targets advance with the images even though ip does not need them.
+  this->net_->ForwardPruned(vector<string>(1, "ip"));
+  this->net_->ForwardPrefilled();
+  const Blob<Dtype>& data = *this->net_->blob_by_name("data");
+  const Blob<Dtype>& target = *this->net_->blob_by_name("target");
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(images[6 + i], data.cpu_data()[i]);
+  }
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(targets[2 + i], target.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardSkipsUnchangedReshape) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "in_place_neurons: false "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 } "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'data' "
+      "  top: 'relu' "
+      "} "
+      "layer { "
+      "  name: 'sigmoid' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'data' "
+      "  top: 'sigmoid' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  Blob<Dtype>* data = this->net_->input_blobs()[0];
+  Blob<Dtype>* relu = this->net_->blob_by_name("relu").get();
+  Blob<Dtype>* sigmoid = this->net_->blob_by_name("sigmoid").get();
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(data);
+  this->net_->ForwardPrefilled();
+  // With the same bottoms, Forward leaves the shape of the tops alone.
+  relu->Reshape(4, 3, 1, 1);
+  this->net_->ForwardPrefilled();
+  EXPECT_EQ(4, relu->num());
+  // New memory under the split of data is shared with its tops again.
+  Blob<Dtype> other(data->shape());
+  caffe_set(other.count(), Dtype(1), other.mutable_cpu_data());
+  data->ShareData(other);
+  this->net_->ForwardPrefilled();
+  EXPECT_EQ(2, relu->num());
+  for (int i = 0; i < data->count(); ++i) {
+    EXPECT_EQ(1, relu->cpu_data()[i]);
+    EXPECT_NEAR(0.7310586, sigmoid->cpu_data()[i], 1e-6);
+  }
+  // A new input shape reshapes the layers.
+  data->Reshape(3, 3, 1, 1);
+  filler.Fill(data);
+  this->net_->ForwardPrefilled();
+  EXPECT_EQ(3, relu->num());
+  EXPECT_EQ(3, sigmoid->num());
+}
+
+TYPED_TEST(NetTest, TestReplicate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 5 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'conv2' "
+      "  top: 'ip' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  const int ip_owner = MemoryTracker::Owner("TestNetwork/ip");
+  MemoryTracker::ResetPeaks();
+  const size_t ip_bytes =
+      MemoryTracker::GetUsage(ip_owner, MemoryTracker::HOST).bytes;
+  shared_ptr<Net<Dtype> > replica = this->net_->Replicate();
+  // The replica has no weights of its own, and never allocated any.
+  ASSERT_EQ(this->net_->params().size(), replica->params().size());
+  for (int i = 0; i < replica->params().size(); ++i) {
+    EXPECT_EQ(this->net_->params()[i]->cpu_data(),
+        replica->params()[i]->cpu_data());
+  }
+  EXPECT_LT(MemoryTracker::GetUsage(ip_owner, MemoryTracker::HOST).peak_bytes,
+      ip_bytes + 5 * 4 * 8 * 8 * sizeof(Dtype));
+  // conv1 and conv2 share the arena; ip, the output, is kept apart.
+  EXPECT_EQ(0, this->net_->planned_memory());
+  EXPECT_EQ(2 * 2 * 4 * 8 * 8 * sizeof(Dtype), replica->planned_memory());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->net_->input_blobs()[0]);
+  replica->input_blobs()[0]->CopyFrom(*this->net_->input_blobs()[0]);
+  const Blob<Dtype>* expected = this->net_->ForwardPrefilled()[0];
+  const Blob<Dtype>* output = replica->ForwardPrefilled()[0];
+  ASSERT_EQ(expected->count(), output->count());
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_EQ(expected->cpu_data()[i], output->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestElideSplits) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "force_backward: true "
+      "state { phase: TRAIN } "
+      "input: 'data' "
+      "input_shape { dim: 4 dim: 5 } "
+      "input: 'target' "
+      "input_shape { dim: 4 dim: 2 } "
+      "layer { "
+      "  name: 'ip_a' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip_a' "
+      "} "
+      "layer { "
+      "  name: 'ip_b' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip_b' "
+      "} "
+      "layer { "
+      "  name: 'relu_b' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip_b' "
+      "  top: 'ip_b' "
+      "} "
+      "layer { "
+      "  name: 'ip_c' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip_c' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'ip_a' "
+      "  bottom: 'ip_b' "
+      "  bottom: 'ip_c' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'sum' "
+      "  bottom: 'target' "
+      "  top: 'loss' "
+      "} ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > split_net = this->net_;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(split_net->input_blobs()[0]);
+  filler.Fill(split_net->input_blobs()[1]);
+  const Dtype split_loss = split_net->ForwardBackward(vector<Blob<Dtype>*>());
+  // The three readers of data sum their gradients into its diff, also when
+  // they run on threads.
+  const char* options[] = { "elide_splits: true ",
+      "elide_splits: true layer_threads: 2 " };
+  for (int n = 0; n < 2; ++n) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitNetFromProtoString(options[n] + proto);
+    Net<Dtype>& net = *this->net_;
+    EXPECT_EQ(split_net->layers().size() - 1, net.layers().size());
+    EXPECT_FALSE(net.has_layer("data_input_0_split"));
+    net.input_blobs()[0]->CopyFrom(*split_net->input_blobs()[0]);
+    net.input_blobs()[1]->CopyFrom(*split_net->input_blobs()[1]);
+    for (int iter = 0; iter < 2; ++iter) {
+      net.ClearParamDiffs();
+      EXPECT_NEAR(split_loss, net.ForwardBackward(vector<Blob<Dtype>*>()),
+          1e-5);
+      const Blob<Dtype>& expected = *split_net->blob_by_name("data");
+      const Blob<Dtype>& diff = *net.blob_by_name("data");
+      for (int i = 0; i < diff.count(); ++i) {
+        EXPECT_NEAR(expected.cpu_diff()[i], diff.cpu_diff()[i], 1e-5);
+      }
+      ASSERT_EQ(split_net->learnable_params().size(),
+          net.learnable_params().size());
+      for (int j = 0; j < net.learnable_params().size(); ++j) {
+        const Blob<Dtype>& expected_param = *split_net->learnable_params()[j];
+        const Blob<Dtype>& param = *net.learnable_params()[j];
+        for (int i = 0; i < param.count(); ++i) {
+          EXPECT_NEAR(expected_param.cpu_diff()[i], param.cpu_diff()[i],
+              1e-5);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestMaxBatchSize) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 5 } "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip1' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'relu1' "
+      "  top: 'ip2' "
+      "} ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference = this->net_;
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(
+      "max_batch_size: 6 plan_memory: true " + proto);
+  Net<Dtype>& net = *this->net_;
+  // The blobs have the batch of the inputs, and the memory for 6.
+  EXPECT_EQ(2, net.input_blobs()[0]->shape(0));
+  EXPECT_EQ(2, net.blob_by_name("ip1")->shape(0));
+  EXPECT_EQ(2, net.output_blobs()[0]->shape(0));
+  vector<const Dtype*> memory;
+  for (int i = 0; i < net.blobs().size(); ++i) {
+    EXPECT_NE(SyncedMemory::UNINITIALIZED, net.blobs()[i]->data()->head());
+    memory.push_back(net.blobs()[i]->cpu_data());
+  }
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  const int batch_sizes[] = { 6, 3, 1, 4 };
+  for (int n = 0; n < 4; ++n) {
+    vector<int> shape(2, 5);
+    shape[0] = batch_sizes[n];
+    reference->input_blobs()[0]->Reshape(shape);
+    filler.Fill(reference->input_blobs()[0]);
+    net.input_blobs()[0]->CopyFrom(*reference->input_blobs()[0], false, true);
+    if (n % 2) {
+      net.Reshape();
+    }
+    const Blob<Dtype>& expected = *reference->ForwardPrefilled()[0];
+    const Blob<Dtype>& output = *net.ForwardPrefilled()[0];
+    ASSERT_TRUE(expected.shape() == output.shape());
+    for (int i = 0; i < output.count(); ++i) {
+      EXPECT_EQ(expected.cpu_data()[i], output.cpu_data()[i]);
+    }
+    for (int i = 0; i < net.blobs().size(); ++i) {
+      EXPECT_EQ(memory[i], net.blobs()[i]->cpu_data());
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardCache) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 5 } "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip1' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'relu1' "
+      "  top: 'ip2' "
+      "} ";
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(proto);
+  shared_ptr<Net<Dtype> > reference = this->net_;
+  Caffe::set_random_seed(this->seed_);
+  this->InitNetFromProtoString(
+      "cache_blob: 'relu1' cache_batches: 2 in_place_neurons: false " +
+      proto);
+  Net<Dtype>& net = *this->net_;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  vector<shared_ptr<Blob<Dtype> > > inputs;
+  vector<shared_ptr<Blob<Dtype> > > expected;
+  for (int n = 0; n < 3; ++n) {
+    inputs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(2, 5, 1, 1)));
+    filler.Fill(inputs[n].get());
+    reference->input_blobs()[0]->CopyFrom(*inputs[n], false, true);
+    expected.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    expected[n]->CopyFrom(*reference->ForwardPrefilled()[0], false, true);
+  }
+  // Without a bias, ip1 with zero weights makes the output zero (the bias
+  // of ip2). Two batches fit in the cache, so batch 0 is gone at the first
+  // repeat, and 2 after batch 0 comes back. Changing the weights of ip1
+  // empties it.
+  const int kZeroWeights = -1;
+  const int kClear = -2;
+  const int order[] = { 0, 1, 2, 2, 1, 0, kZeroWeights, 1, 1, kClear, 1 };
+  const bool hits[] = { false, false, false, true, true, false, false,
+      false, true, false, false };
+  const bool original[] = { true, true, true, true, true, true, true, false,
+      false, false, false };
+  const Dtype kUntouched = 42;
+  Blob<Dtype>* ip1 = net.blob_by_name("ip1").get();
+  for (int k = 0; k < 11; ++k) {
+    if (order[k] == kZeroWeights) {
+      Blob<Dtype>* weights = net.layer_by_name("ip1")->blobs()[0].get();
+      caffe_set(weights->count(), Dtype(0), weights->mutable_cpu_data());
+      continue;
+    }
+    if (order[k] == kClear) {
+      net.ClearForwardCache();
+      continue;
+    }
+    net.input_blobs()[0]->CopyFrom(*inputs[order[k]], false, true);
+    caffe_set(ip1->count(), kUntouched, ip1->mutable_cpu_data());
+    const Blob<Dtype>& output = *net.ForwardPrefilled()[0];
+    for (int i = 0; i < output.count(); ++i) {
+      EXPECT_EQ(original[k] ? expected[order[k]]->cpu_data()[i] : Dtype(0),
+          output.cpu_data()[i]);
+    }
+    // A hit skips ip1.
+    EXPECT_EQ(hits[k], ip1->cpu_data()[0] == kUntouched) << "at " << k;
+  }
+}
+
+TYPED_TEST(NetTest, TestForwardCacheKeyBlob) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "cache_blob: 'ip1' "
+      "cache_key_blob: 'id' "
+      "input: 'data' "
+      "input_shape { dim: 2 dim: 5 } "
+      "input: 'id' "
+      "input_shape { dim: 2 } "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'ip1' "
+      "  top: 'ip2' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  Net<Dtype>& net = *this->net_;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype>* data = net.input_blobs()[0];
+  Blob<Dtype>* id = net.input_blobs()[1];
+  caffe_set(id->count(), Dtype(7), id->mutable_cpu_data());
+  filler.Fill(data);
+  Blob<Dtype> expected;
+  const Blob<Dtype>& output = *net.blob_by_name("ip2");
+  net.ForwardPrefilled();
+  expected.CopyFrom(output, false, true);
+  // Only the id tells the batches apart.
+  filler.Fill(data);
+  net.ForwardPrefilled();
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], output.cpu_data()[i]);
+  }
+  caffe_set(id->count(), Dtype(8), id->mutable_cpu_data());
+  net.ForwardPrefilled();
+  bool recomputed = false;
+  for (int i = 0; i < output.count(); ++i) {
+    recomputed |= expected.cpu_data()[i] != output.cpu_data()[i];
+  }
+  EXPECT_TRUE(recomputed);
+}
+
+TYPED_TEST(NetTest, TestCompiled) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "input: 'data' "
+      "input_shape { dim: 4 dim: 5 } "
+      "layer { "
+      "  name: 'ip1' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } "
+      "    bias_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'ip1' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'ip2' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'relu1' "
+      "  top: 'ip2' "
+      "} "
+      "layer { "
+      "  name: 'ip3' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } "
+      "  bottom: 'data' "
+      "  top: 'ip3' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->net_->input_blobs()[0]);
+  this->net_->ForwardPrefilled();
+  NetParameter compiled_param;
+  this->net_->ToCompiledProto(&compiled_param);
+  EXPECT_TRUE(compiled_param.compiled());
+  string compiled_file;
+  MakeTempFilename(&compiled_file);
+  WriteProtoToBinaryFile(compiled_param, compiled_file);
+  NetParameter loaded_param;
+  ReadProtoFromMappedFileOrDie(compiled_file, &loaded_param);
+  // The loaded net is the one built, with the split of data, relu1 made in
+  // place and the same weights.
+  Net<Dtype> loaded(loaded_param);
+  ASSERT_EQ(this->net_->layers().size(), loaded.layers().size());
+  for (int i = 0; i < loaded.layers().size(); ++i) {
+    EXPECT_EQ(this->net_->layer_names()[i], loaded.layer_names()[i]);
+    // The weights are only in the blobs of the layers.
+    EXPECT_EQ(0, loaded.layers()[i]->layer_param().blobs_size());
+  }
+  loaded.input_blobs()[0]->CopyFrom(*this->net_->input_blobs()[0]);
+  loaded.ForwardPrefilled();
+  const char* outputs[] = { "ip2", "ip3" };
+  for (int j = 0; j < 2; ++j) {
+    const Blob<Dtype>& expected = *this->net_->blob_by_name(outputs[j]);
+    const Blob<Dtype>& result = *loaded.blob_by_name(outputs[j]);
+    ASSERT_TRUE(expected.shape() == result.shape());
+    for (int i = 0; i < result.count(); ++i) {
+      EXPECT_EQ(expected.cpu_data()[i], result.cpu_data()[i]);
+    }
+  }
+}
+
 }  // namespace caffe
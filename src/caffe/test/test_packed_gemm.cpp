@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/packed_gemm.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class PackedGemmTest : public ::testing::Test {
+ protected:
+  PackedGemmTest() {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+  }
+
+  virtual void TearDown() {
+    Caffe::set_cpu_gemm(Caffe::BLAS);
+  }
+
+  void Fill(const int count, Blob<Dtype>* blob) {
+    blob->Reshape(vector<int>(1, count));
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob);
+  }
+
+  // Naive C = alpha * op(A) * op(B) + beta * C.
+  void ReferenceGemm(const CBLAS_TRANSPOSE TransA,
+      const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+      const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
+      Dtype* C) {
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < N; ++j) {
+        double sum = 0;
+        for (int k = 0; k < K; ++k) {
+          const Dtype a =
+              (TransA == CblasNoTrans) ? A[i * K + k] : A[k * M + i];
+          const Dtype b =
+              (TransB == CblasNoTrans) ? B[k * N + j] : B[j * K + k];
+          sum += a * b;
+        }
+        C[i * N + j] = alpha * sum + beta * C[i * N + j];
+      }
+    }
+  }
+
+  void CheckGemm(const CBLAS_TRANSPOSE TransA, const CBLAS_TRANSPOSE TransB,
+      const int M, const int N, const int K, const Dtype alpha,
+      const Dtype beta) {
+    Blob<Dtype> A, B, C, expected;
+    this->Fill(M * K, &A);
+    this->Fill(K * N, &B);
+    this->Fill(M * N, &C);
+    expected.ReshapeLike(C);
+    caffe_copy(C.count(), C.cpu_data(), expected.mutable_cpu_data());
+    ReferenceGemm(TransA, TransB, M, N, K, alpha, A.cpu_data(), B.cpu_data(),
+        beta, expected.mutable_cpu_data());
+    caffe_cpu_packed_gemm<Dtype>(TransA, TransB, M, N, K, alpha, A.cpu_data(),
+        B.cpu_data(), beta, C.mutable_cpu_data());
+    const Dtype tolerance = 1e-4 * std::max(K, 1);
+    for (int i = 0; i < M * N; ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], C.cpu_data()[i], tolerance)
+          << "M " << M << " N " << N << " K " << K << " at " << i;
+    }
+  }
+};
+
+TYPED_TEST_CASE(PackedGemmTest, TestDtypes);
+
+TYPED_TEST(PackedGemmTest, TestGemmSmall) {
+  this->CheckGemm(CblasNoTrans, CblasNoTrans, 2, 3, 4, 1., 0.);
+  this->CheckGemm(CblasTrans, CblasNoTrans, 2, 3, 4, 1., 0.);
+  this->CheckGemm(CblasNoTrans, CblasTrans, 2, 3, 4, 1., 0.);
+  this->CheckGemm(CblasTrans, CblasTrans, 2, 3, 4, 1., 0.);
+}
+
+TYPED_TEST(PackedGemmTest, TestGemmBlockEdges) {
+  // Sizes straddling the register tile and cache block boundaries.
+  const int M[] = {1, 6, 7, 97, 200};
+  const int N[] = {1, 16, 17, 33};
+  const int K[] = {1, 5, 256, 300};
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      for (int k = 0; k < 4; ++k) {
+        this->CheckGemm(CblasNoTrans, CblasNoTrans, M[i], N[j], K[k], 1., 0.);
+        this->CheckGemm(CblasTrans, CblasTrans, M[i], N[j], K[k], 0.5, 2.);
+      }
+    }
+  }
+}
+
+TYPED_TEST(PackedGemmTest, TestGemmWideN) {
+  // Wider than one NC panel.
+  this->CheckGemm(CblasNoTrans, CblasNoTrans, 7, 2100, 9, 1., 1.);
+}
+
+TYPED_TEST(PackedGemmTest, TestGemmBetaZeroIgnoresC) {
+  typedef TypeParam Dtype;
+  const int M = 5, N = 19, K = 7;
+  Blob<Dtype> A, B;
+  this->Fill(M * K, &A);
+  this->Fill(K * N, &B);
+  vector<Dtype> C(M * N, std::numeric_limits<Dtype>::quiet_NaN());
+  vector<Dtype> expected(M * N, 0);
+  this->ReferenceGemm(CblasNoTrans, CblasNoTrans, M, N, K, Dtype(1),
+      A.cpu_data(), B.cpu_data(), Dtype(0), &expected[0]);
+  caffe_cpu_packed_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, N, K, Dtype(1),
+      A.cpu_data(), B.cpu_data(), Dtype(0), &C[0]);
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(expected[i], C[i], 1e-4);
+  }
+}
+
+TYPED_TEST(PackedGemmTest, TestPrePacked) {
+  typedef TypeParam Dtype;
+  const int M = 13, N = 37, K = 270;
+  Blob<Dtype> A, B, expected;
+  this->Fill(M * K, &A);
+  this->Fill(K * N, &B);
+  vector<int> shape(1, M * N);
+  expected.Reshape(shape);
+  Blob<Dtype> left(shape), right(shape);
+  this->ReferenceGemm(CblasTrans, CblasNoTrans, M, N, K, Dtype(1),
+      A.cpu_data(), B.cpu_data(), Dtype(0), expected.mutable_cpu_data());
+  PackedMatrix<Dtype> packed_a;
+  packed_a.PackLeft(CblasTrans, M, K, A.cpu_data());
+  caffe_cpu_packed_gemm<Dtype>(packed_a, CblasNoTrans, N, Dtype(1),
+      B.cpu_data(), Dtype(0), left.mutable_cpu_data());
+  PackedMatrix<Dtype> packed_b;
+  packed_b.PackRight(CblasNoTrans, K, N, B.cpu_data());
+  caffe_cpu_packed_gemm<Dtype>(CblasTrans, M, Dtype(1), A.cpu_data(),
+      packed_b, Dtype(0), right.mutable_cpu_data());
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], left.cpu_data()[i], 1e-2);
+    EXPECT_NEAR(expected.cpu_data()[i], right.cpu_data()[i], 1e-2);
+  }
+}
+
+TYPED_TEST(PackedGemmTest, TestRepackOnWrite) {
+  typedef TypeParam Dtype;
+  const int M = 3, N = 4, K = 2;
+  Blob<Dtype> A, B;
+  this->Fill(M * K, &A);
+  this->Fill(K * N, &B);
+  vector<Dtype> C(M * N), expected(M * N);
+  PackedMatrix<Dtype> packed_b;
+  packed_b.PackRight(CblasNoTrans, K, N, B.data(), 0);
+  // Writing to the source invalidates the packed copy.
+  caffe_scal(B.count(), Dtype(2), B.mutable_cpu_data());
+  packed_b.PackRight(CblasNoTrans, K, N, B.data(), 0);
+  caffe_cpu_packed_gemm<Dtype>(CblasNoTrans, M, Dtype(1), A.cpu_data(),
+      packed_b, Dtype(0), &C[0]);
+  this->ReferenceGemm(CblasNoTrans, CblasNoTrans, M, N, K, Dtype(1),
+      A.cpu_data(), B.cpu_data(), Dtype(0), &expected[0]);
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(expected[i], C[i], 1e-4);
+  }
+}
+
+TYPED_TEST(PackedGemmTest, TestBackendDispatch) {
+  typedef TypeParam Dtype;
+  const int M = 9, N = 11, K = 23;
+  Blob<Dtype> A, B;
+  this->Fill(M * K, &A);
+  this->Fill(K * N, &B);
+  vector<Dtype> blas(M * N, 1), packed(M * N, 1);
+  Caffe::set_cpu_gemm(Caffe::BLAS);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, N, K, Dtype(1),
+      A.cpu_data(), B.cpu_data(), Dtype(1), &blas[0]);
+  Caffe::set_cpu_gemm(Caffe::PACKED);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, N, K, Dtype(1),
+      A.cpu_data(), B.cpu_data(), Dtype(1), &packed[0]);
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(blas[i], packed[i], 1e-4);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,113 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/sparse_gemm.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class SparseGemmTest : public ::testing::Test {
+ protected:
+  SparseGemmTest() {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+  }
+
+  // Fills blob with gaussian values and zeroes about sparsity of them.
+  void FillPruned(const int count, const float sparsity, Blob<Dtype>* blob) {
+    blob->Reshape(vector<int>(1, count));
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob);
+    Dtype* data = blob->mutable_cpu_data();
+    for (int i = 0; i < count; ++i) {
+      if (caffe_rng_rand() % 100 < sparsity * 100) {
+        data[i] = 0;
+      }
+    }
+  }
+};
+
+TYPED_TEST_CASE(SparseGemmTest, TestDtypes);
+
+TYPED_TEST(SparseGemmTest, TestFromDense) {
+  typedef TypeParam Dtype;
+  const Dtype dense[] = {0, 1, 0, 2, 0, 0, 3, 0, 4};
+  SparseMatrix<Dtype> A;
+  A.FromDense(3, 3, dense);
+  EXPECT_TRUE(A.is_sparse());
+  EXPECT_EQ(4, A.nnz());
+  EXPECT_NEAR(5. / 9., A.sparsity(), 1e-6);
+  const int row_ptr[] = {0, 1, 2, 4};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(row_ptr[i], A.row_ptr()[i]);
+  }
+  const int col_ind[] = {1, 0, 0, 2};
+  const Dtype values[] = {1, 2, 3, 4};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(col_ind[i], A.col_ind()[i]);
+    EXPECT_EQ(values[i], A.values()[i]);
+  }
+}
+
+TYPED_TEST(SparseGemmTest, TestThreshold) {
+  typedef TypeParam Dtype;
+  Blob<Dtype> W;
+  this->FillPruned(40 * 30, 0.5, &W);
+  SparseMatrix<Dtype> A;
+  A.FromDense(40, 30, W.data(), 0, 0.99);
+  EXPECT_FALSE(A.is_sparse());
+  A.FromDense(40, 30, W.data(), 0, 0.1);
+  EXPECT_TRUE(A.is_sparse());
+  // Writing to the weights triggers a new conversion.
+  caffe_set(W.count(), Dtype(1), W.mutable_cpu_data());
+  A.FromDense(40, 30, W.data(), 0, 0.1);
+  EXPECT_FALSE(A.is_sparse());
+  EXPECT_EQ(W.count(), A.nnz());
+}
+
+TYPED_TEST(SparseGemmTest, TestCsrmm) {
+  typedef TypeParam Dtype;
+  const int M = 17, N = 23, K = 31;
+  Blob<Dtype> A, B;
+  this->FillPruned(M * K, 0.8, &A);
+  this->FillPruned(K * N, 0, &B);
+  vector<Dtype> C(M * N, 2), expected(M * N, 2);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, N, K, Dtype(0.5),
+      A.cpu_data(), B.cpu_data(), Dtype(3), &expected[0]);
+  SparseMatrix<Dtype> sparse_A;
+  sparse_A.FromDense(M, K, A.cpu_data());
+  caffe_cpu_csrmm<Dtype>(sparse_A, N, Dtype(0.5), B.cpu_data(), Dtype(3),
+      &C[0]);
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(expected[i], C[i], 1e-4);
+  }
+}
+
+TYPED_TEST(SparseGemmTest, TestGemmCsrt) {
+  typedef TypeParam Dtype;
+  const int M = 7, N = 19, K = 43;
+  Blob<Dtype> A, B;
+  this->FillPruned(M * K, 0, &A);
+  this->FillPruned(N * K, 0.9, &B);
+  vector<Dtype> C(M * N, 1), expected(M * N, 1);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, N, K, Dtype(1),
+      A.cpu_data(), B.cpu_data(), Dtype(0), &expected[0]);
+  SparseMatrix<Dtype> sparse_B;
+  sparse_B.FromDense(N, K, B.cpu_data());
+  caffe_cpu_gemm_csrt<Dtype>(M, Dtype(1), A.cpu_data(), sparse_B, Dtype(0),
+      &C[0]);
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(expected[i], C[i], 1e-4);
+  }
+}
+
+}  // namespace caffe
@@ -63,6 +63,22 @@ TYPED_TEST(SplitLayerTest, TestSetup) {
   EXPECT_EQ(this->blob_top_b_->width(), 5);
 }
 
+TYPED_TEST(SplitLayerTest, TestSetupBeyondInt32) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Shaping alone does not allocate, so this takes no memory.
+  vector<int> shape(3);
+  shape[0] = 3;
+  shape[1] = 1 << 20;
+  shape[2] = 1 << 10;
+  Blob<Dtype> bottom(shape);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  LayerParameter layer_param;
+  SplitLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  EXPECT_EQ(int64_t(3) << 30, this->blob_top_a_->count());
+  EXPECT_EQ(int64_t(3) << 30, this->blob_top_b_->count());
+}
+
 TYPED_TEST(SplitLayerTest, Test) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -1042,4 +1058,95 @@ TEST_F(SplitLayerInsertionTest, TestWithInPlace) {
   this->RunInsertionTest(input_proto, expected_output_proto);
 }
 
+TEST_F(SplitLayerInsertionTest, TestElideSplits) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'innerprod1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'innerprod1' "
+      "  top: 'innerprod1' "
+      "} "
+      "layer { "
+      "  name: 'innerprod2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'innerprod1' "
+      "  top: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'loss1' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'innerprod1' "
+      "  bottom: 'label' "
+      "} "
+      "layer { "
+      "  name: 'loss2' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'innerprod2' "
+      "  bottom: 'data' "
+      "} ";
+  NetParameter input_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      input_proto, &input_param));
+  NetParameter split_param;
+  InsertSplits(input_param, &split_param);
+  // Both splits go, and the layers read data and innerprod1 again.
+  NetParameter elided_param;
+  EXPECT_EQ(2, ElideSplits(split_param, &elided_param));
+  EXPECT_EQ(input_param.DebugString(), elided_param.DebugString());
+}
+
+TEST_F(SplitLayerInsertionTest, TestElideSplitsKept) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'square' "
+      "  type: 'Eltwise' "
+      "  eltwise_param { operation: PROD } "
+      "  bottom: 'data' "
+      "  bottom: 'data' "
+      "  top: 'square' "
+      "} "
+      "layer { "
+      "  name: 'innerprod' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'square' "
+      "  top: 'innerprod' "
+      "  loss_weight: 0.5 "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'innerprod' "
+      "  bottom: 'label' "
+      "} ";
+  NetParameter input_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      input_proto, &input_param));
+  NetParameter split_param;
+  InsertSplits(input_param, &split_param);
+  // square reads data twice, and innerprod is also a loss.
+  NetParameter elided_param;
+  EXPECT_EQ(0, ElideSplits(split_param, &elided_param));
+  EXPECT_EQ(split_param.DebugString(), elided_param.DebugString());
+}
+
 }  // namespace caffe
@@ -68,6 +68,21 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+TEST_F(SyncedMemoryTest, TestVersion) {
+  SyncedMemory mem(10);
+  const unsigned int initial = mem.version();
+  EXPECT_TRUE(mem.cpu_data());
+  EXPECT_EQ(mem.version(), initial);
+  mem.mutable_cpu_data();
+  const unsigned int written = mem.version();
+  EXPECT_NE(written, initial);
+  EXPECT_TRUE(mem.cpu_data());
+  EXPECT_EQ(mem.version(), written);
+  char data[10];
+  mem.set_cpu_data(data);
+  EXPECT_NE(mem.version(), written);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
@@ -0,0 +1,55 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ public:
+  ThreadPoolTest() : count_(0) {}
+
+  void Count() {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++count_;
+  }
+
+  // Counts itself and submits two tasks that count themselves.
+  void Spawn(ThreadPool* pool) {
+    Count();
+    pool->Submit(boost::bind(&ThreadPoolTest::Count, this));
+    pool->Submit(boost::bind(&ThreadPoolTest::Count, this));
+  }
+
+ protected:
+  boost::mutex mutex_;
+  int count_;
+};
+
+TEST_F(ThreadPoolTest, TestRunsAllTasks) {
+  {
+    ThreadPool pool(4);
+    EXPECT_EQ(4, pool.num_threads());
+    for (int i = 0; i < 100; ++i) {
+      pool.Submit(boost::bind(&ThreadPoolTest::Count, this));
+    }
+  }
+  EXPECT_EQ(100, count_);
+}
+
+TEST_F(ThreadPoolTest, TestTasksSubmitTasks) {
+  {
+    ThreadPool pool(3);
+    for (int i = 0; i < 50; ++i) {
+      pool.Submit(boost::bind(&ThreadPoolTest::Spawn, this, &pool));
+    }
+  }
+  EXPECT_EQ(150, count_);
+}
+
+}  // namespace caffe
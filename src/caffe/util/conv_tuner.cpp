@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/filler.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/conv_tuner.hpp"
+
+namespace caffe {
+
+// Candidate names double as the values stored in the cache file.
+const char* const kTunerFFT = "FFT";
+
+template <typename Dtype>
+ConvolutionTuner<Dtype>::ConvolutionTuner(const string& cache_file)
+    : cache_file_(cache_file) {
+  Load();
+}
+
+template <typename Dtype>
+string ConvolutionTuner<Dtype>::CpuModel() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      const size_t colon = line.find(':');
+      if (colon != string::npos) {
+        const size_t begin = line.find_first_not_of(" \t", colon + 1);
+        if (begin != string::npos) {
+          return line.substr(begin);
+        }
+      }
+    }
+  }
+  return "unknown";
+}
+
+template <typename Dtype>
+string ConvolutionTuner<Dtype>::Key(const vector<int>& bottom_shape,
+    const ConvolutionParameter& conv_param) {
+  // Only the geometry matters, not the fillers or the current choice.
+  ConvolutionParameter geometry(conv_param);
+  geometry.clear_weight_filler();
+  geometry.clear_bias_filler();
+  geometry.clear_engine();
+  geometry.clear_cpu_algorithm();
+  geometry.clear_sparse_threshold();
+  ostringstream key;
+  key << CpuModel() << "|" << (sizeof(Dtype) == sizeof(float) ? "float" :
+      "double") << "|";
+  for (int i = 0; i < bottom_shape.size(); ++i) {
+    key << (i ? "x" : "") << bottom_shape[i];
+  }
+  key << "|" << geometry.ShortDebugString();
+  return key.str();
+}
+
+template <typename Dtype>
+void ConvolutionTuner<Dtype>::Tune(const vector<int>& bottom_shape,
+    LayerParameter* param) {
+  CHECK_EQ(param->type(), "Convolution");
+  ConvolutionParameter* conv_param = param->mutable_convolution_param();
+  const string key = Key(bottom_shape, *conv_param);
+  map<string, string>::const_iterator cached = choices_.find(key);
+  const bool from_cache = (cached != choices_.end());
+  string choice;
+  if (from_cache) {
+    choice = cached->second;
+  } else {
+    int axis = conv_param->axis();
+    if (axis < 0) {
+      axis += bottom_shape.size();
+    }
+    const bool is_2d = bottom_shape.size() - axis - 1 == 2 &&
+        !conv_param->force_nd_im2col();
+    vector<string> candidates;
+    candidates.push_back(ConvolutionParameter_CpuAlgorithm_Name(
+        ConvolutionParameter_CpuAlgorithm_GEMM));
+    candidates.push_back(ConvolutionParameter_CpuAlgorithm_Name(
+        ConvolutionParameter_CpuAlgorithm_PACKED_GEMM));
+    if (is_2d) {
+      candidates.push_back(ConvolutionParameter_CpuAlgorithm_Name(
+          ConvolutionParameter_CpuAlgorithm_DIRECT));
+      candidates.push_back(kTunerFFT);
+    }
+    Blob<Dtype> bottom(bottom_shape);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&bottom);
+    float best_time = 0;
+    for (int i = 0; i < candidates.size(); ++i) {
+      LayerParameter trial(*param);
+      trial.clear_bottom();
+      trial.clear_top();
+      ConvolutionParameter* trial_conv = trial.mutable_convolution_param();
+      trial_conv->clear_sparse_threshold();
+      if (candidates[i] == kTunerFFT) {
+        trial_conv->set_engine(ConvolutionParameter_Engine_FFT);
+        trial_conv->clear_cpu_algorithm();
+      } else {
+        ConvolutionParameter_CpuAlgorithm algorithm;
+        CHECK(ConvolutionParameter_CpuAlgorithm_Parse(candidates[i],
+            &algorithm));
+        trial_conv->set_engine(ConvolutionParameter_Engine_CAFFE);
+        trial_conv->set_cpu_algorithm(algorithm);
+      }
+      const float time = TimeForward(trial, &bottom);
+      LOG(INFO) << "Tuning " << param->name() << ": " << candidates[i]
+          << " takes " << time << " ms.";
+      if (choice.empty() || time < best_time) {
+        choice = candidates[i];
+        best_time = time;
+      }
+    }
+    choices_[key] = choice;
+    Save();
+  }
+  LOG(INFO) << "Convolution " << param->name() << " uses " << choice
+      << (from_cache ? " (cached)." : ".");
+  if (choice == kTunerFFT) {
+    conv_param->set_engine(ConvolutionParameter_Engine_FFT);
+    conv_param->clear_cpu_algorithm();
+  } else {
+    ConvolutionParameter_CpuAlgorithm algorithm;
+    CHECK(ConvolutionParameter_CpuAlgorithm_Parse(choice, &algorithm))
+        << "Unknown algorithm " << choice << " in " << cache_file_;
+    conv_param->set_engine(ConvolutionParameter_Engine_CAFFE);
+    conv_param->set_cpu_algorithm(algorithm);
+  }
+}
+
+template <typename Dtype>
+float ConvolutionTuner<Dtype>::TimeForward(const LayerParameter& param,
+    Blob<Dtype>* bottom) {
+  shared_ptr<Layer<Dtype> > layer = LayerRegistry<Dtype>::CreateLayer(param);
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> bottom_vec(1, bottom);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  layer->SetUp(bottom_vec, top_vec);
+  // The first pass allocates buffers and fills the weight caches.
+  layer->Forward(bottom_vec, top_vec);
+  const int kRuns = 3;
+  float best = 0;
+  Timer timer;
+  for (int i = 0; i < kRuns; ++i) {
+    timer.Start();
+    layer->Forward(bottom_vec, top_vec);
+    const float time = timer.MilliSeconds();
+    best = (i == 0) ? time : std::min(best, time);
+  }
+  return best;
+}
+
+template <typename Dtype>
+void ConvolutionTuner<Dtype>::Load() {
+  if (cache_file_.empty()) {
+    return;
+  }
+  std::ifstream file(cache_file_.c_str());
+  string line;
+  while (std::getline(file, line)) {
+    const size_t tab = line.rfind('\t');
+    if (tab != string::npos) {
+      choices_[line.substr(0, tab)] = line.substr(tab + 1);
+    }
+  }
+  LOG(INFO) << "Loaded " << choices_.size() << " tuned convolutions from "
+      << cache_file_;
+}
+
+template <typename Dtype>
+void ConvolutionTuner<Dtype>::Save() {
+  if (cache_file_.empty()) {
+    return;
+  }
+  std::ofstream file(cache_file_.c_str());
+  for (map<string, string>::const_iterator it = choices_.begin();
+       it != choices_.end(); ++it) {
+    file << it->first << "\t" << it->second << "\n";
+  }
+  LOG_IF(WARNING, !file) << "Failed to write the tuning cache "
+      << cache_file_;
+}
+
+INSTANTIATE_CLASS(ConvolutionTuner);
+
+}  // namespace caffe
@@ -0,0 +1,93 @@
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fft.hpp"
+
+namespace caffe {
+
+int fft_size(const int n) {
+  int size = 1;
+  while (size < n) {
+    size <<= 1;
+  }
+  return size;
+}
+
+template <typename Dtype>
+FFTPlan<Dtype>::FFTPlan(const int n)
+    : n_(n), bit_reverse_(n), twiddle_(n / 2), column_(n) {
+  CHECK_GT(n, 0);
+  CHECK_EQ(n & (n - 1), 0) << "FFT size must be a power of two.";
+  int log_n = 0;
+  while ((1 << log_n) < n) {
+    ++log_n;
+  }
+  for (int i = 0; i < n; ++i) {
+    int reversed = 0;
+    for (int b = 0; b < log_n; ++b) {
+      reversed |= ((i >> b) & 1) << (log_n - 1 - b);
+    }
+    bit_reverse_[i] = reversed;
+  }
+  for (int k = 0; k < n / 2; ++k) {
+    const double angle = -2. * M_PI * k / n;
+    twiddle_[k] = std::complex<Dtype>(cos(angle), sin(angle));
+  }
+}
+
+// Iterative Cooley-Tukey. The butterflies are spelled out on real and
+// imaginary parts because std::complex multiplication checks for infinities
+// and NaNs on every product.
+template <typename Dtype>
+void FFTPlan<Dtype>::Transform(std::complex<Dtype>* data,
+    const bool inverse) const {
+  for (int i = 0; i < n_; ++i) {
+    const int j = bit_reverse_[i];
+    if (i < j) {
+      std::swap(data[i], data[j]);
+    }
+  }
+  const Dtype sign = inverse ? -1 : 1;
+  for (int len = 2; len <= n_; len <<= 1) {
+    const int half = len / 2;
+    const int step = n_ / len;
+    for (int i = 0; i < n_; i += len) {
+      for (int k = 0; k < half; ++k) {
+        const Dtype w_re = twiddle_[k * step].real();
+        const Dtype w_im = sign * twiddle_[k * step].imag();
+        std::complex<Dtype>& a = data[i + k];
+        std::complex<Dtype>& b = data[i + k + half];
+        const Dtype v_re = b.real() * w_re - b.imag() * w_im;
+        const Dtype v_im = b.real() * w_im + b.imag() * w_re;
+        const Dtype u_re = a.real();
+        const Dtype u_im = a.imag();
+        a = std::complex<Dtype>(u_re + v_re, u_im + v_im);
+        b = std::complex<Dtype>(u_re - v_re, u_im - v_im);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void FFTPlan<Dtype>::Transform2D(std::complex<Dtype>* data,
+    const bool inverse) const {
+  for (int row = 0; row < n_; ++row) {
+    Transform(data + row * n_, inverse);
+  }
+  std::complex<Dtype>* column = &column_[0];
+  for (int col = 0; col < n_; ++col) {
+    for (int row = 0; row < n_; ++row) {
+      column[row] = data[row * n_ + col];
+    }
+    Transform(column, inverse);
+    for (int row = 0; row < n_; ++row) {
+      data[row * n_ + col] = column[row];
+    }
+  }
+}
+
+INSTANTIATE_CLASS(FFTPlan);
+
+}  // namespace caffe
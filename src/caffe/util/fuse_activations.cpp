@@ -0,0 +1,219 @@
+#include <set>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fuse_activations.hpp"
+
+namespace caffe {
+
+static bool HasBlob(const google::protobuf::RepeatedPtrField<string>& blobs,
+    const string& blob_name) {
+  for (int i = 0; i < blobs.size(); ++i) {
+    if (blobs.Get(i) == blob_name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool Mentions(const LayerParameter& layer, const string& blob_name) {
+  return HasBlob(layer.bottom(), blob_name) || HasBlob(layer.top(), blob_name);
+}
+
+// The ReLU parameters that the layer already applies to its output, if it
+// is a layer that can apply one.
+static ReLUParameter* FusedReLU(LayerParameter* layer) {
+  if (layer->type() == "Convolution" &&
+      !layer->convolution_param().has_relu_param()) {
+    return layer->mutable_convolution_param()->mutable_relu_param();
+  }
+  if (layer->type() == "InnerProduct" &&
+      !layer->inner_product_param().has_relu_param()) {
+    return layer->mutable_inner_product_param()->mutable_relu_param();
+  }
+  return NULL;
+}
+
+// The index of the layer that reads the single top of the producer, if that
+// layer can be folded into it: it is the next layer to touch the top and has
+// a single bottom and top. If it runs out of place, the producer takes over
+// its top, so nothing else may read the producer's own top, and its top must
+// be new. Returns -1 otherwise.
+static int FoldableConsumer(const NetParameter& param, const int producer,
+    const std::set<string>& preserved) {
+  const string& top_name = param.layer(producer).top(0);
+  int consumer = producer + 1;
+  while (consumer < param.layer_size() &&
+      !Mentions(param.layer(consumer), top_name)) {
+    ++consumer;
+  }
+  if (consumer == param.layer_size()) {
+    return -1;
+  }
+  const LayerParameter& layer = param.layer(consumer);
+  if (layer.bottom_size() != 1 || layer.top_size() != 1 ||
+      layer.bottom(0) != top_name || layer.loss_weight_size() > 0) {
+    return -1;
+  }
+  const string& consumer_top = layer.top(0);
+  if (consumer_top != top_name) {
+    bool safe = !preserved.count(top_name);
+    for (int j = consumer + 1; safe && j < param.layer_size(); ++j) {
+      safe = !Mentions(param.layer(j), top_name);
+    }
+    for (int j = 0; safe && j < consumer; ++j) {
+      safe = !Mentions(param.layer(j), consumer_top);
+    }
+    if (!safe) {
+      return -1;
+    }
+  }
+  return consumer;
+}
+
+// Remove the consumer, which the producer has absorbed, from the net.
+static void RemoveFolded(const int producer, const int consumer,
+    NetParameter* param) {
+  const LayerParameter& layer = param->layer(consumer);
+  *param->mutable_layer(producer)->mutable_top(0) = layer.top(0);
+  LOG_IF(INFO, Caffe::root_solver()) << "Folding " << layer.name()
+      << " into " << param->layer(producer).name() << " (top "
+      << layer.top(0) << ")";
+  param->mutable_layer()->DeleteSubrange(consumer, 1);
+}
+
+static bool IsFoldTarget(const LayerParameter& layer) {
+  return (layer.type() == "Convolution" || layer.type() == "InnerProduct") &&
+      layer.top_size() == 1 && layer.loss_weight_size() == 0;
+}
+
+int FuseActivations(const NetParameter& param, NetParameter* param_fused) {
+  param_fused->CopyFrom(param);
+  const std::set<string> preserved(param.preserve_blob().begin(),
+      param.preserve_blob().end());
+  int folded = 0;
+  for (int i = 0; i < param_fused->layer_size(); ++i) {
+    if (!IsFoldTarget(param_fused->layer(i))) {
+      continue;
+    }
+    const int relu = FoldableConsumer(*param_fused, i, preserved);
+    // The layers take the ReLU's gradient from its output, which tells
+    // the sign of its input only for a slope of at least 0.
+    if (relu < 0 || param_fused->layer(relu).type() != "ReLU" ||
+        param_fused->layer(relu).relu_param().negative_slope() < 0) {
+      continue;
+    }
+    ReLUParameter* relu_param = FusedReLU(param_fused->mutable_layer(i));
+    if (!relu_param) {
+      continue;
+    }
+    relu_param->CopyFrom(param_fused->layer(relu).relu_param());
+    RemoveFolded(i, relu, param_fused);
+    ++folded;
+  }
+  return folded;
+}
+
+// Multiply each value of the blob by scale and add shift.
+static void ScaleShift(const float scale, const float shift, BlobProto* blob) {
+  for (int i = 0; i < blob->data_size(); ++i) {
+    blob->set_data(i, scale * blob->data(i) + shift);
+  }
+  for (int i = 0; i < blob->double_data_size(); ++i) {
+    blob->set_double_data(i, scale * blob->double_data(i) + shift);
+  }
+  blob->clear_diff();
+  blob->clear_double_diff();
+}
+
+// Fold y = scale * x + shift into the weights and bias of the producer,
+// adding a bias if it has none.
+static void FoldAffine(const float scale, const float shift,
+    LayerParameter* producer) {
+  const bool conv = producer->type() == "Convolution";
+  ScaleShift(scale, 0, producer->mutable_blobs(0));
+  if (producer->blobs_size() == 1) {
+    if (shift == 0) {
+      return;
+    }
+    const int num_output = conv ?
+        producer->convolution_param().num_output() :
+        producer->inner_product_param().num_output();
+    const bool double_data = producer->blobs(0).double_data_size() > 0;
+    BlobProto* bias = producer->add_blobs();
+    bias->mutable_shape()->add_dim(num_output);
+    for (int i = 0; i < num_output; ++i) {
+      if (double_data) {
+        bias->add_double_data(0);
+      } else {
+        bias->add_data(0);
+      }
+    }
+    if (conv) {
+      producer->mutable_convolution_param()->set_bias_term(true);
+    } else {
+      producer->mutable_inner_product_param()->set_bias_term(true);
+    }
+  }
+  ScaleShift(scale, shift, producer->mutable_blobs(1));
+}
+
+// Whether the weights of the producer can be rewritten: they are loaded,
+// not shared with other layers, and nothing is applied after the bias.
+static bool WeightsFoldable(const LayerParameter& layer) {
+  const bool conv = layer.type() == "Convolution";
+  const bool bias_term = conv ? layer.convolution_param().bias_term() :
+      layer.inner_product_param().bias_term();
+  const bool relu = conv ? layer.convolution_param().has_relu_param() :
+      layer.inner_product_param().has_relu_param();
+  if (layer.blobs_size() != 1 + bias_term || relu) {
+    return false;
+  }
+  for (int i = 0; i < layer.param_size(); ++i) {
+    if (layer.param(i).name() != "") {
+      return false;
+    }
+  }
+  return true;
+}
+
+int FoldAffineLayers(const NetParameter& param, NetParameter* param_folded) {
+  param_folded->CopyFrom(param);
+  const std::set<string> preserved(param.preserve_blob().begin(),
+      param.preserve_blob().end());
+  int folded = 0;
+  for (int i = 0; i < param_folded->layer_size(); ++i) {
+    if (!IsFoldTarget(param_folded->layer(i))) {
+      continue;
+    }
+    if (param_folded->layer(i).blobs_size() == 0) {
+      const int power = FoldableConsumer(*param_folded, i, preserved);
+      LOG_IF(WARNING, power >= 0 &&
+          param_folded->layer(power).type() == "Power" &&
+          param_folded->layer(power).power_param().power() == 1)
+          << "Not folding " << param_folded->layer(power).name() << " into "
+          << param_folded->layer(i).name() << ", which has no weights in "
+          << "the definition.";
+      continue;
+    }
+    if (!WeightsFoldable(param_folded->layer(i))) {
+      continue;
+    }
+    // Absorb a chain of Power layers with power 1, which compute
+    // y = shift + scale * x, one at a time.
+    for (int power = FoldableConsumer(*param_folded, i, preserved);
+        power >= 0 && param_folded->layer(power).type() == "Power" &&
+        param_folded->layer(power).power_param().power() == 1;
+        power = FoldableConsumer(*param_folded, i, preserved)) {
+      const PowerParameter& power_param =
+          param_folded->layer(power).power_param();
+      FoldAffine(power_param.scale(), power_param.shift(),
+          param_folded->mutable_layer(i));
+      RemoveFolded(i, power, param_folded);
+      ++folded;
+    }
+  }
+  return folded;
+}
+
+}  // namespace caffe
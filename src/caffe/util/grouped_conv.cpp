@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cstring>
+
+#include "caffe/common.hpp"
+#include "caffe/util/grouped_conv.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// The output positions [*begin, *end) along one axis whose input position
+// out * stride - pad + offset falls inside [0, size).
+inline void valid_output_range(const int offset, const int pad,
+    const int stride, const int size, const int size_out, int* begin,
+    int* end) {
+  const int lo = pad - offset;
+  *begin = lo > 0 ? (lo + stride - 1) / stride : 0;
+  const int hi = size - 1 + pad - offset;
+  *end = hi < 0 ? 0 : std::min(size_out, hi / stride + 1);
+  *begin = std::min(*begin, *end);
+}
+
+template <typename Dtype>
+void grouped_conv_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, Dtype* data_out) {
+  const int height_out = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+  const int width_out = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+  const int channels_per_group = channels / group;
+  const int outputs_per_group = num_output / group;
+  caffe_set(num_output * height_out * width_out, Dtype(0), data_out);
+  for (int o = 0; o < num_output; ++o) {
+    Dtype* out = data_out + o * height_out * width_out;
+    const int g = o / outputs_per_group;
+    for (int i = 0; i < channels_per_group; ++i) {
+      const Dtype* im = data_im + (g * channels_per_group + i) * height * width;
+      const Dtype* w = weights + (o * channels_per_group + i) * kernel_h *
+          kernel_w;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int h_begin, h_end;
+        valid_output_range(kh, pad_h, stride_h, height, height_out, &h_begin,
+            &h_end);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          int w_begin, w_end;
+          valid_output_range(kw, pad_w, stride_w, width, width_out, &w_begin,
+              &w_end);
+          const Dtype tap = w[kh * kernel_w + kw];
+          for (int h = h_begin; h < h_end; ++h) {
+            const Dtype* im_row = im + (h * stride_h - pad_h + kh) * width -
+                pad_w + kw;
+            Dtype* out_row = out + h * width_out;
+            for (int x = w_begin; x < w_end; ++x) {
+              out_row[x] += tap * im_row[x * stride_w];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void grouped_conv_backward_data_cpu(const Dtype* data_out, const int channels,
+    const int height, const int width, const Dtype* weights,
+    const int num_output, const int group, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, Dtype* data_im) {
+  const int height_out = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+  const int width_out = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+  const int channels_per_group = channels / group;
+  const int outputs_per_group = num_output / group;
+  caffe_set(channels * height * width, Dtype(0), data_im);
+  for (int o = 0; o < num_output; ++o) {
+    const Dtype* out = data_out + o * height_out * width_out;
+    const int g = o / outputs_per_group;
+    for (int i = 0; i < channels_per_group; ++i) {
+      Dtype* im = data_im + (g * channels_per_group + i) * height * width;
+      const Dtype* w = weights + (o * channels_per_group + i) * kernel_h *
+          kernel_w;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int h_begin, h_end;
+        valid_output_range(kh, pad_h, stride_h, height, height_out, &h_begin,
+            &h_end);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          int w_begin, w_end;
+          valid_output_range(kw, pad_w, stride_w, width, width_out, &w_begin,
+              &w_end);
+          const Dtype tap = w[kh * kernel_w + kw];
+          for (int h = h_begin; h < h_end; ++h) {
+            Dtype* im_row = im + (h * stride_h - pad_h + kh) * width -
+                pad_w + kw;
+            const Dtype* out_row = out + h * width_out;
+            for (int x = w_begin; x < w_end; ++x) {
+              im_row[x * stride_w] += tap * out_row[x];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void grouped_conv_backward_weight_cpu(const Dtype* data_im,
+    const int channels, const int height, const int width,
+    const Dtype* data_out, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, Dtype* weights_diff) {
+  const int height_out = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+  const int width_out = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+  const int channels_per_group = channels / group;
+  const int outputs_per_group = num_output / group;
+  for (int o = 0; o < num_output; ++o) {
+    const Dtype* out = data_out + o * height_out * width_out;
+    const int g = o / outputs_per_group;
+    for (int i = 0; i < channels_per_group; ++i) {
+      const Dtype* im = data_im + (g * channels_per_group + i) * height * width;
+      Dtype* w_diff = weights_diff + (o * channels_per_group + i) * kernel_h *
+          kernel_w;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int h_begin, h_end;
+        valid_output_range(kh, pad_h, stride_h, height, height_out, &h_begin,
+            &h_end);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          int w_begin, w_end;
+          valid_output_range(kw, pad_w, stride_w, width, width_out, &w_begin,
+              &w_end);
+          Dtype sum = 0;
+          for (int h = h_begin; h < h_end; ++h) {
+            const Dtype* im_row = im + (h * stride_h - pad_h + kh) * width -
+                pad_w + kw;
+            const Dtype* out_row = out + h * width_out;
+            for (int x = w_begin; x < w_end; ++x) {
+              sum += out_row[x] * im_row[x * stride_w];
+            }
+          }
+          w_diff[kh * kernel_w + kw] += sum;
+        }
+      }
+    }
+  }
+}
+
+// Explicit instantiation
+template void grouped_conv_cpu<float>(const float* data_im,
+    const int channels, const int height, const int width,
+    const float* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, float* data_out);
+template void grouped_conv_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width,
+    const double* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, double* data_out);
+template void grouped_conv_backward_data_cpu<float>(const float* data_out,
+    const int channels, const int height, const int width,
+    const float* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, float* data_im);
+template void grouped_conv_backward_data_cpu<double>(const double* data_out,
+    const int channels, const int height, const int width,
+    const double* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, double* data_im);
+template void grouped_conv_backward_weight_cpu<float>(const float* data_im,
+    const int channels, const int height, const int width,
+    const float* data_out, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, float* weights_diff);
+template void grouped_conv_backward_weight_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width,
+    const double* data_out, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, double* weights_diff);
+
+}  // namespace caffe
@@ -0,0 +1,270 @@
+#include <boost/thread.hpp>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef USE_NUMA
+#include <numa.h>
+#endif
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+namespace {
+
+const size_t kCacheLineSize = 64;
+const size_t kHugePageSize = 2 << 20;
+
+// The free blocks of one thread, by size class.
+struct ThreadCache {
+  ThreadCache() : bytes(0) {}
+  ~ThreadCache();
+  map<size_t, vector<void*> > free_lists;
+  size_t bytes;
+};
+
+// These are never destroyed: blocks may still be freed by static destructors
+// at exit.
+boost::mutex& stats_mutex() {
+  static boost::mutex* mutex = new boost::mutex();
+  return *mutex;
+}
+
+HostAllocator::Stats& stats() {
+  static HostAllocator::Stats* stats = new HostAllocator::Stats();
+  return *stats;
+}
+
+// Guarded by stats_mutex.
+size_t g_cache_limit = size_t(1) << 30;
+size_t g_total_cache_limit = size_t(2) << 30;
+
+ThreadCache* thread_cache() {
+  static boost::thread_specific_ptr<ThreadCache>* cache =
+      new boost::thread_specific_ptr<ThreadCache>();
+  if (!cache->get()) {
+    cache->reset(new ThreadCache());
+  }
+  return cache->get();
+}
+
+void ReleaseBlocks(ThreadCache* cache) {
+  for (map<size_t, vector<void*> >::iterator it = cache->free_lists.begin();
+       it != cache->free_lists.end(); ++it) {
+    for (int i = 0; i < it->second.size(); ++i) {
+      free(it->second[i]);
+    }
+  }
+  cache->free_lists.clear();
+  boost::mutex::scoped_lock lock(stats_mutex());
+  stats().bytes_cached -= cache->bytes;
+  cache->bytes = 0;
+}
+
+ThreadCache::~ThreadCache() {
+  ReleaseBlocks(this);
+}
+
+// Placed blocks take whole pages, or whole huge pages.
+size_t PlacedAlignment(const HostPlacement& placement) {
+  return placement.huge_pages ? kHugePageSize : sysconf(_SC_PAGESIZE);
+}
+
+size_t PlacedLength(size_t size, const HostPlacement& placement) {
+  const size_t alignment = PlacedAlignment(placement);
+  return (std::max(size, size_t(1)) + alignment - 1) / alignment * alignment;
+}
+
+void SetNumaPolicy(void* ptr, size_t length, HostPlacement::Numa numa) {
+  if (numa == HostPlacement::NUMA_DEFAULT) {
+    return;
+  }
+#ifdef USE_NUMA
+  if (numa_available() < 0) {
+    LOG_FIRST_N(WARNING, 1) << "NUMA is not available; placement ignored.";
+    return;
+  }
+  if (numa == HostPlacement::NUMA_INTERLEAVE) {
+    numa_interleave_memory(ptr, length, numa_all_nodes_ptr);
+  } else {
+    numa_setlocal_memory(ptr, length);
+  }
+#else
+  LOG_FIRST_N(WARNING, 1) << "Caffe was built without USE_NUMA; "
+      << "NUMA placement ignored.";
+#endif
+}
+
+}  // namespace
+
+size_t HostAllocator::RoundSize(size_t size) {
+  if (size <= kCacheLineSize) {
+    return kCacheLineSize;
+  }
+  size_t power = kCacheLineSize;
+  while (power * 2 < size) {
+    power *= 2;
+  }
+  // Four classes between power and 2 * power waste less than a quarter.
+  const size_t step = power / 4;
+  return (size + step - 1) / step * step;
+}
+
+void* HostAllocator::Allocate(size_t size) {
+  const size_t rounded = RoundSize(size);
+  ThreadCache* cache = thread_cache();
+  void* ptr = NULL;
+  map<size_t, vector<void*> >::iterator it = cache->free_lists.find(rounded);
+  if (it != cache->free_lists.end() && !it->second.empty()) {
+    ptr = it->second.back();
+    it->second.pop_back();
+    cache->bytes -= rounded;
+  }
+  const bool hit = (ptr != NULL);
+  if (!hit) {
+    const size_t alignment =
+        (rounded >= kHugePageSize) ? kHugePageSize : kCacheLineSize;
+    if (posix_memalign(&ptr, alignment, rounded) != 0) {
+      // Give the cached blocks back and try once more.
+      ReleaseBlocks(cache);
+      if (posix_memalign(&ptr, alignment, rounded) != 0) {
+        return NULL;
+      }
+    }
+  }
+  boost::mutex::scoped_lock lock(stats_mutex());
+  Stats& s = stats();
+  s.bytes_in_use += rounded;
+  s.peak_bytes_in_use = std::max(s.peak_bytes_in_use, s.bytes_in_use);
+  if (hit) {
+    s.bytes_cached -= rounded;
+    ++s.hits;
+  } else {
+    ++s.misses;
+  }
+  return ptr;
+}
+
+void HostAllocator::Free(void* ptr, size_t size) {
+  if (!ptr) {
+    return;
+  }
+  const size_t rounded = RoundSize(size);
+  ThreadCache* cache = thread_cache();
+  bool keep;
+  {
+    boost::mutex::scoped_lock lock(stats_mutex());
+    Stats& s = stats();
+    keep = cache->bytes + rounded <= g_cache_limit &&
+        s.bytes_cached + rounded <= g_total_cache_limit;
+    s.bytes_in_use -= rounded;
+    if (keep) {
+      s.bytes_cached += rounded;
+    }
+  }
+  if (keep) {
+    cache->free_lists[rounded].push_back(ptr);
+    cache->bytes += rounded;
+  } else {
+    free(ptr);
+  }
+}
+
+void* HostAllocator::Allocate(size_t size, const HostPlacement& placement) {
+  if (placement.is_default()) {
+    return Allocate(size);
+  }
+  // Map fresh pages, with room to align the start to a huge page, and set
+  // their policy before anything touches them.
+  const size_t alignment = PlacedAlignment(placement);
+  const size_t length = PlacedLength(size, placement);
+  const size_t mapped = placement.huge_pages ? length + alignment : length;
+  void* base = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  char* ptr = static_cast<char*>(base);
+  if (placement.huge_pages) {
+    const size_t head = (alignment - reinterpret_cast<size_t>(ptr) %
+        alignment) % alignment;
+    if (head > 0) {
+      munmap(ptr, head);
+    }
+    munmap(ptr + head + length, alignment - head);
+    ptr += head;
+#ifdef MADV_HUGEPAGE
+    // Fails only when the kernel lacks transparent huge pages.
+    madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+  }
+  SetNumaPolicy(ptr, length, placement.numa);
+  boost::mutex::scoped_lock lock(stats_mutex());
+  Stats& s = stats();
+  s.bytes_in_use += length;
+  s.peak_bytes_in_use = std::max(s.peak_bytes_in_use, s.bytes_in_use);
+  ++s.misses;
+  return ptr;
+}
+
+void HostAllocator::Free(void* ptr, size_t size,
+    const HostPlacement& placement) {
+  if (placement.is_default()) {
+    Free(ptr, size);
+    return;
+  }
+  if (!ptr) {
+    return;
+  }
+  const size_t length = PlacedLength(size, placement);
+  CHECK_EQ(0, munmap(ptr, length));
+  boost::mutex::scoped_lock lock(stats_mutex());
+  stats().bytes_in_use -= length;
+}
+
+HostAllocator::Stats HostAllocator::GetStats() {
+  boost::mutex::scoped_lock lock(stats_mutex());
+  return stats();
+}
+
+void HostAllocator::set_cache_limit(size_t bytes) {
+  boost::mutex::scoped_lock lock(stats_mutex());
+  g_cache_limit = bytes;
+}
+
+size_t HostAllocator::cache_limit() {
+  boost::mutex::scoped_lock lock(stats_mutex());
+  return g_cache_limit;
+}
+
+void HostAllocator::set_total_cache_limit(size_t bytes) {
+  boost::mutex::scoped_lock lock(stats_mutex());
+  g_total_cache_limit = bytes;
+}
+
+size_t HostAllocator::total_cache_limit() {
+  boost::mutex::scoped_lock lock(stats_mutex());
+  return g_total_cache_limit;
+}
+
+void HostAllocator::ReleaseCache() {
+  ReleaseBlocks(thread_cache());
+}
+
+void BindThreadToNumaNode(int node) {
+#ifdef USE_NUMA
+  CHECK_GE(numa_available(), 0) << "NUMA is not available.";
+  CHECK_GE(node, 0);
+  CHECK_LE(node, numa_max_node()) << "No NUMA node " << node;
+  CHECK_EQ(0, numa_run_on_node(node)) << "Cannot run on NUMA node " << node;
+  numa_set_preferred(node);
+#else
+  LOG(FATAL) << "Binding to a NUMA node requires a build with USE_NUMA.";
+#endif
+}
+
+}  // namespace caffe
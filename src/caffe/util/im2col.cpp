@@ -25,9 +25,11 @@ void im2col_cpu(const Dtype* data_im, const int channels,
       for (int w_col = 0; w_col < width_col; ++w_col) {
         int h_im = h_col * stride_h - pad_h + h_offset;
         int w_im = w_col * stride_w - pad_w + w_offset;
-        data_col[(c_col * height_col + h_col) * width_col + w_col] =
+        data_col[(static_cast<int64_t>(c_col) * height_col + h_col) *
+            width_col + w_col] =
             (h_im >= 0 && w_im >= 0 && h_im < height && w_im < width) ?
-            data_im[(c_im * height + h_im) * width + w_im] : 0;
+            data_im[(static_cast<int64_t>(c_im) * height + h_im) * width +
+            w_im] : 0;
       }
     }
   }
@@ -49,7 +51,7 @@ inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
     const int* kernel_shape, const int* pad, const int* stride,
     Dtype* data_output) {
   if (!im2col) {
-    int im_size = im_shape[0];
+    int64_t im_size = im_shape[0];
     for (int i = 0; i < num_spatial_axes; ++i) {
       im_size *= im_shape[1 + i];
     }
@@ -74,8 +76,8 @@ inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
     for (bool incremented = true; incremented; ) {
       // Loop over spatial axes in forward order to compute the indices in the
       // image and column, and whether the index lies in the padding.
-      int index_col = c_col;
-      int index_im = c_col / kernel_size;
+      int64_t index_col = c_col;
+      int64_t index_im = c_col / kernel_size;
       bool is_padding = false;
       for (int d_i = 0; d_i < num_spatial_axes; ++d_i) {
         const int d = d_iter[d_i];
@@ -141,7 +143,8 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int pad_h, const int pad_w,
     const int stride_h, const int stride_w,
     Dtype* data_im) {
-  caffe_set(height * width * channels, Dtype(0), data_im);
+  caffe_set(static_cast<int64_t>(height) * width * channels, Dtype(0),
+      data_im);
   const int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
   const int width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
   const int channels_col = channels * kernel_h * kernel_w;
@@ -154,8 +157,9 @@ void col2im_cpu(const Dtype* data_col, const int channels,
         int h_im = h_col * stride_h - pad_h + h_offset;
         int w_im = w_col * stride_w - pad_w + w_offset;
         if (h_im >= 0 && h_im < height && w_im >= 0 && w_im < width)
-          data_im[(c_im * height + h_im) * width + w_im] +=
-              data_col[(c_col * height_col + h_col) * width_col + w_col];
+          data_im[(static_cast<int64_t>(c_im) * height + h_im) * width +
+              w_im] += data_col[(static_cast<int64_t>(c_col) * height_col +
+              h_col) * width_col + w_col];
       }
     }
   }
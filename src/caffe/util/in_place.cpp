@@ -0,0 +1,157 @@
+#include <set>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/in_place.hpp"
+
+namespace caffe {
+
+// Neuron layers that may overwrite their bottom: their Backward reads only
+// the top data (or a mask), which is the same after running in place.
+static bool InPlaceSafe(const LayerParameter& layer) {
+  const string& type = layer.type();
+  if (type == "ReLU") {
+    // Backward tests bottom > 0, which matches top > 0 unless the negative
+    // slope flips the sign.
+    return layer.relu_param().negative_slope() >= 0;
+  }
+  return type == "Dropout" || type == "Sigmoid" || type == "TanH" ||
+      type == "Exp" || type == "Threshold";
+}
+
+// Neuron layers that may overwrite their bottom only if no Backward runs,
+// because their Backward reads the bottom data.
+static bool InPlaceSafeForward(const LayerParameter& layer) {
+  const string& type = layer.type();
+  return type == "Power" || type == "AbsVal" || type == "BNLL" ||
+      type == "Log";
+}
+
+// Producers whose top must not be overwritten: it shares memory with their
+// bottom (Split, Flatten, Reshape), may do so (Python), or is a loss.
+static bool TopIsShared(const LayerParameter& layer) {
+  const string& type = layer.type();
+  const string loss = "Loss";
+  return type == "Split" || type == "Flatten" || type == "Reshape" ||
+      type == "Python" || (type.size() >= loss.size() &&
+      type.compare(type.size() - loss.size(), loss.size(), loss) == 0);
+}
+
+// Producers whose Backward does not read their top data, so that a layer
+// may overwrite it before Backward runs.
+static bool BackwardIgnoresTop(const LayerParameter& layer) {
+  const string& type = layer.type();
+  if (type == "Eltwise") {
+    return layer.eltwise_param().operation() != EltwiseParameter_EltwiseOp_PROD;
+  }
+  // A fused ReLU takes its Backward mask from the top data.
+  if (type == "Convolution" || type == "Deconvolution") {
+    return !layer.convolution_param().has_relu_param();
+  }
+  if (type == "InnerProduct") {
+    return !layer.inner_product_param().has_relu_param();
+  }
+  return type == "Pooling" || type == "Concat" || type == "Slice" ||
+      type == "Embed" || type == "BatchReindex" || type == "Im2col" ||
+      type == "Tile" || type == "ReLU" || type == "Dropout" ||
+      type == "PReLU";
+}
+
+static bool HasBlob(const google::protobuf::RepeatedPtrField<string>& blobs,
+    const string& blob_name) {
+  for (int i = 0; i < blobs.size(); ++i) {
+    if (blobs.Get(i) == blob_name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool Mentions(const LayerParameter& layer, const string& blob_name) {
+  return HasBlob(layer.bottom(), blob_name) || HasBlob(layer.top(), blob_name);
+}
+
+static void Rename(google::protobuf::RepeatedPtrField<string>* blobs,
+    const string& from, const string& to) {
+  for (int i = 0; i < blobs->size(); ++i) {
+    if (blobs->Get(i) == from) {
+      *blobs->Mutable(i) = to;
+    }
+  }
+}
+
+int RunNeuronsInPlace(const NetParameter& param,
+    NetParameter* param_in_place) {
+  param_in_place->CopyFrom(param);
+  const bool backward = param.state().phase() == TRAIN ||
+      param.force_backward();
+  const std::set<string> preserved(param.preserve_blob().begin(),
+      param.preserve_blob().end());
+  int rewritten = 0;
+  for (int i = 0; i < param_in_place->layer_size(); ++i) {
+    const LayerParameter& layer = param_in_place->layer(i);
+    if (!(InPlaceSafe(layer) || (!backward && InPlaceSafeForward(layer))) ||
+        layer.bottom_size() != 1 || layer.top_size() != 1 ||
+        layer.bottom(0) == layer.top(0) || layer.loss_weight_size() > 0) {
+      continue;
+    }
+    const string bottom_name = layer.bottom(0);
+    const string top_name = layer.top(0);
+    if (preserved.count(bottom_name)) {
+      continue;
+    }
+    // Walk back over the layers already running in place on the bottom to
+    // the layer that produced it, checking that none of the layers in between
+    // reads it, so that this layer is its only consumer.
+    int producer = i - 1;
+    bool safe = true;
+    for (; producer >= 0; --producer) {
+      const LayerParameter& other = param_in_place->layer(producer);
+      const bool reads = HasBlob(other.bottom(), bottom_name);
+      const bool writes = HasBlob(other.top(), bottom_name);
+      if (writes && !reads) {
+        break;
+      }
+      if (reads != writes || (writes && backward)) {
+        // Another consumer, or an in-place layer whose Backward reads the
+        // value that this layer would overwrite.
+        safe = false;
+        break;
+      }
+    }
+    if (!safe || producer < 0) {
+      continue;
+    }
+    const LayerParameter& source = param_in_place->layer(producer);
+    if (source.bottom_size() == 0 || TopIsShared(source) ||
+        source.loss_weight_size() > 0 ||
+        (backward && !BackwardIgnoresTop(source))) {
+      continue;
+    }
+    // Nothing after this layer may read the bottom and nothing up to it may
+    // already use the top name, so that renaming does not merge two blobs.
+    for (int j = i + 1; safe && j < param_in_place->layer_size(); ++j) {
+      safe = !Mentions(param_in_place->layer(j), bottom_name);
+    }
+    for (int j = 0; safe && j < i; ++j) {
+      safe = !Mentions(param_in_place->layer(j), top_name);
+    }
+    if (!safe) {
+      continue;
+    }
+    for (int j = producer; j <= i; ++j) {
+      LayerParameter* other = param_in_place->mutable_layer(j);
+      if (j > producer) {
+        Rename(other->mutable_bottom(), bottom_name, top_name);
+      }
+      Rename(other->mutable_top(), bottom_name, top_name);
+    }
+    LOG_IF(INFO, Caffe::root_solver()) << "Running " << layer.name()
+        << " in place: blob " << bottom_name << " (top of "
+        << source.name() << ") is now " << top_name;
+    ++rewritten;
+  }
+  return rewritten;
+}
+
+}  // namespace caffe
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -106,6 +107,77 @@ void InsertSplits(const NetParameter& param, NetParameter* param_split) {
   }
 }
 
+int ElideSplits(const NetParameter& param_split, NetParameter* param_elided) {
+  param_elided->CopyFrom(param_split);
+  param_elided->clear_layer();
+  // The split that produces each top, for the splits without a loss weight.
+  map<string, int> top_to_split;
+  for (int i = 0; i < param_split.layer_size(); ++i) {
+    const LayerParameter& layer_param = param_split.layer(i);
+    if (layer_param.type() != "Split" || layer_param.bottom_size() != 1) {
+      continue;
+    }
+    bool has_loss = false;
+    for (int j = 0; j < layer_param.loss_weight_size(); ++j) {
+      has_loss |= layer_param.loss_weight(j) != 0;
+    }
+    if (!has_loss) {
+      for (int j = 0; j < layer_param.top_size(); ++j) {
+        top_to_split[layer_param.top(j)] = i;
+      }
+    }
+  }
+  set<int> kept_splits;
+  map<string, int> top_reads;
+  for (int i = 0; i < param_split.layer_size(); ++i) {
+    const LayerParameter& layer_param = param_split.layer(i);
+    set<int> read_splits;
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      map<string, int>::const_iterator split =
+          top_to_split.find(layer_param.bottom(j));
+      if (split == top_to_split.end()) { continue; }
+      ++top_reads[layer_param.bottom(j)];
+      if (!read_splits.insert(split->second).second) {
+        kept_splits.insert(split->second);
+      }
+      const string& split_bottom = param_split.layer(split->second).bottom(0);
+      for (int k = 0; k < layer_param.top_size(); ++k) {
+        if (layer_param.top(k) == split_bottom) {
+          kept_splits.insert(split->second);
+        }
+      }
+    }
+  }
+  // Each top must be read once, e.g. not be an output of the net.
+  for (map<string, int>::const_iterator it = top_to_split.begin();
+       it != top_to_split.end(); ++it) {
+    if (top_reads[it->first] != 1) {
+      kept_splits.insert(it->second);
+    }
+  }
+  int num_elided = 0;
+  for (int i = 0; i < param_split.layer_size(); ++i) {
+    map<string, int>::const_iterator split = top_to_split.end();
+    if (param_split.layer(i).top_size() > 0) {
+      split = top_to_split.find(param_split.layer(i).top(0));
+    }
+    if (split != top_to_split.end() && split->second == i &&
+        !kept_splits.count(i)) {
+      ++num_elided;
+      continue;
+    }
+    LayerParameter* layer_param = param_elided->add_layer();
+    layer_param->CopyFrom(param_split.layer(i));
+    for (int j = 0; j < layer_param->bottom_size(); ++j) {
+      split = top_to_split.find(layer_param->bottom(j));
+      if (split != top_to_split.end() && !kept_splits.count(split->second)) {
+        layer_param->set_bottom(j, param_split.layer(split->second).bottom(0));
+      }
+    }
+  }
+  return num_elided;
+}
+
 void ConfigureSplitLayer(const string& layer_name, const string& blob_name,
     const int blob_idx, const int split_count, const float loss_weight,
     LayerParameter* split_layer_param) {
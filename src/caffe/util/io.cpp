@@ -9,6 +9,8 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #endif  // USE_OPENCV
 #include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
@@ -64,6 +66,26 @@ bool ReadProtoFromBinaryFile(const char* filename, Message* proto) {
   return success;
 }
 
+bool ReadProtoFromMappedFile(const char* filename, Message* proto) {
+  int fd = open(filename, O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << filename;
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0) << "Cannot stat " << filename;
+  const size_t size = file_stat.st_size;
+  CHECK_LE(size, static_cast<size_t>(kProtoReadBytesLimit))
+      << filename << " is too large";
+  void* data = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  CHECK(data != MAP_FAILED) << "Cannot map " << filename;
+  CodedInputStream coded_input(static_cast<const uint8_t*>(data), size);
+  coded_input.SetTotalBytesLimit(kProtoReadBytesLimit, 536870912);
+  bool success = proto->ParseFromCodedStream(&coded_input);
+  if (data) {
+    munmap(data, size);
+  }
+  close(fd);
+  return success;
+}
+
 void WriteProtoToBinaryFile(const Message& proto, const char* filename) {
   fstream output(filename, ios::out | ios::trunc | ios::binary);
   CHECK(proto.SerializeToOstream(&output));
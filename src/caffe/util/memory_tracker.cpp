@@ -0,0 +1,124 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/memory_tracker.hpp"
+
+namespace caffe {
+
+namespace {
+
+struct Accounts {
+  Accounts() : names(1, "other"), usage(1, vector<MemoryTracker::Usage>(2)),
+      total(2) {}
+  boost::mutex mutex;
+  vector<string> names;
+  map<string, int> ids;
+  // Indexed by owner, then device.
+  vector<vector<MemoryTracker::Usage> > usage;
+  vector<MemoryTracker::Usage> total;
+};
+
+// Never destroyed: memory may still be freed by static destructors at exit.
+Accounts& accounts() {
+  static Accounts* accounts = new Accounts();
+  return *accounts;
+}
+
+boost::thread_specific_ptr<int>& thread_owner() {
+  static boost::thread_specific_ptr<int>* owner =
+      new boost::thread_specific_ptr<int>();
+  return *owner;
+}
+
+}  // namespace
+
+int MemoryTracker::Owner(const string& name) {
+  Accounts& a = accounts();
+  boost::mutex::scoped_lock lock(a.mutex);
+  map<string, int>::const_iterator it = a.ids.find(name);
+  if (it != a.ids.end()) {
+    return it->second;
+  }
+  const int owner = a.names.size();
+  a.names.push_back(name);
+  a.usage.push_back(vector<Usage>(2));
+  a.ids[name] = owner;
+  return owner;
+}
+
+string MemoryTracker::owner_name(int owner) {
+  Accounts& a = accounts();
+  boost::mutex::scoped_lock lock(a.mutex);
+  CHECK_GE(owner, 0);
+  CHECK_LT(owner, a.names.size());
+  return a.names[owner];
+}
+
+int MemoryTracker::current_owner() {
+  const int* owner = thread_owner().get();
+  return owner ? *owner : 0;
+}
+
+void MemoryTracker::Allocated(int owner, Device device, size_t bytes) {
+  Accounts& a = accounts();
+  boost::mutex::scoped_lock lock(a.mutex);
+  Usage* usages[] = { &a.usage[owner][device], &a.total[device] };
+  for (int i = 0; i < 2; ++i) {
+    usages[i]->bytes += bytes;
+    usages[i]->peak_bytes =
+        std::max(usages[i]->peak_bytes, usages[i]->bytes);
+  }
+}
+
+void MemoryTracker::Freed(int owner, Device device, size_t bytes) {
+  Accounts& a = accounts();
+  boost::mutex::scoped_lock lock(a.mutex);
+  CHECK_GE(a.usage[owner][device].bytes, bytes)
+      << "Freeing more memory than " << a.names[owner] << " allocated";
+  a.usage[owner][device].bytes -= bytes;
+  a.total[device].bytes -= bytes;
+}
+
+MemoryTracker::Usage MemoryTracker::GetUsage(int owner, Device device) {
+  Accounts& a = accounts();
+  boost::mutex::scoped_lock lock(a.mutex);
+  CHECK_GE(owner, 0);
+  CHECK_LT(owner, a.usage.size());
+  return a.usage[owner][device];
+}
+
+MemoryTracker::Usage MemoryTracker::GetTotal(Device device) {
+  Accounts& a = accounts();
+  boost::mutex::scoped_lock lock(a.mutex);
+  return a.total[device];
+}
+
+void MemoryTracker::ResetPeaks() {
+  Accounts& a = accounts();
+  boost::mutex::scoped_lock lock(a.mutex);
+  for (int i = 0; i < a.usage.size(); ++i) {
+    for (int j = 0; j < a.usage[i].size(); ++j) {
+      a.usage[i][j].peak_bytes = a.usage[i][j].bytes;
+    }
+  }
+  for (int j = 0; j < a.total.size(); ++j) {
+    a.total[j].peak_bytes = a.total[j].bytes;
+  }
+}
+
+MemoryTracker::Scope::Scope(int owner) : previous_(current_owner()) {
+  if (!thread_owner().get()) {
+    thread_owner().reset(new int(0));
+  }
+  *thread_owner() = owner;
+}
+
+MemoryTracker::Scope::~Scope() {
+  *thread_owner() = previous_;
+}
+
+}  // namespace caffe
@@ -0,0 +1,428 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/packed_gemm.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_PACKED_GEMM_AVX2
+#include <immintrin.h>
+#endif
+
+namespace caffe {
+
+namespace {
+
+const int MR = kPackedGemmMR;
+const int NR = kPackedGemmNR;
+const int KC = kPackedGemmKC;
+const int MC = kPackedGemmMC;
+const int NC = kPackedGemmNC;
+
+inline int round_up(const int n, const int multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+// Per-thread panels for operands that are packed on the fly.
+struct PackBuffers {
+  std::vector<char> a;
+  std::vector<char> b;
+};
+static boost::thread_specific_ptr<PackBuffers> thread_pack_buffers_;
+
+template <typename Dtype>
+Dtype* pack_buffer(std::vector<char>* buffer, const int count) {
+  const size_t bytes = count * sizeof(Dtype);
+  if (buffer->size() < bytes) {
+    buffer->resize(bytes);
+  }
+  return reinterpret_cast<Dtype*>(&(*buffer)[0]);
+}
+
+PackBuffers& pack_buffers() {
+  if (!thread_pack_buffers_.get()) {
+    thread_pack_buffers_.reset(new PackBuffers());
+  }
+  return *thread_pack_buffers_;
+}
+
+// Packs the mc x kc block of op(A) starting at (i0, p0) into MR-row slivers:
+// sliver s holds element (i0 + s * MR + r, p0 + p) at
+// [s * MR * kc + p * MR + r] and rows past the end of the block are zero.
+template <typename Dtype>
+void pack_left_block(const CBLAS_TRANSPOSE trans, const Dtype* A,
+    const int lda, const int i0, const int p0, const int mc, const int kc,
+    Dtype* packed) {
+  for (int is = 0; is < mc; is += MR) {
+    const int mr = std::min(MR, mc - is);
+    for (int p = 0; p < kc; ++p) {
+      for (int r = 0; r < mr; ++r) {
+        const int i = i0 + is + r;
+        packed[p * MR + r] = (trans == CblasNoTrans) ?
+            A[i * lda + p0 + p] : A[(p0 + p) * lda + i];
+      }
+      for (int r = mr; r < MR; ++r) {
+        packed[p * MR + r] = 0;
+      }
+    }
+    packed += MR * kc;
+  }
+}
+
+// Packs the kc x nc block of op(B) starting at (p0, j0) into NR-column
+// slivers: sliver s holds element (p0 + p, j0 + s * NR + c) at
+// [s * NR * kc + p * NR + c] and columns past the end of the block are zero.
+template <typename Dtype>
+void pack_right_block(const CBLAS_TRANSPOSE trans, const Dtype* B,
+    const int ldb, const int p0, const int j0, const int kc, const int nc,
+    Dtype* packed) {
+  for (int js = 0; js < nc; js += NR) {
+    const int nr = std::min(NR, nc - js);
+    for (int p = 0; p < kc; ++p) {
+      if (trans == CblasNoTrans) {
+        const Dtype* row = B + (p0 + p) * ldb + j0 + js;
+        for (int c = 0; c < nr; ++c) {
+          packed[p * NR + c] = row[c];
+        }
+      } else {
+        for (int c = 0; c < nr; ++c) {
+          packed[p * NR + c] = B[(j0 + js + c) * ldb + p0 + p];
+        }
+      }
+      for (int c = nr; c < NR; ++c) {
+        packed[p * NR + c] = 0;
+      }
+    }
+    packed += NR * kc;
+  }
+}
+
+// Writes alpha * acc + beta * C for the top-left mr x nr part of an MR x NR
+// tile; C is not read when beta is zero.
+template <typename Dtype>
+void store_tile(const int mr, const int nr, const Dtype alpha,
+    const Dtype* acc, const Dtype beta, Dtype* C, const int ldc) {
+  for (int r = 0; r < mr; ++r) {
+    for (int c = 0; c < nr; ++c) {
+      C[r * ldc + c] = (beta == Dtype(0)) ? alpha * acc[r * NR + c] :
+          alpha * acc[r * NR + c] + beta * C[r * ldc + c];
+    }
+  }
+}
+
+template <typename Dtype>
+void micro_kernel_generic(const int kc, const Dtype* a, const Dtype* b,
+    Dtype* acc) {
+  std::fill(acc, acc + MR * NR, Dtype(0));
+  for (int p = 0; p < kc; ++p) {
+    for (int r = 0; r < MR; ++r) {
+      const Dtype a_r = a[r];
+      for (int c = 0; c < NR; ++c) {
+        acc[r * NR + c] += a_r * b[c];
+      }
+    }
+    a += MR;
+    b += NR;
+  }
+}
+
+#ifdef CAFFE_PACKED_GEMM_AVX2
+// 6 x 16 float micro-kernel: twelve ymm accumulators, two vector loads of B
+// and six broadcasts of A per step of k.
+__attribute__((target("avx2,fma")))
+void micro_kernel_avx2(const int kc, const float* a, const float* b,
+    float* acc) {
+  __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+  __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+  __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+  __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+  __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+  for (int p = 0; p < kc; ++p) {
+    const __m256 b0 = _mm256_loadu_ps(b);
+    const __m256 b1 = _mm256_loadu_ps(b + 8);
+    __m256 a_r = _mm256_broadcast_ss(a);
+    c00 = _mm256_fmadd_ps(a_r, b0, c00);
+    c01 = _mm256_fmadd_ps(a_r, b1, c01);
+    a_r = _mm256_broadcast_ss(a + 1);
+    c10 = _mm256_fmadd_ps(a_r, b0, c10);
+    c11 = _mm256_fmadd_ps(a_r, b1, c11);
+    a_r = _mm256_broadcast_ss(a + 2);
+    c20 = _mm256_fmadd_ps(a_r, b0, c20);
+    c21 = _mm256_fmadd_ps(a_r, b1, c21);
+    a_r = _mm256_broadcast_ss(a + 3);
+    c30 = _mm256_fmadd_ps(a_r, b0, c30);
+    c31 = _mm256_fmadd_ps(a_r, b1, c31);
+    a_r = _mm256_broadcast_ss(a + 4);
+    c40 = _mm256_fmadd_ps(a_r, b0, c40);
+    c41 = _mm256_fmadd_ps(a_r, b1, c41);
+    a_r = _mm256_broadcast_ss(a + 5);
+    c50 = _mm256_fmadd_ps(a_r, b0, c50);
+    c51 = _mm256_fmadd_ps(a_r, b1, c51);
+    a += MR;
+    b += NR;
+  }
+  _mm256_storeu_ps(acc, c00);
+  _mm256_storeu_ps(acc + 8, c01);
+  _mm256_storeu_ps(acc + 16, c10);
+  _mm256_storeu_ps(acc + 24, c11);
+  _mm256_storeu_ps(acc + 32, c20);
+  _mm256_storeu_ps(acc + 40, c21);
+  _mm256_storeu_ps(acc + 48, c30);
+  _mm256_storeu_ps(acc + 56, c31);
+  _mm256_storeu_ps(acc + 64, c40);
+  _mm256_storeu_ps(acc + 72, c41);
+  _mm256_storeu_ps(acc + 80, c50);
+  _mm256_storeu_ps(acc + 88, c51);
+}
+
+bool detect_avx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+#endif
+
+bool has_avx2() {
+#ifdef CAFFE_PACKED_GEMM_AVX2
+  static const bool avx2 = detect_avx2();
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+template <typename Dtype>
+inline void micro_kernel(const int kc, const Dtype* a, const Dtype* b,
+    Dtype* acc) {
+  micro_kernel_generic(kc, a, b, acc);
+}
+
+#ifdef CAFFE_PACKED_GEMM_AVX2
+template <>
+inline void micro_kernel<float>(const int kc, const float* a, const float* b,
+    float* acc) {
+  if (has_avx2()) {
+    micro_kernel_avx2(kc, a, b, acc);
+  } else {
+    micro_kernel_generic(kc, a, b, acc);
+  }
+}
+#endif
+
+// One operand of the driver: either a plain row-major matrix that is packed
+// block by block into the thread's scratch panel, or a PackedMatrix.
+template <typename Dtype>
+struct Operand {
+  CBLAS_TRANSPOSE trans;
+  const Dtype* data;
+  int ld;
+  const PackedMatrix<Dtype>* packed;
+};
+
+// The GotoBLAS loop nest. Both packed layouts store the KC-deep blocks one
+// after the other, each covering the whole padded M (resp. N) dimension, so a
+// pre-packed panel for block (pc, ic) simply starts at pc * padded + ic * kc.
+template <typename Dtype>
+void packed_gemm_driver(const int M, const int N, const int K,
+    const Dtype alpha, const Operand<Dtype>& A, const Operand<Dtype>& B,
+    const Dtype beta, Dtype* C) {
+  if (M <= 0 || N <= 0) {
+    return;
+  }
+  if (K <= 0 || alpha == Dtype(0)) {
+    for (int i = 0; i < M * N; ++i) {
+      C[i] = (beta == Dtype(0)) ? Dtype(0) : beta * C[i];
+    }
+    return;
+  }
+  PackBuffers& buffers = pack_buffers();
+  Dtype* a_panel = A.packed ? NULL :
+      pack_buffer<Dtype>(&buffers.a, MC * KC);
+  Dtype* b_panel = B.packed ? NULL :
+      pack_buffer<Dtype>(&buffers.b, round_up(std::min(N, NC), NR) * KC);
+  Dtype acc[MR * NR];
+  for (int jc = 0; jc < N; jc += NC) {
+    const int nc = std::min(NC, N - jc);
+    for (int pc = 0; pc < K; pc += KC) {
+      const int kc = std::min(KC, K - pc);
+      const Dtype beta_pc = (pc == 0) ? beta : Dtype(1);
+      const Dtype* b_block;
+      if (B.packed) {
+        b_block = B.packed->data() + pc * B.packed->padded() + jc * kc;
+      } else {
+        pack_right_block(B.trans, B.data, B.ld, pc, jc, kc, nc, b_panel);
+        b_block = b_panel;
+      }
+      for (int ic = 0; ic < M; ic += MC) {
+        const int mc = std::min(MC, M - ic);
+        const Dtype* a_block;
+        if (A.packed) {
+          a_block = A.packed->data() + pc * A.packed->padded() + ic * kc;
+        } else {
+          pack_left_block(A.trans, A.data, A.ld, ic, pc, mc, kc, a_panel);
+          a_block = a_panel;
+        }
+        for (int jr = 0; jr < nc; jr += NR) {
+          const int nr = std::min(NR, nc - jr);
+          for (int ir = 0; ir < mc; ir += MR) {
+            const int mr = std::min(MR, mc - ir);
+            micro_kernel(kc, a_block + ir * kc, b_block + jr * kc, acc);
+            store_tile(mr, nr, alpha, acc, beta_pc,
+                C + (ic + ir) * N + jc + jr, N);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool caffe_packed_gemm_has_avx2() {
+  return has_avx2();
+}
+
+template <typename Dtype>
+int PackedMatrix<Dtype>::padded() const {
+  return round_up(left_ ? rows_ : cols_, left_ ? MR : NR);
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::PackLeft(const CBLAS_TRANSPOSE trans, const int M,
+    const int K, const Dtype* A) {
+  CHECK_GE(M, 0);
+  CHECK_GE(K, 0);
+  left_ = true;
+  rows_ = M;
+  cols_ = K;
+  trans_ = trans;
+  source_.reset();
+  const int m_padded = padded();
+  data_.resize(std::max(m_padded * K, 1));
+  const int lda = (trans == CblasNoTrans) ? K : M;
+  for (int pc = 0; pc < K; pc += KC) {
+    const int kc = std::min(KC, K - pc);
+    pack_left_block(trans, A, lda, 0, pc, M, kc, &data_[pc * m_padded]);
+  }
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::PackRight(const CBLAS_TRANSPOSE trans, const int K,
+    const int N, const Dtype* B) {
+  CHECK_GE(K, 0);
+  CHECK_GE(N, 0);
+  left_ = false;
+  rows_ = K;
+  cols_ = N;
+  trans_ = trans;
+  source_.reset();
+  const int n_padded = padded();
+  data_.resize(std::max(n_padded * K, 1));
+  const int ldb = (trans == CblasNoTrans) ? N : K;
+  for (int pc = 0; pc < K; pc += KC) {
+    const int kc = std::min(KC, K - pc);
+    pack_right_block(trans, B, ldb, pc, 0, kc, N, &data_[pc * n_padded]);
+  }
+}
+
+template <typename Dtype>
+bool PackedMatrix<Dtype>::IsPackedFrom(const bool left,
+    const CBLAS_TRANSPOSE trans, const int rows, const int cols,
+    const shared_ptr<SyncedMemory>& mem, const int offset) const {
+  return source_ == mem && source_version_ == mem->version() &&
+      left_ == left && trans_ == trans && rows_ == rows && cols_ == cols &&
+      offset_ == offset;
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::PackLeft(const CBLAS_TRANSPOSE trans, const int M,
+    const int K, const shared_ptr<SyncedMemory>& mem, const int offset) {
+  if (IsPackedFrom(true, trans, M, K, mem, offset)) {
+    return;
+  }
+  CHECK_LE((offset + M * K) * sizeof(Dtype), mem->size());
+  PackLeft(trans, M, K, static_cast<const Dtype*>(mem->cpu_data()) + offset);
+  source_ = mem;
+  source_version_ = mem->version();
+  offset_ = offset;
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::PackRight(const CBLAS_TRANSPOSE trans, const int K,
+    const int N, const shared_ptr<SyncedMemory>& mem, const int offset) {
+  if (IsPackedFrom(false, trans, K, N, mem, offset)) {
+    return;
+  }
+  CHECK_LE((offset + K * N) * sizeof(Dtype), mem->size());
+  PackRight(trans, K, N, static_cast<const Dtype*>(mem->cpu_data()) + offset);
+  source_ = mem;
+  source_version_ = mem->version();
+  offset_ = offset;
+}
+
+template <typename Dtype>
+void PackedMatrix<Dtype>::Clear() {
+  rows_ = cols_ = offset_ = 0;
+  source_.reset();
+  std::vector<Dtype>().swap(data_);
+}
+
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
+    Dtype* C) {
+  Operand<Dtype> a = { TransA, A, (TransA == CblasNoTrans) ? K : M, NULL };
+  Operand<Dtype> b = { TransB, B, (TransB == CblasNoTrans) ? N : K, NULL };
+  packed_gemm_driver(M, N, K, alpha, a, b, beta, C);
+}
+
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const PackedMatrix<Dtype>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const Dtype alpha,
+    const Dtype* B, const Dtype beta, Dtype* C) {
+  CHECK(A.is_left()) << "Matrix was packed as a right operand.";
+  const int K = A.cols();
+  Operand<Dtype> a = { CblasNoTrans, NULL, 0, &A };
+  Operand<Dtype> b = { TransB, B, (TransB == CblasNoTrans) ? N : K, NULL };
+  packed_gemm_driver(A.rows(), N, K, alpha, a, b, beta, C);
+}
+
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const CBLAS_TRANSPOSE TransA, const int M,
+    const Dtype alpha, const Dtype* A, const PackedMatrix<Dtype>& B,
+    const Dtype beta, Dtype* C) {
+  CHECK(!B.is_left()) << "Matrix was packed as a left operand.";
+  const int K = B.rows();
+  Operand<Dtype> a = { TransA, A, (TransA == CblasNoTrans) ? K : M, NULL };
+  Operand<Dtype> b = { CblasNoTrans, NULL, 0, &B };
+  packed_gemm_driver(M, B.cols(), K, alpha, a, b, beta, C);
+}
+
+INSTANTIATE_CLASS(PackedMatrix);
+
+template void caffe_cpu_packed_gemm<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const float* B, const float beta,
+    float* C);
+template void caffe_cpu_packed_gemm<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const double* B, const double beta,
+    double* C);
+template void caffe_cpu_packed_gemm<float>(const PackedMatrix<float>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const float alpha,
+    const float* B, const float beta, float* C);
+template void caffe_cpu_packed_gemm<double>(const PackedMatrix<double>& A,
+    const CBLAS_TRANSPOSE TransB, const int N, const double alpha,
+    const double* B, const double beta, double* C);
+template void caffe_cpu_packed_gemm<float>(const CBLAS_TRANSPOSE TransA,
+    const int M, const float alpha, const float* A,
+    const PackedMatrix<float>& B, const float beta, float* C);
+template void caffe_cpu_packed_gemm<double>(const CBLAS_TRANSPOSE TransA,
+    const int M, const double alpha, const double* A,
+    const PackedMatrix<double>& B, const double beta, double* C);
+
+}  // namespace caffe
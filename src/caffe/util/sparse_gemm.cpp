@@ -0,0 +1,126 @@
+#include <cstring>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/sparse_gemm.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void SparseMatrix<Dtype>::FromDense(const int rows, const int cols,
+    const Dtype* A) {
+  CHECK_GE(rows, 0);
+  CHECK_GE(cols, 0);
+  rows_ = rows;
+  cols_ = cols;
+  source_.reset();
+  row_ptr_.resize(rows + 1);
+  col_ind_.clear();
+  values_.clear();
+  row_ptr_[0] = 0;
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      const Dtype value = A[i * cols + j];
+      if (value != Dtype(0)) {
+        col_ind_.push_back(j);
+        values_.push_back(value);
+      }
+    }
+    row_ptr_[i + 1] = values_.size();
+  }
+  nnz_ = values_.size();
+  is_sparse_ = true;
+}
+
+template <typename Dtype>
+void SparseMatrix<Dtype>::FromDense(const int rows, const int cols,
+    const shared_ptr<SyncedMemory>& mem, const int offset,
+    const float min_sparsity) {
+  if (source_ == mem && source_version_ == mem->version() &&
+      offset_ == offset && rows_ == rows && cols_ == cols &&
+      min_sparsity_ == min_sparsity) {
+    return;
+  }
+  CHECK_LE((offset + rows * cols) * sizeof(Dtype), mem->size());
+  const Dtype* A = static_cast<const Dtype*>(mem->cpu_data()) + offset;
+  int nnz = 0;
+  for (int i = 0; i < rows * cols; ++i) {
+    nnz += (A[i] != Dtype(0));
+  }
+  rows_ = rows;
+  cols_ = cols;
+  nnz_ = nnz;
+  if (sparsity() >= min_sparsity) {
+    FromDense(rows, cols, A);
+  } else {
+    // Not worth it: release the CSR arrays and stay on the dense path.
+    is_sparse_ = false;
+    std::vector<int>().swap(row_ptr_);
+    std::vector<int>().swap(col_ind_);
+    std::vector<Dtype>().swap(values_);
+  }
+  source_ = mem;
+  source_version_ = mem->version();
+  offset_ = offset;
+  min_sparsity_ = min_sparsity;
+}
+
+template <typename Dtype>
+void caffe_cpu_csrmm(const SparseMatrix<Dtype>& A, const int N,
+    const Dtype alpha, const Dtype* B, const Dtype beta, Dtype* C) {
+  CHECK(A.is_sparse());
+  const int* row_ptr = A.row_ptr();
+  const int* col_ind = A.col_ind();
+  const Dtype* values = A.values();
+  for (int i = 0; i < A.rows(); ++i) {
+    Dtype* C_row = C + i * N;
+    if (beta == Dtype(0)) {
+      caffe_set(N, Dtype(0), C_row);
+    } else if (beta != Dtype(1)) {
+      caffe_scal(N, beta, C_row);
+    }
+    for (int k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+      caffe_axpy(N, alpha * values[k], B + col_ind[k] * N, C_row);
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_gemm_csrt(const int M, const Dtype alpha, const Dtype* A,
+    const SparseMatrix<Dtype>& B, const Dtype beta, Dtype* C) {
+  CHECK(B.is_sparse());
+  const int N = B.rows();
+  const int K = B.cols();
+  const int* row_ptr = B.row_ptr();
+  const int* col_ind = B.col_ind();
+  const Dtype* values = B.values();
+  for (int m = 0; m < M; ++m) {
+    const Dtype* A_row = A + m * K;
+    Dtype* C_row = C + m * N;
+    for (int n = 0; n < N; ++n) {
+      Dtype sum = 0;
+      for (int k = row_ptr[n]; k < row_ptr[n + 1]; ++k) {
+        sum += values[k] * A_row[col_ind[k]];
+      }
+      C_row[n] = (beta == Dtype(0)) ? alpha * sum :
+          alpha * sum + beta * C_row[n];
+    }
+  }
+}
+
+INSTANTIATE_CLASS(SparseMatrix);
+
+template void caffe_cpu_csrmm<float>(const SparseMatrix<float>& A,
+    const int N, const float alpha, const float* B, const float beta,
+    float* C);
+template void caffe_cpu_csrmm<double>(const SparseMatrix<double>& A,
+    const int N, const double alpha, const double* B, const double beta,
+    double* C);
+template void caffe_cpu_gemm_csrt<float>(const int M, const float alpha,
+    const float* A, const SparseMatrix<float>& B, const float beta, float* C);
+template void caffe_cpu_gemm_csrt<double>(const int M, const double alpha,
+    const double* A, const SparseMatrix<double>& B, const double beta,
+    double* C);
+
+}  // namespace caffe
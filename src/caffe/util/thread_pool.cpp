@@ -0,0 +1,101 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <deque>
+
+#include "caffe/util/host_allocator.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+};
+
+// The pool and index of the worker running on the calling thread, if any.
+struct PoolWorker {
+  const ThreadPool* pool;
+  int worker;
+};
+static boost::thread_specific_ptr<PoolWorker> pool_worker_;
+
+ThreadPool::ThreadPool(int num_threads)
+    : queues_(num_threads), sync_(new sync()), next_queue_(0),
+      stopping_(false) {
+  CHECK_GT(num_threads, 0);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.push_back(shared_ptr<boost::thread>(new boost::thread(
+        boost::bind(&ThreadPool::WorkerEntry, this, i, Caffe::numa_node()))));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stopping_ = true;
+  }
+  sync_->condition_.notify_all();
+  for (int i = 0; i < threads_.size(); ++i) {
+    threads_[i]->join();
+  }
+}
+
+void ThreadPool::Submit(const Task& task) {
+  const PoolWorker* current = pool_worker_.get();
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  int queue;
+  if (current && current->pool == this) {
+    queue = current->worker;
+  } else {
+    queue = next_queue_;
+    next_queue_ = (next_queue_ + 1) % queues_.size();
+  }
+  queues_[queue].push_back(task);
+  lock.unlock();
+  sync_->condition_.notify_one();
+}
+
+bool ThreadPool::NextTask(int worker, Task* task) {
+  if (!queues_[worker].empty()) {
+    *task = queues_[worker].back();
+    queues_[worker].pop_back();
+    return true;
+  }
+  for (int i = 1; i < queues_.size(); ++i) {
+    std::deque<Task>& victim = queues_[(worker + i) % queues_.size()];
+    if (!victim.empty()) {
+      *task = victim.front();
+      victim.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerEntry(int worker, int numa_node) {
+  if (numa_node >= 0) {
+    BindThreadToNumaNode(numa_node);
+    Caffe::set_numa_node(numa_node);
+  }
+  PoolWorker* current = new PoolWorker();
+  current->pool = this;
+  current->worker = worker;
+  pool_worker_.reset(current);
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (true) {
+    Task task;
+    if (NextTask(worker, &task)) {
+      lock.unlock();
+      task();
+      lock.lock();
+    } else if (stopping_) {
+      break;
+    } else {
+      sync_->condition_.wait(lock);
+    }
+  }
+}
+
+}  // namespace caffe
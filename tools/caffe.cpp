@@ -12,6 +12,7 @@ namespace bp = boost::python;
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/util/host_allocator.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
@@ -46,6 +47,22 @@ DEFINE_string(sigint_effect, "stop",
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_string(cpu_gemm, "blas",
+    "Optional; the CPU matrix multiply: blas (the linked BLAS library) or "
+    "packed (the built-in kernel with pre-packed weights).");
+DEFINE_int32(host_cache_mb, 1024,
+    "Optional; the MB of freed host memory each thread keeps for reuse.");
+DEFINE_int32(host_cache_total_mb, 2048,
+    "Optional; the MB of freed host memory all threads keep for reuse.");
+DEFINE_int32(numa_node, -1,
+    "Optional; run on the CPUs of this NUMA node and prefer its memory "
+    "(needs a build with USE_NUMA).");
+DEFINE_bool(in_place_neurons, true,
+    "Optional; run neuron layers in place where safe, unless the model "
+    "sets in_place_neurons.");
+DEFINE_int32(layer_threads, 1,
+    "Optional; the threads to run independent layers on, unless the model "
+    "sets layer_threads (1 runs the layers in order).");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -100,6 +117,27 @@ static void get_gpus(vector<int>* gpus) {
   }
 }
 
+// Select the CPU GEMM backend from the -cpu_gemm flag.
+static void set_cpu_gemm() {
+  if (FLAGS_cpu_gemm == "blas") {
+    Caffe::set_cpu_gemm(Caffe::BLAS);
+  } else if (FLAGS_cpu_gemm == "packed") {
+    Caffe::set_cpu_gemm(Caffe::PACKED);
+  } else {
+    LOG(FATAL) << "Invalid CPU GEMM \"" << FLAGS_cpu_gemm
+        << "\" was specified";
+  }
+}
+
+// Report how the host allocator fared once a command is done.
+static void log_host_memory() {
+  const caffe::HostAllocator::Stats stats = caffe::HostAllocator::GetStats();
+  LOG(INFO) << "Host memory: peak " << stats.peak_bytes_in_use
+      << " bytes in use, " << stats.bytes_cached << " bytes cached, "
+      << stats.hits << " of " << stats.hits + stats.misses
+      << " allocations served from the cache.";
+}
+
 // caffe commands to call by
 //     caffe <command> <args>
 //
@@ -176,6 +214,7 @@ int train() {
   if (gpus.size() == 0) {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
+    set_cpu_gemm();
   } else {
     ostringstream s;
     for (int i = 0; i < gpus.size(); ++i) {
@@ -233,10 +272,10 @@ int test() {
   } else {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
+    set_cpu_gemm();
   }
   // Instantiate the caffe net.
-  Net<float> caffe_net(FLAGS_model, caffe::TEST);
-  caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  Net<float> caffe_net(FLAGS_model, caffe::TEST, FLAGS_weights);
   LOG(INFO) << "Running for " << FLAGS_iterations << " iterations.";
 
   vector<Blob<float>* > bottom_vec;
@@ -300,6 +339,7 @@ int time() {
   } else {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
+    set_cpu_gemm();
   }
   // Instantiate the caffe net.
   Net<float> caffe_net(FLAGS_model, caffe::TRAIN);
@@ -370,6 +410,7 @@ int time() {
   LOG(INFO) << "Average Forward-Backward: " << total_timer.MilliSeconds() /
     FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
+  caffe_net.LogMemoryUsage();
   LOG(INFO) << "*** Benchmark ends ***";
   return 0;
 }
@@ -388,11 +429,27 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  CHECK_GE(FLAGS_host_cache_mb, 0);
+  CHECK_GE(FLAGS_host_cache_total_mb, 0);
+  caffe::HostAllocator::set_cache_limit(
+      static_cast<size_t>(FLAGS_host_cache_mb) << 20);
+  caffe::HostAllocator::set_total_cache_limit(
+      static_cast<size_t>(FLAGS_host_cache_total_mb) << 20);
+  // Bind before any net or BLAS thread pool exists, so that they follow.
+  if (FLAGS_numa_node >= 0) {
+    caffe::BindThreadToNumaNode(FLAGS_numa_node);
+    caffe::Caffe::set_numa_node(FLAGS_numa_node);
+  }
+  caffe::Caffe::set_in_place_neurons(FLAGS_in_place_neurons);
+  CHECK_GE(FLAGS_layer_threads, 1);
+  caffe::Caffe::set_layer_threads(FLAGS_layer_threads);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
 #endif
-      return GetBrewFunction(caffe::string(argv[1]))();
+      const int result = GetBrewFunction(caffe::string(argv[1]))();
+      log_host_memory();
+      return result;
 #ifdef WITH_PYTHON_LAYER
     } catch (bp::error_already_set) {
       PyErr_Print();
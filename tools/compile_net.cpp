@@ -0,0 +1,40 @@
+// This is a script to compile a net and its trained weights into one binary
+// file that Net::Init builds without filtering, rewriting or splitting the
+// layers, or tuning the convolutions again. The weights are still parsed
+// and copied into the layers, so loading takes about as long as from the
+// prototxt and the weights file unless the net is tuned or rewritten.
+// Usage:
+//    compile_net net_proto_file weights_file compiled_file [TRAIN|TEST]
+// Load the compiled net with
+//    NetParameter param;
+//    ReadProtoFromMappedFileOrDie(compiled_file, &param);
+//    Net<float> net(param);
+//    param.Clear();  // The net keeps its own copy of the weights.
+
+#include <cstring>
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 4 && argc != 5) {
+    LOG(ERROR) << "Usage: compile_net net_proto_file weights_file "
+        << "compiled_file [TRAIN|TEST]";
+    return 1;
+  }
+  const Phase phase = (argc == 5 && strcmp(argv[4], "TRAIN") == 0) ?
+      TRAIN : TEST;
+  // Build on the CPU, where convolutions are tuned.
+  Caffe::set_mode(Caffe::CPU);
+  Net<float> net(argv[1], phase, argv[2]);
+  NetParameter compiled_param;
+  net.ToCompiledProto(&compiled_param);
+  WriteProtoToBinaryFile(compiled_param, argv[3]);
+  LOG(ERROR) << "Compiled " << net.layers().size() << " layers of "
+      << net.name() << " into " << argv[3];
+  return 0;
+}
@@ -44,7 +44,10 @@ int feature_extraction_pipeline(int argc, char** argv) {
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal.\n"
+    "On the CPU, set micro_batch_size (and pipeline_stages) in the feature"
+    " extraction net to stream each batch through the layers in micro-batches"
+    " on several threads.";
     return 1;
   }
   int arg_pos = num_required_args;
@@ -97,8 +100,8 @@ int feature_extraction_pipeline(int argc, char** argv) {
    */
   std::string feature_extraction_proto(argv[++arg_pos]);
   shared_ptr<Net<Dtype> > feature_extraction_net(
-      new Net<Dtype>(feature_extraction_proto, caffe::TEST));
-  feature_extraction_net->CopyTrainedLayersFrom(pretrained_binary_proto);
+      new Net<Dtype>(feature_extraction_proto, caffe::TEST,
+          pretrained_binary_proto));
 
   std::string extract_feature_blob_names(argv[++arg_pos]);
   std::vector<std::string> blob_names;
@@ -116,6 +119,8 @@ int feature_extraction_pipeline(int argc, char** argv) {
     CHECK(feature_extraction_net->has_blob(blob_names[i]))
         << "Unknown feature blob name " << blob_names[i]
         << " in the network " << feature_extraction_proto;
+    // Keep the features if the net shares activation memory between blobs.
+    feature_extraction_net->PreserveBlob(blob_names[i]);
   }
 
   int num_mini_batches = atoi(argv[++arg_pos]);
@@ -137,10 +142,10 @@ int feature_extraction_pipeline(int argc, char** argv) {
   Datum datum;
   const int kMaxKeyStrLength = 100;
   char key_str[kMaxKeyStrLength];
-  std::vector<Blob<float>*> input_vec;
   std::vector<int> image_indices(num_features, 0);
   for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index) {
-    feature_extraction_net->Forward(input_vec);
+    // Skip the layers (e.g. loss and accuracy) the features do not need.
+    feature_extraction_net->ForwardPruned(blob_names);
     for (int i = 0; i < num_features; ++i) {
       const shared_ptr<Blob<Dtype> > feature_blob = feature_extraction_net
           ->blob_by_name(blob_names[i]);
@@ -0,0 +1,103 @@
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/caffe.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::ConvolutionParameter;
+using caffe::ConvolutionParameter_Engine;
+using caffe::ConvolutionParameter_Engine_CAFFE;
+using caffe::ConvolutionParameter_Engine_FFT;
+using caffe::Layer;
+using caffe::LayerParameter;
+using caffe::LayerRegistry;
+using caffe::shared_ptr;
+using caffe::Timer;
+using caffe::vector;
+
+DEFINE_int32(num, 1, "The batch size.");
+DEFINE_int32(channels, 32, "The number of input channels.");
+DEFINE_int32(height, 56, "The input height.");
+DEFINE_int32(width, 56, "The input width.");
+DEFINE_int32(num_output, 32, "The number of output channels.");
+DEFINE_int32(min_kernel, 3, "The smallest (odd) kernel size to time.");
+DEFINE_int32(max_kernel, 15, "The largest (odd) kernel size to time.");
+DEFINE_int32(iterations, 10, "The number of forward passes per timing.");
+
+// Average milliseconds per forward pass of a "same" padded convolution.
+double TimeForward(const ConvolutionParameter_Engine engine, const int kernel,
+    Blob<float>* bottom) {
+  LayerParameter param;
+  param.set_type("Convolution");
+  ConvolutionParameter* conv_param = param.mutable_convolution_param();
+  conv_param->set_num_output(FLAGS_num_output);
+  conv_param->add_kernel_size(kernel);
+  conv_param->add_pad(kernel / 2);
+  conv_param->set_engine(engine);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  shared_ptr<Layer<float> > layer = LayerRegistry<float>::CreateLayer(param);
+  Blob<float> top;
+  vector<Blob<float>*> bottom_vec(1, bottom);
+  vector<Blob<float>*> top_vec(1, &top);
+  layer->SetUp(bottom_vec, top_vec);
+  // Warm up caches, including the FFT engine's filter spectra.
+  layer->Forward(bottom_vec, top_vec);
+  Timer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    layer->Forward(bottom_vec, top_vec);
+  }
+  return timer.MilliSeconds() / FLAGS_iterations;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Times the CAFFE and FFT convolution engines on "
+        "the CPU over a range of kernel sizes\n"
+        "Usage:\n"
+        "    fft_conv_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_iterations, 0);
+  CHECK_LE(FLAGS_min_kernel, FLAGS_max_kernel);
+
+  Caffe::set_mode(Caffe::CPU);
+  Blob<float> bottom(FLAGS_num, FLAGS_channels, FLAGS_height, FLAGS_width);
+  caffe::FillerParameter filler_param;
+  caffe::GaussianFiller<float> filler(filler_param);
+  filler.Fill(&bottom);
+
+  LOG(INFO) << "Input " << bottom.shape_string() << ", "
+            << FLAGS_num_output << " outputs.";
+  LOG(INFO) << "kernel      CAFFE (ms)      FFT (ms)";
+  int crossover = 0;
+  for (int kernel = FLAGS_min_kernel | 1; kernel <= FLAGS_max_kernel;
+       kernel += 2) {
+    const double gemm_ms = TimeForward(ConvolutionParameter_Engine_CAFFE,
+        kernel, &bottom);
+    const double fft_ms = TimeForward(ConvolutionParameter_Engine_FFT,
+        kernel, &bottom);
+    LOG(INFO) << kernel << "x" << kernel << "\t" << gemm_ms << "\t" << fft_ms;
+    if (fft_ms < gemm_ms && crossover == 0) {
+      crossover = kernel;
+    } else if (fft_ms >= gemm_ms) {
+      crossover = 0;
+    }
+  }
+  if (crossover > 0) {
+    LOG(INFO) << "FFT is faster from " << crossover << "x" << crossover
+              << " kernels up.";
+  } else {
+    LOG(INFO) << "FFT is not consistently faster in this range.";
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+// This is a script to fold the Power layers that scale and shift the output
+// of a Convolution or InnerProduct layer into that layer's weights, as
+// NetParameter.fold_affine_layers does when a net is loaded.
+// Usage:
+//    fold_affine_layers net_proto_file_in weights_file_in
+//        net_proto_file_out weights_file_out
+
+#include <map>
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/fuse_activations.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using std::map;
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: fold_affine_layers net_proto_file_in "
+        << "weights_file_in net_proto_file_out weights_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(argv[1], &net_param);
+  NetParameter weights_param;
+  ReadNetParamsFromBinaryFileOrDie(argv[2], &weights_param);
+  // Attach the trained weights to the layers of the net by name.
+  map<string, const LayerParameter*> trained_layers;
+  for (int i = 0; i < weights_param.layer_size(); ++i) {
+    trained_layers[weights_param.layer(i).name()] = &weights_param.layer(i);
+  }
+  for (int i = 0; i < net_param.layer_size(); ++i) {
+    LayerParameter* layer = net_param.mutable_layer(i);
+    if (trained_layers.count(layer->name())) {
+      layer->mutable_blobs()->CopyFrom(
+          trained_layers[layer->name()]->blobs());
+    }
+  }
+
+  NetParameter folded_param;
+  const int folded = FoldAffineLayers(net_param, &folded_param);
+  WriteProtoToBinaryFile(folded_param, argv[4]);
+  for (int i = 0; i < folded_param.layer_size(); ++i) {
+    folded_param.mutable_layer(i)->clear_blobs();
+  }
+  WriteProtoToTextFile(folded_param, argv[3]);
+
+  LOG(ERROR) << "Folded " << folded << " layers; wrote " << argv[3]
+      << " and " << argv[4];
+  return 0;
+}
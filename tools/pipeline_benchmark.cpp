@@ -0,0 +1,106 @@
+#include <string>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "google/protobuf/text_format.h"
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using caffe::Caffe;
+using caffe::FillerParameter;
+using caffe::GaussianFiller;
+using caffe::Net;
+using caffe::NetParameter;
+using caffe::Timer;
+using std::string;
+
+DEFINE_string(model, "",
+    "Optional; the model to time. Its inputs must share the batch size. By "
+    "default, a batch of 64 through a small convolutional net.");
+DEFINE_int32(iterations, 10,
+    "The number of forward passes per timing.");
+DEFINE_int32(micro_batch_size, 8,
+    "The size of the micro-batches that the pipeline runs.");
+DEFINE_int32(pipeline_stages, 2,
+    "The number of stages, each on its own thread, to cut the layers into.");
+
+const char* kDefaultModel =
+    "name: 'small_conv' "
+    "input: 'data' "
+    "input_shape { dim: 64 dim: 3 dim: 32 dim: 32 } "
+    "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+    "  convolution_param { num_output: 32 kernel_size: 5 pad: 2 "
+    "    weight_filler { type: 'gaussian' std: 0.01 } } } "
+    "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+    "layer { name: 'pool1' type: 'Pooling' bottom: 'conv1' top: 'pool1' "
+    "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } "
+    "layer { name: 'conv2' type: 'Convolution' bottom: 'pool1' top: 'conv2' "
+    "  convolution_param { num_output: 64 kernel_size: 5 pad: 2 "
+    "    weight_filler { type: 'gaussian' std: 0.01 } } } "
+    "layer { name: 'relu2' type: 'ReLU' bottom: 'conv2' top: 'conv2' } "
+    "layer { name: 'pool2' type: 'Pooling' bottom: 'conv2' top: 'pool2' "
+    "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } } "
+    "layer { name: 'ip1' type: 'InnerProduct' bottom: 'pool2' top: 'ip1' "
+    "  inner_product_param { num_output: 10 "
+    "    weight_filler { type: 'gaussian' std: 0.01 } } } ";
+
+// Images per second through the forward pass of the model, with the net
+// inputs filled once.
+double ImagesPerSecond(const NetParameter& model) {
+  Net<float> net(model);
+  CHECK_GT(net.input_blobs().size(), 0) << "The model takes no inputs.";
+  FillerParameter filler_param;
+  GaussianFiller<float> filler(filler_param);
+  for (int i = 0; i < net.input_blobs().size(); ++i) {
+    filler.Fill(net.input_blobs()[i]);
+  }
+  // Warm up, so that every blob is allocated before the timing.
+  net.ForwardPrefilled();
+  Timer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    net.ForwardPrefilled();
+  }
+  const double seconds = timer.MilliSeconds() / 1000;
+  return FLAGS_iterations * net.input_blobs()[0]->shape(0) / seconds;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Times CPU inference of a net on whole batches "
+        "and pipelined over micro-batches\n"
+        "Usage:\n"
+        "    pipeline_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_iterations, 0);
+  CHECK_GT(FLAGS_micro_batch_size, 0);
+  CHECK_GT(FLAGS_pipeline_stages, 0);
+
+  Caffe::set_mode(Caffe::CPU);
+  NetParameter model;
+  if (FLAGS_model.empty()) {
+    CHECK(google::protobuf::TextFormat::ParseFromString(kDefaultModel,
+        &model));
+  } else {
+    caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &model);
+  }
+  model.mutable_state()->set_phase(caffe::TEST);
+  model.clear_micro_batch_size();
+
+  const double whole_rate = ImagesPerSecond(model);
+  model.set_micro_batch_size(FLAGS_micro_batch_size);
+  model.set_pipeline_stages(FLAGS_pipeline_stages);
+  const double pipelined_rate = ImagesPerSecond(model);
+  LOG(INFO) << "whole batches:\t" << whole_rate << " images/s";
+  LOG(INFO) << "micro-batches of " << FLAGS_micro_batch_size << ", "
+            << FLAGS_pipeline_stages << " stages:\t" << pipelined_rate
+            << " images/s (" << pipelined_rate / whole_rate << "x)";
+  return 0;
+}